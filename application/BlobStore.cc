@@ -0,0 +1,189 @@
+#include "BlobStore.h"
+#include "SeekableGzip.h"
+#include "base/Logging.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace mymuduo;
+
+namespace {
+
+bool makeDir(const std::string& path) {
+    if (::mkdir(path.c_str(), 0755) == 0 || errno == EEXIST) {
+        return true;
+    }
+    LOG_ERROR << "Failed to create directory: " << path << ", error: " << strerror(errno);
+    return false;
+}
+
+} // namespace
+
+BlobStore::BlobStore(const std::string& rootDir)
+    : root_(rootDir)
+    , tempDir_(rootDir + "/tmp")
+    , chunks_(rootDir)
+{
+    makeDir(root_);
+    makeDir(tempDir_);
+
+    // 进程退出时没有完成的上传不会再被引用
+    if (DIR* dir = ::opendir(tempDir_.c_str())) {
+        while (struct dirent* entry = ::readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                ::unlink((tempDir_ + "/" + entry->d_name).c_str());
+            }
+        }
+        ::closedir(dir);
+    }
+}
+
+std::string BlobStore::blobPath(const std::string& hash) const {
+    return root_ + "/" + hash.substr(0, 2) + "/" + hash.substr(2, 2) + "/" + hash;
+}
+
+std::string BlobStore::tempPath(const std::string& name) const {
+    return tempDir_ + "/" + name;
+}
+
+bool BlobStore::isValidHash(const std::string& hash) {
+    if (hash.size() != 64) {
+        return false;
+    }
+    for (char c : hash) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::mutex& BlobStore::lockFor(const std::string& hash) {
+    // 哈希本身是均匀分布的，用第一个十六进制数字选锁
+    char c = hash[0];
+    int n = c <= '9' ? c - '0' : c - 'a' + 10;
+    return locks_[n % kLockCount];
+}
+
+bool BlobStore::storedSize(const std::string& hash, uint64_t* size) const {
+    struct stat st;
+    if (::stat(blobPath(hash).c_str(), &st) == 0) {
+        *size = static_cast<uint64_t>(st.st_size);
+        return true;
+    }
+    if (SeekableGzipReader::readRawSize(indexPath(hash), size)) {
+        return true;
+    }
+    std::vector<ChunkStore::Chunk> chunks;
+    return chunks_.readManifest(hash, size, &chunks);
+}
+
+void BlobStore::removeBlob(const std::string& hash) {
+    // 先删除帧索引，中途失败时留下的.gz不会被当作已经保存的内容
+    std::string path = blobPath(hash);
+    if (::unlink(indexPath(hash).c_str()) == 0) {
+        path = compressedPath(hash);
+    }
+    if (::unlink(path.c_str()) != 0) {
+        LOG_WARN << "Failed to delete blob: " << path << ", error: " << strerror(errno);
+    }
+}
+
+bool BlobStore::put(const std::string& tempFile, const std::string& hash,
+                    const std::function<bool()>& addRef, const std::string& indexFile) {
+    std::string path = indexFile.empty() ? blobPath(hash) : compressedPath(hash);
+    std::lock_guard<std::mutex> lock(lockFor(hash));
+
+    uint64_t size;
+    bool existed = storedSize(hash, &size);
+    if (existed) {
+        ::unlink(tempFile.c_str());
+        if (!indexFile.empty()) {
+            ::unlink(indexFile.c_str());
+        }
+        LOG_INFO << "Blob " << hash << " already stored, dropped duplicate upload";
+    } else {
+        if (!makeDir(root_ + "/" + hash.substr(0, 2)) ||
+            !makeDir(root_ + "/" + hash.substr(0, 2) + "/" + hash.substr(2, 2))) {
+            return false;
+        }
+        if (::rename(tempFile.c_str(), path.c_str()) != 0) {
+            LOG_ERROR << "Failed to move " << tempFile << " to " << path
+                      << ", error: " << strerror(errno);
+            return false;
+        }
+        // 帧索引存在才算保存完成，中途退出时遗留的.gz会被下一次上传覆盖
+        if (!indexFile.empty() && ::rename(indexFile.c_str(), indexPath(hash).c_str()) != 0) {
+            LOG_ERROR << "Failed to move " << indexFile << " to " << indexPath(hash)
+                      << ", error: " << strerror(errno);
+            ::unlink(path.c_str());
+            return false;
+        }
+    }
+
+    if (!addRef()) {
+        if (!existed) {
+            removeBlob(hash);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool BlobStore::putChunks(ChunkList* chunks, const std::string& hash,
+                          const std::function<bool()>& addRef) {
+    std::lock_guard<std::mutex> lock(lockFor(hash));
+
+    uint64_t size;
+    bool existed = storedSize(hash, &size);
+    if (existed) {
+        LOG_INFO << "Blob " << hash << " already stored, dropped duplicate chunks";
+    } else {
+        if (!chunks_.writeManifest(hash, chunks->totalSize(), chunks->chunks())) {
+            return false;
+        }
+        chunks->commit();
+    }
+
+    if (!addRef()) {
+        if (!existed) {
+            chunks_.removeManifest(hash);
+        }
+        return false;
+    }
+    return true;
+}
+
+BlobStore::LinkResult BlobStore::link(const std::string& hash, uint64_t size,
+                                      const std::function<bool()>& addRef) {
+    std::lock_guard<std::mutex> lock(lockFor(hash));
+
+    // 在锁内确认blob存在，插入记录之前它不会被最后一个引用的删除带走
+    uint64_t storedBytes;
+    if (!storedSize(hash, &storedBytes) || storedBytes != size) {
+        return kNotFound;
+    }
+    return addRef() ? kLinked : kLinkFailed;
+}
+
+bool BlobStore::release(const std::string& hash, const std::function<long long()>& removeRef) {
+    std::lock_guard<std::mutex> lock(lockFor(hash));
+
+    long long remaining = removeRef();
+    if (remaining < 0) {
+        return false;
+    }
+    if (remaining == 0) {
+        if (::access(chunks_.manifestPath(hash).c_str(), F_OK) == 0) {
+            chunks_.removeManifest(hash);
+            LOG_INFO << "Blob " << hash << " has no references, released its chunks";
+        } else {
+            removeBlob(hash);
+            LOG_INFO << "Blob " << hash << " has no references, deleted";
+        }
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ChunkStore.h"
+#include "base/noncopyable.h"
+
+#include <stdint.h>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// 按内容寻址的文件存储
+// 文件以内容的SHA-256命名，保存在 root/ab/cd/<hash>，内容相同的上传只保存一份。
+// 引用计数就是files表中content_hash相同的记录数，增加和删除引用都在
+// 该哈希对应的锁内完成，新上传复用blob和最后一个引用删除blob不会交错。
+// 文件内容也可以交给ChunkStore按分块保存，此时blob的位置上没有文件，由分块清单代替；
+// 压缩保存的blob是 <hash>.gz 和帧索引 <hash>.idx（见SeekableGzip.h），帧索引最后写入
+class BlobStore : mymuduo::noncopyable {
+public:
+    // 创建目录并清理上次运行遗留的临时文件
+    explicit BlobStore(const std::string& rootDir);
+
+    std::string blobPath(const std::string& hash) const;
+    std::string compressedPath(const std::string& hash) const { return blobPath(hash) + ".gz"; }
+    std::string indexPath(const std::string& hash) const { return blobPath(hash) + ".idx"; }
+    // 上传过程中写入的临时文件，与blob在同一文件系统上，入库时rename即可
+    std::string tempPath(const std::string& name) const;
+
+    static bool isValidHash(const std::string& hash);
+
+    ChunkStore& chunks() { return chunks_; }
+
+    // 把临时文件存为hash对应的blob，然后调用addRef插入引用它的记录
+    // blob已经存在时直接删除临时文件；addRef失败时撤销新建的blob
+    // indexFile非空时临时文件是SeekableGzipWriter压缩过的数据，indexFile是它的帧索引
+    bool put(const std::string& tempFile, const std::string& hash,
+             const std::function<bool()>& addRef, const std::string& indexFile = std::string());
+    // 同put，文件内容是chunks中按顺序排列的分块，保存为分块清单
+    // 内容已经存在时chunks持有的引用随chunks析构释放
+    bool putChunks(ChunkList* chunks, const std::string& hash,
+                   const std::function<bool()>& addRef);
+
+    enum LinkResult { kLinked, kNotFound, kLinkFailed };
+
+    // 秒传：hash对应的blob已经存在且大小为size时，调用addRef插入引用它的记录
+    // 返回kNotFound表示没有这份内容，客户端需要正常上传
+    LinkResult link(const std::string& hash, uint64_t size, const std::function<bool()>& addRef);
+
+    // 调用removeRef删除一条引用并返回剩余的引用数（出错返回负数），
+    // 没有引用时删除blob
+    bool release(const std::string& hash, const std::function<long long()>& removeRef);
+
+private:
+    static const int kLockCount = 16;
+
+    std::mutex& lockFor(const std::string& hash);
+    // hash对应的内容已经保存（整个文件、压缩文件或分块清单）时返回true和文件大小，需持有锁
+    bool storedSize(const std::string& hash, uint64_t* size) const;
+    // 删除hash对应的整个文件或压缩文件，需持有锁
+    void removeBlob(const std::string& hash);
+
+    const std::string root_;
+    const std::string tempDir_;
+    ChunkStore chunks_;
+    std::mutex locks_[kLockCount];
+};
@@ -0,0 +1,103 @@
+#include "BodyWriteQueue.h"
+
+BodyWriteQueue::BodyWriteQueue(Writer writer, Runner runner, size_t highWaterMark)
+    : writer_(std::move(writer))
+    , runner_(std::move(runner))
+    , highWaterMark_(highWaterMark)
+    , queuedBytes_(0)
+    , draining_(false)
+    , paused_(false)
+    , failed_(false)
+{
+}
+
+bool BodyWriteQueue::push(const char* data, size_t len) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failed_) {
+            return false;
+        }
+        queuedBytes_ += len;
+        if (queuedBytes_ >= highWaterMark_) {
+            paused_ = true;
+        }
+    }
+    enqueue(Piece{std::string(data, len), Task()});
+    return true;
+}
+
+bool BodyWriteQueue::full() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return paused_;
+}
+
+void BodyWriteQueue::finish(Task done) {
+    enqueue(Piece{std::string(), std::move(done)});
+}
+
+bool BodyWriteQueue::failed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+}
+
+void BodyWriteQueue::enqueue(Piece piece) {
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pieces_.push_back(std::move(piece));
+        if (!draining_) {
+            draining_ = true;
+            schedule = true;
+        }
+    }
+    if (schedule) {
+        runner_(std::bind(&BodyWriteQueue::drain, shared_from_this()));
+    }
+}
+
+// 取出当时已经入队的数据逐段写入，写完之后如果又有新数据就重新排队，不长期占用工作线程
+void BodyWriteQueue::drain() {
+    std::deque<Piece> batch;
+    bool failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batch.swap(pieces_);
+        failed = failed_;
+    }
+
+    for (Piece& piece : batch) {
+        if (piece.done) {
+            piece.done();
+            continue;
+        }
+        if (!failed && !writer_(piece.data.data(), piece.data.size())) {
+            failed = true;
+        }
+        bool resume = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queuedBytes_ -= piece.data.size();
+            failed_ = failed;
+            if (paused_ && queuedBytes_ <= highWaterMark_ / 2) {
+                paused_ = false;
+                resume = true;
+            }
+        }
+        if (resume && resumeCallback_) {
+            resumeCallback_();
+        }
+    }
+
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pieces_.empty()) {
+            draining_ = false;
+        } else {
+            schedule = true;
+        }
+    }
+    if (schedule) {
+        runner_(std::bind(&BodyWriteQueue::drain, shared_from_this()));
+    }
+}
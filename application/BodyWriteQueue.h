@@ -0,0 +1,59 @@
+#pragma once
+
+#include "base/noncopyable.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// 上传请求体的写入队列：IO线程把收到的数据拷贝进队列后立即返回，
+// 由线程池按到达顺序交给writer（写盘、计算哈希、切分分块），这些操作都不在IO线程中执行。
+// 同一个队列同时最多只有一个任务在线程池中处理，每次处理完当时已经入队的数据后让出线程。
+// 排队的字节数达到highWaterMark时full()为true，调用者应暂停读取；降到一半以下时调用resumeCallback。
+// 已经读到的数据总会入队，所以排队的字节数最多超过highWaterMark一次读取的大小
+class BodyWriteQueue : public std::enable_shared_from_this<BodyWriteQueue>,
+                       mymuduo::noncopyable {
+public:
+    // 返回false表示写入失败，之后的数据被丢弃
+    using Writer = std::function<bool (const char* data, size_t len)>;
+    using Task = std::function<void ()>;
+    // 把任务交给线程池执行
+    using Runner = std::function<void (Task)>;
+
+    BodyWriteQueue(Writer writer, Runner runner, size_t highWaterMark);
+
+    // 在第一次push之前设置，cb在工作线程中调用
+    void setResumeCallback(Task cb) { resumeCallback_ = std::move(cb); }
+
+    // IO线程调用：数据入队，之前的写入已经失败时返回false
+    bool push(const char* data, size_t len);
+    // 排队的数据是否达到上限
+    bool full() const;
+    // 请求体结束：之前入队的数据全部交给writer之后，在工作线程中执行done
+    void finish(Task done);
+    // 是否有写入失败，finish的done中调用时结果是确定的
+    bool failed() const;
+
+private:
+    struct Piece {
+        std::string data;
+        Task done;         // 非空表示请求体结束
+    };
+
+    void enqueue(Piece piece);
+    void drain();
+
+    const Writer writer_;
+    const Runner runner_;
+    const size_t highWaterMark_;
+    Task resumeCallback_;
+
+    mutable std::mutex mutex_;
+    std::deque<Piece> pieces_;
+    size_t queuedBytes_;       // 已入队还没有写完的字节数
+    bool draining_;            // 是否已经有任务在线程池中
+    bool paused_;              // 达到上限之后还没有降到一半以下
+    bool failed_;
+};
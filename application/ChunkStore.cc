@@ -0,0 +1,430 @@
+#include "ChunkStore.h"
+#include "Sha256.h"
+#include "base/Logging.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+
+using namespace mymuduo;
+
+namespace {
+
+struct GearTable {
+    uint64_t values[256];
+
+    GearTable() {
+        // splitmix64，种子为0
+        uint64_t state = 0;
+        for (int i = 0; i < 256; ++i) {
+            state += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            values[i] = z ^ (z >> 31);
+        }
+    }
+};
+
+const GearTable kGear;
+
+bool makeDir(const std::string& path) {
+    if (::mkdir(path.c_str(), 0755) == 0 || errno == EEXIST) {
+        return true;
+    }
+    LOG_ERROR << "Failed to create directory: " << path << ", error: " << strerror(errno);
+    return false;
+}
+
+// 对 dir/ab/cd/ 下的每个文件调用cb(文件名, 路径)
+void forEachStoredFile(const std::string& dir,
+                       const std::function<void(const std::string&, const std::string&)>& cb) {
+    std::vector<std::string> levels{dir};
+    for (int depth = 0; depth < 3; ++depth) {
+        std::vector<std::string> next;
+        for (const std::string& path : levels) {
+            DIR* d = ::opendir(path.c_str());
+            if (!d) {
+                continue;
+            }
+            while (struct dirent* entry = ::readdir(d)) {
+                std::string name = entry->d_name;
+                if (name[0] == '.' || (depth < 2 && name.size() != 2)) {
+                    continue;
+                }
+                if (depth < 2) {
+                    next.push_back(path + "/" + name);
+                } else {
+                    cb(name, path + "/" + name);
+                }
+            }
+            ::closedir(d);
+        }
+        levels.swap(next);
+    }
+}
+
+std::string shardedPath(const std::string& dir, const std::string& hash) {
+    return dir + "/" + hash.substr(0, 2) + "/" + hash.substr(2, 2) + "/" + hash;
+}
+
+bool makeShardDirs(const std::string& dir, const std::string& hash) {
+    return makeDir(dir + "/" + hash.substr(0, 2)) &&
+           makeDir(dir + "/" + hash.substr(0, 2) + "/" + hash.substr(2, 2));
+}
+
+bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::atomic<uint64_t> g_tempSeq(0);
+
+} // namespace
+
+CdcChunker::CdcChunker(const ChunkCallback& cb)
+    : callback_(cb)
+{
+}
+
+size_t CdcChunker::cutPoint(const char* data, size_t len) {
+    if (len <= kMinSize) {
+        return len;
+    }
+    size_t end = len < kMaxSize ? len : kMaxSize;
+    size_t normal = end < kAvgSize ? end : kAvgSize;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    uint64_t h = 0;
+    size_t i = kMinSize;
+    for (; i < normal; ++i) {
+        h = (h << 1) + kGear.values[p[i]];
+        if ((h & kMaskS) == 0) {
+            return i + 1;
+        }
+    }
+    for (; i < end; ++i) {
+        h = (h << 1) + kGear.values[p[i]];
+        if ((h & kMaskL) == 0) {
+            return i + 1;
+        }
+    }
+    return end;
+}
+
+bool CdcChunker::update(const char* data, size_t len) {
+    buffer_.append(data, len);
+    if (buffer_.size() < kMaxSize) {
+        return true;
+    }
+    size_t start = 0;
+    while (buffer_.size() - start >= kMaxSize) {
+        size_t n = cutPoint(buffer_.data() + start, buffer_.size() - start);
+        if (!callback_(buffer_.data() + start, n)) {
+            return false;
+        }
+        start += n;
+    }
+    buffer_.erase(0, start);
+    return true;
+}
+
+bool CdcChunker::finish() {
+    size_t start = 0;
+    while (start < buffer_.size()) {
+        size_t n = cutPoint(buffer_.data() + start, buffer_.size() - start);
+        if (!callback_(buffer_.data() + start, n)) {
+            return false;
+        }
+        start += n;
+    }
+    buffer_.clear();
+    return true;
+}
+
+ChunkStore::ChunkStore(const std::string& rootDir)
+    : chunkDir_(rootDir + "/chunks")
+    , manifestDir_(rootDir + "/manifests")
+    , tempDir_(rootDir + "/chunks/tmp")
+{
+    makeDir(rootDir);
+    makeDir(chunkDir_);
+    makeDir(manifestDir_);
+    makeDir(tempDir_);
+    rebuildRefs();
+}
+
+void ChunkStore::rebuildRefs() {
+    if (DIR* dir = ::opendir(tempDir_.c_str())) {
+        while (struct dirent* entry = ::readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                ::unlink((tempDir_ + "/" + entry->d_name).c_str());
+            }
+        }
+        ::closedir(dir);
+    }
+
+    size_t manifests = 0;
+    forEachStoredFile(manifestDir_, [&](const std::string& fileHash, const std::string&) {
+        uint64_t fileSize;
+        std::vector<Chunk> chunks;
+        if (readManifest(fileHash, &fileSize, &chunks)) {
+            ++manifests;
+            for (const Chunk& chunk : chunks) {
+                ++refs_[chunk.hash];
+            }
+        }
+    });
+
+    // 上传中途退出留下的分块没有清单引用
+    size_t orphans = 0;
+    forEachStoredFile(chunkDir_, [&](const std::string& hash, const std::string& path) {
+        if (refs_.find(hash) == refs_.end()) {
+            ::unlink(path.c_str());
+            ++orphans;
+        }
+    });
+    LOG_INFO << "Chunk store loaded " << manifests << " manifests, " << refs_.size()
+             << " chunks, removed " << orphans << " unreferenced chunks";
+}
+
+std::string ChunkStore::chunkPath(const std::string& hash) const {
+    return shardedPath(chunkDir_, hash);
+}
+
+std::string ChunkStore::manifestPath(const std::string& fileHash) const {
+    return shardedPath(manifestDir_, fileHash);
+}
+
+bool ChunkStore::acquire(const std::string& hash, const char* data, size_t len) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = refs_.find(hash);
+        if (it != refs_.end()) {
+            ++it->second;
+            return true;
+        }
+    }
+
+    // 在锁外写临时文件，其他分块的读写不受影响
+    std::string tempFile = tempDir_ + "/" + hash + "." + std::to_string(++g_tempSeq);
+    int fd = ::open(tempFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || !writeAll(fd, data, len)) {
+        LOG_ERROR << "Failed to write chunk " << tempFile << ", error: " << strerror(errno);
+        if (fd >= 0) {
+            ::close(fd);
+            ::unlink(tempFile.c_str());
+        }
+        return false;
+    }
+    ::close(fd);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = refs_.find(hash);
+    if (it != refs_.end()) {
+        // 同一个分块在此期间被另一个上传保存
+        ::unlink(tempFile.c_str());
+        ++it->second;
+        return true;
+    }
+    std::string path = chunkPath(hash);
+    if (!makeShardDirs(chunkDir_, hash) || ::rename(tempFile.c_str(), path.c_str()) != 0) {
+        LOG_ERROR << "Failed to store chunk " << path << ", error: " << strerror(errno);
+        ::unlink(tempFile.c_str());
+        return false;
+    }
+    refs_[hash] = 1;
+    return true;
+}
+
+bool ChunkStore::acquireExisting(const std::string& hash, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = refs_.find(hash);
+    if (it == refs_.end()) {
+        return false;
+    }
+    struct stat st;
+    if (::stat(chunkPath(hash).c_str(), &st) != 0 || static_cast<size_t>(st.st_size) != size) {
+        return false;
+    }
+    ++it->second;
+    return true;
+}
+
+void ChunkStore::release(const std::string& hash) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    releaseLocked(hash);
+}
+
+void ChunkStore::releaseLocked(const std::string& hash) {
+    auto it = refs_.find(hash);
+    if (it == refs_.end()) {
+        LOG_ERROR << "Releasing unknown chunk " << hash;
+        return;
+    }
+    if (--it->second == 0) {
+        refs_.erase(it);
+        ::unlink(chunkPath(hash).c_str());
+    }
+}
+
+bool ChunkStore::hasChunk(const std::string& hash) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return refs_.find(hash) != refs_.end();
+}
+
+bool ChunkStore::stage(const std::string& hash, const char* data, size_t len, double ttl) {
+    Timestamp expire = addTime(Timestamp::now(), ttl);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = staged_.find(hash);
+        if (it != staged_.end()) {
+            // 已经暂存，只延长期限
+            it->second = expire;
+            return true;
+        }
+    }
+    if (!acquire(hash, data, len)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!staged_.emplace(hash, expire).second) {
+        // 并发上传了同一个分块，暂存只持有一个引用
+        releaseLocked(hash);
+    }
+    return true;
+}
+
+size_t ChunkStore::expireStaged() {
+    Timestamp now = Timestamp::now();
+    size_t expired = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = staged_.begin(); it != staged_.end();) {
+        if (it->second < now) {
+            releaseLocked(it->first);
+            it = staged_.erase(it);
+            ++expired;
+        } else {
+            ++it;
+        }
+    }
+    return expired;
+}
+
+bool ChunkStore::writeManifest(const std::string& fileHash, uint64_t fileSize,
+                               const std::vector<Chunk>& chunks) {
+    std::ostringstream out;
+    out << fileSize << "\n";
+    for (const Chunk& chunk : chunks) {
+        out << chunk.hash << " " << chunk.size << "\n";
+    }
+    std::string content = out.str();
+
+    std::string tempFile = tempDir_ + "/" + fileHash + ".manifest." + std::to_string(++g_tempSeq);
+    int fd = ::open(tempFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || !writeAll(fd, content.data(), content.size())) {
+        LOG_ERROR << "Failed to write manifest " << tempFile << ", error: " << strerror(errno);
+        if (fd >= 0) {
+            ::close(fd);
+            ::unlink(tempFile.c_str());
+        }
+        return false;
+    }
+    ::close(fd);
+
+    std::string path = manifestPath(fileHash);
+    if (!makeShardDirs(manifestDir_, fileHash) || ::rename(tempFile.c_str(), path.c_str()) != 0) {
+        LOG_ERROR << "Failed to store manifest " << path << ", error: " << strerror(errno);
+        ::unlink(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ChunkStore::readManifest(const std::string& fileHash, uint64_t* fileSize,
+                              std::vector<Chunk>* chunks) const {
+    std::ifstream in(manifestPath(fileHash));
+    if (!in) {
+        return false;
+    }
+    uint64_t total = 0;
+    if (!(in >> *fileSize)) {
+        return false;
+    }
+    chunks->clear();
+    Chunk chunk;
+    while (in >> chunk.hash >> chunk.size) {
+        total += chunk.size;
+        chunks->push_back(chunk);
+    }
+    if (total != *fileSize) {
+        LOG_ERROR << "Corrupted manifest " << manifestPath(fileHash);
+        return false;
+    }
+    return true;
+}
+
+void ChunkStore::removeManifest(const std::string& fileHash) {
+    uint64_t fileSize;
+    std::vector<Chunk> chunks;
+    if (!readManifest(fileHash, &fileSize, &chunks)) {
+        return;
+    }
+    ::unlink(manifestPath(fileHash).c_str());
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Chunk& chunk : chunks) {
+        releaseLocked(chunk.hash);
+    }
+}
+
+ChunkList::ChunkList(ChunkStore* store)
+    : store_(store)
+    , totalSize_(0)
+    , committed_(false)
+{
+}
+
+ChunkList::~ChunkList() {
+    if (!committed_) {
+        for (const ChunkStore::Chunk& chunk : chunks_) {
+            store_->release(chunk.hash);
+        }
+    }
+}
+
+bool ChunkList::add(const char* data, size_t len) {
+    Sha256 sha;
+    sha.update(data, len);
+    std::string hash = sha.hexDigest();
+    if (!store_->acquire(hash, data, len)) {
+        return false;
+    }
+    chunks_.push_back(ChunkStore::Chunk{hash, len});
+    totalSize_ += len;
+    return true;
+}
+
+bool ChunkList::addExisting(const std::string& hash, size_t size) {
+    if (!store_->acquireExisting(hash, size)) {
+        return false;
+    }
+    chunks_.push_back(ChunkStore::Chunk{hash, size});
+    totalSize_ += size;
+    return true;
+}
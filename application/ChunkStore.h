@@ -0,0 +1,115 @@
+#pragma once
+
+#include "base/noncopyable.h"
+#include "base/Timestamp.h"
+
+#include <stdint.h>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// FastCDC内容定义分块
+// 切分点只取决于附近的64个字节，文件中间插入或删除数据后，之后的分块仍与旧版本相同。
+// 客户端需要用相同的参数分块才能只重传变化的分块：
+//   gear表为以0为种子的splitmix64序列的前256个值，
+//   哈希 h = (h << 1) + gear[byte]，
+//   [kMinSize, kAvgSize) 内 (h & kMaskS) == 0 时切分，[kAvgSize, kMaxSize) 内 (h & kMaskL) == 0 时切分
+class CdcChunker : mymuduo::noncopyable {
+public:
+    static const size_t kMinSize = 256 * 1024;
+    static const size_t kAvgSize = 1024 * 1024;
+    static const size_t kMaxSize = 4 * 1024 * 1024;
+    static const uint64_t kMaskS = 0xfffffc0000000000ULL;  // 22位，平均大小之前更难切分
+    static const uint64_t kMaskL = 0xffffc00000000000ULL;  // 18位，平均大小之后更容易切分
+
+    // 每切出一个分块调用一次，返回false时停止
+    using ChunkCallback = std::function<bool(const char* data, size_t len)>;
+
+    explicit CdcChunker(const ChunkCallback& cb);
+
+    bool update(const char* data, size_t len);
+    // 数据结束，切出剩余的分块
+    bool finish();
+
+    // data开头的分块长度，len不超过kMaxSize时以len为最后一个切分点
+    static size_t cutPoint(const char* data, size_t len);
+
+private:
+    ChunkCallback callback_;
+    std::string buffer_;  // 还没有切分的数据，至少攒够kMaxSize才切分，结果与一次切分整个文件相同
+};
+
+// 分块存储
+// 每个不同内容的分块在 root/chunks/ab/cd/<hash> 中只保存一份，
+// 文件由 root/manifests/ab/cd/<文件hash> 中的分块清单按顺序拼接而成。
+// 分块的引用计数是包含它的清单数加上正在使用它的上传数，只保存在内存中，
+// 启动时由清单重建，不属于任何清单的分块在启动时删除
+class ChunkStore : mymuduo::noncopyable {
+public:
+    struct Chunk {
+        std::string hash;
+        size_t size;
+    };
+
+    explicit ChunkStore(const std::string& rootDir);
+
+    std::string chunkPath(const std::string& hash) const;
+    std::string manifestPath(const std::string& fileHash) const;
+
+    // 保存一个分块并持有它的一个引用，已经存在时只增加引用
+    bool acquire(const std::string& hash, const char* data, size_t len);
+    // 为已经保存的分块增加一个引用，分块不存在或大小不符时返回false
+    bool acquireExisting(const std::string& hash, size_t size);
+    void release(const std::string& hash);
+    bool hasChunk(const std::string& hash) const;
+
+    // 单独上传的分块在提交清单之前由暂存持有引用，超过ttl秒没有被重新上传就释放
+    bool stage(const std::string& hash, const char* data, size_t len, double ttl);
+    size_t expireStaged();
+
+    // 保存文件的分块清单，chunks中的引用从调用者转移给清单
+    bool writeManifest(const std::string& fileHash, uint64_t fileSize,
+                       const std::vector<Chunk>& chunks);
+    // 读取清单，不存在或损坏时返回false
+    bool readManifest(const std::string& fileHash, uint64_t* fileSize,
+                      std::vector<Chunk>* chunks) const;
+    // 删除清单并释放其中分块的引用
+    void removeManifest(const std::string& fileHash);
+
+private:
+    void rebuildRefs();
+    void releaseLocked(const std::string& hash);
+
+    const std::string chunkDir_;
+    const std::string manifestDir_;
+    const std::string tempDir_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, int> refs_;  // 已保存的分块及其引用数
+    std::unordered_map<std::string, mymuduo::Timestamp> staged_;  // 暂存的分块及其过期时间
+};
+
+// 一个文件的分块列表，每个分块持有一个引用
+// 提交给清单之后引用归清单所有，否则在析构时释放
+class ChunkList : mymuduo::noncopyable {
+public:
+    explicit ChunkList(ChunkStore* store);
+    ~ChunkList();
+
+    // 计算分块的哈希并保存
+    bool add(const char* data, size_t len);
+    // 引用一个已经保存的分块，不存在时返回false
+    bool addExisting(const std::string& hash, size_t size);
+
+    const std::vector<ChunkStore::Chunk>& chunks() const { return chunks_; }
+    uint64_t totalSize() const { return totalSize_; }
+    void commit() { committed_ = true; }
+
+private:
+    ChunkStore* store_;
+    std::vector<ChunkStore::Chunk> chunks_;
+    uint64_t totalSize_;
+    bool committed_;
+};
@@ -0,0 +1,332 @@
+#include "DbPool.h"
+#include "base/Logging.h"
+
+#include <mysql/errmsg.h>
+
+#include <algorithm>
+#include <string.h>
+
+using namespace mymuduo;
+
+namespace {
+
+// 每个线程在各个连接池中的连接
+thread_local std::unordered_map<const DbPool*, DbConnection*> t_connections;
+
+// MYSQL_BIND中is_null/error字段在不同版本的客户端库中分别是bool和my_bool
+using BindFlag = std::remove_pointer<decltype(MYSQL_BIND::is_null)>::type;
+
+const unsigned long kMinColumnBuffer = 64;
+
+bool isConnectionLost(unsigned int err) {
+    return err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST;
+}
+
+} // namespace
+
+DbConnection::DbConnection(const DbConfig& config)
+    : config_(config),
+      mysql_(nullptr),
+      lastInsertId_(0),
+      affectedRows_(0),
+      lastCheck_(Timestamp::now())
+{
+    connect();
+}
+
+DbConnection::~DbConnection() {
+    close();
+}
+
+bool DbConnection::connect() {
+    mysql_ = mysql_init(nullptr);
+    if (!mysql_) {
+        LOG_ERROR << "MySQL初始化失败";
+        return false;
+    }
+
+    // 服务器不可达或无响应时在超时后失败，不让调用线程无限期阻塞
+    mysql_options(mysql_, MYSQL_OPT_CONNECT_TIMEOUT, &config_.connectTimeout);
+    mysql_options(mysql_, MYSQL_OPT_READ_TIMEOUT, &config_.readTimeout);
+
+    if (!mysql_real_connect(mysql_, config_.host.c_str(), config_.user.c_str(),
+                            config_.password.c_str(), config_.database.c_str(),
+                            config_.port, nullptr, 0)) {
+        LOG_ERROR << "连接到MySQL服务器失败: " << mysql_error(mysql_);
+        mysql_close(mysql_);
+        mysql_ = nullptr;
+        return false;
+    }
+
+    // 设置字符集为utf8
+    if (mysql_set_character_set(mysql_, "utf8") != 0) {
+        LOG_ERROR << "设置字符集失败: " << mysql_error(mysql_);
+    }
+
+    LOG_INFO << "数据库连接成功, thread id: " << mysql_thread_id(mysql_);
+    return true;
+}
+
+void DbConnection::close() {
+    for (auto& entry : statements_) {
+        mysql_stmt_close(entry.second);
+    }
+    statements_.clear();
+    if (mysql_) {
+        mysql_close(mysql_);
+        mysql_ = nullptr;
+    }
+}
+
+bool DbConnection::checkHealth() {
+    lastCheck_ = Timestamp::now();
+    if (mysql_ && mysql_ping(mysql_) == 0) {
+        return true;
+    }
+    LOG_WARN << "数据库连接不可用，重新连接";
+    // 预处理语句绑定在旧连接上，重连后需要重新prepare
+    close();
+    return connect();
+}
+
+void DbConnection::checkHealthIfIdle(double interval) {
+    if (timeDifference(Timestamp::now(), lastCheck_) >= interval) {
+        checkHealth();
+    }
+}
+
+MYSQL_STMT* DbConnection::prepare(const std::string& sql) {
+    auto it = statements_.find(sql);
+    if (it != statements_.end()) {
+        return it->second;
+    }
+
+    MYSQL_STMT* stmt = mysql_stmt_init(mysql_);
+    if (!stmt) {
+        LOG_ERROR << "mysql_stmt_init失败: " << mysql_error(mysql_);
+        return nullptr;
+    }
+    if (mysql_stmt_prepare(stmt, sql.c_str(), sql.size()) != 0) {
+        LOG_ERROR << "预处理语句失败: " << mysql_stmt_error(stmt) << ", sql: " << sql;
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+    // 让store_result计算每列的最大长度，用于分配结果缓冲区
+    BindFlag updateMaxLength = 1;
+    mysql_stmt_attr_set(stmt, STMT_ATTR_UPDATE_MAX_LENGTH, &updateMaxLength);
+
+    statements_[sql] = stmt;
+    return stmt;
+}
+
+bool DbConnection::execute(const std::string& sql,
+                           const std::vector<DbParam>& params,
+                           DbResult* result) {
+    unsigned int err = 0;
+    if (executeOnce(sql, params, result, &err)) {
+        return true;
+    }
+    if (isConnectionLost(err) || !mysql_) {
+        if (checkHealth()) {
+            return executeOnce(sql, params, result, &err);
+        }
+    }
+    return false;
+}
+
+bool DbConnection::executeOnce(const std::string& sql, const std::vector<DbParam>& params,
+                               DbResult* result, unsigned int* err) {
+    if (!mysql_) {
+        LOG_ERROR << "数据库未连接";
+        return false;
+    }
+
+    MYSQL_STMT* stmt = prepare(sql);
+    if (!stmt) {
+        *err = mysql_errno(mysql_);
+        return false;
+    }
+
+    if (mysql_stmt_param_count(stmt) != params.size()) {
+        LOG_ERROR << "参数个数不匹配: " << sql;
+        return false;
+    }
+
+    std::vector<MYSQL_BIND> binds(params.size());
+    std::vector<unsigned long> lengths(params.size());
+    for (size_t i = 0; i < params.size(); ++i) {
+        MYSQL_BIND& bind = binds[i];
+        memset(&bind, 0, sizeof bind);
+        if (params[i].isNull()) {
+            bind.buffer_type = MYSQL_TYPE_NULL;
+        } else if (params[i].isInteger()) {
+            bind.buffer_type = MYSQL_TYPE_LONGLONG;
+            bind.buffer = const_cast<unsigned long long*>(params[i].integerValue());
+            bind.is_unsigned = params[i].isUnsigned();
+        } else {
+            lengths[i] = params[i].value().size();
+            bind.buffer_type = MYSQL_TYPE_STRING;
+            bind.buffer = const_cast<char*>(params[i].value().data());
+            bind.buffer_length = lengths[i];
+            bind.length = &lengths[i];
+        }
+    }
+
+    if ((!binds.empty() && mysql_stmt_bind_param(stmt, binds.data())) ||
+        mysql_stmt_execute(stmt) != 0) {
+        *err = mysql_stmt_errno(stmt);
+        LOG_ERROR << "执行预处理语句失败: " << mysql_stmt_error(stmt) << ", sql: " << sql;
+        if (isConnectionLost(*err)) {
+            // 语句随连接一起失效
+            statements_.erase(sql);
+            mysql_stmt_close(stmt);
+        }
+        return false;
+    }
+
+    lastInsertId_ = mysql_stmt_insert_id(stmt);
+    affectedRows_ = mysql_stmt_affected_rows(stmt);
+
+    bool ok = true;
+    if (mysql_stmt_field_count(stmt) > 0) {
+        if (result) {
+            ok = fetchAll(stmt, result);
+        }
+        mysql_stmt_free_result(stmt);
+    }
+    return ok;
+}
+
+bool DbConnection::fetchAll(MYSQL_STMT* stmt, DbResult* result) {
+    result->rows_.clear();
+    if (mysql_stmt_store_result(stmt) != 0) {
+        LOG_ERROR << "获取结果集失败: " << mysql_stmt_error(stmt);
+        return false;
+    }
+
+    MYSQL_RES* meta = mysql_stmt_result_metadata(stmt);
+    if (!meta) {
+        return true;
+    }
+    unsigned int numFields = mysql_num_fields(meta);
+    std::vector<MYSQL_BIND> binds(numFields);
+    std::vector<std::vector<char>> buffers(numFields);
+    std::vector<unsigned long> lengths(numFields);
+    std::unique_ptr<BindFlag[]> nulls(new BindFlag[numFields]);
+    std::unique_ptr<BindFlag[]> errors(new BindFlag[numFields]);
+    for (unsigned int i = 0; i < numFields; ++i) {
+        MYSQL_FIELD* field = mysql_fetch_field_direct(meta, i);
+        buffers[i].resize(std::max(field->max_length, kMinColumnBuffer) + 1);
+        MYSQL_BIND& bind = binds[i];
+        memset(&bind, 0, sizeof bind);
+        bind.buffer_type = MYSQL_TYPE_STRING;
+        bind.buffer = buffers[i].data();
+        bind.buffer_length = buffers[i].size();
+        bind.length = &lengths[i];
+        bind.is_null = &nulls[i];
+        bind.error = &errors[i];
+    }
+    mysql_free_result(meta);
+
+    if (mysql_stmt_bind_result(stmt, binds.data())) {
+        LOG_ERROR << "绑定结果失败: " << mysql_stmt_error(stmt);
+        return false;
+    }
+
+    result->rows_.reserve(mysql_stmt_num_rows(stmt));
+    while (true) {
+        int rc = mysql_stmt_fetch(stmt);
+        if (rc == MYSQL_NO_DATA) {
+            break;
+        }
+        if (rc == 1) {
+            LOG_ERROR << "读取结果失败: " << mysql_stmt_error(stmt);
+            return false;
+        }
+
+        DbRow row;
+        row.values_.resize(numFields);
+        row.nulls_.resize(numFields);
+        for (unsigned int i = 0; i < numFields; ++i) {
+            if (nulls[i]) {
+                row.nulls_[i] = true;
+                continue;
+            }
+            if (lengths[i] <= binds[i].buffer_length) {
+                row.values_[i].assign(buffers[i].data(), lengths[i]);
+            } else {
+                // 列比预估的长，单独取回完整数据
+                std::string& value = row.values_[i];
+                value.resize(lengths[i]);
+                MYSQL_BIND column;
+                memset(&column, 0, sizeof column);
+                column.buffer_type = MYSQL_TYPE_STRING;
+                column.buffer = &value[0];
+                column.buffer_length = lengths[i];
+                mysql_stmt_fetch_column(stmt, &column, i, 0);
+            }
+        }
+        result->rows_.push_back(std::move(row));
+    }
+    return true;
+}
+
+bool DbConnection::query(const std::string& sql) {
+    if (!mysql_ && !checkHealth()) {
+        LOG_ERROR << "数据库未连接";
+        return false;
+    }
+
+    if (mysql_query(mysql_, sql.c_str()) != 0) {
+        LOG_ERROR << "执行查询失败: " << mysql_error(mysql_);
+        return false;
+    }
+    lastInsertId_ = mysql_insert_id(mysql_);
+    affectedRows_ = mysql_affected_rows(mysql_);
+    return true;
+}
+
+MYSQL_RES* DbConnection::queryWithResult(const std::string& sql) {
+    if (!query(sql)) {
+        return nullptr;
+    }
+    return mysql_store_result(mysql_);
+}
+
+std::string DbConnection::escape(const std::string& str) {
+    if (!mysql_) {
+        return str;
+    }
+    std::string escaped(str.size() * 2 + 1, '\0');
+    unsigned long len = mysql_real_escape_string(mysql_, &escaped[0], str.c_str(), str.size());
+    escaped.resize(len);
+    return escaped;
+}
+
+DbPool::DbPool(const DbConfig& config)
+    : config_(config)
+{
+    // 多线程使用客户端库之前必须先初始化
+    mysql_library_init(0, nullptr, nullptr);
+}
+
+DbPool::~DbPool() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_.clear();
+}
+
+DbConnection& DbPool::local() {
+    auto it = t_connections.find(this);
+    if (it != t_connections.end()) {
+        it->second->checkHealthIfIdle(config_.healthCheckInterval);
+        return *it->second;
+    }
+
+    DbConnection* conn = new DbConnection(config_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections_.emplace_back(conn);
+    }
+    t_connections[this] = conn;
+    return *conn;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "base/noncopyable.h"
+#include "base/Timestamp.h"
+
+#include <mysql/mysql.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// 数据库连接参数
+struct DbConfig {
+    std::string host = "localhost";
+    std::string user = "root";
+    std::string password;
+    std::string database;
+    unsigned int port = 3306;
+    double healthCheckInterval = 30.0;  // 健康检查间隔（秒）
+    unsigned int connectTimeout = 5;    // 建立连接的超时（秒）
+    unsigned int readTimeout = 30;      // 等待服务器响应的超时（秒），服务器无响应时查询失败而不是一直阻塞
+};
+
+// 预处理语句的参数：整数按64位整数绑定（可用于LIMIT等只接受整数的位置），
+// 其余统一以字符串形式绑定，由服务器按列类型转换
+class DbParam {
+public:
+    DbParam(const std::string& value) : value_(value), null_(false), integer_(false), unsigned_(false), integerValue_(0) {}
+    DbParam(const char* value)
+        : value_(value ? value : ""), null_(value == nullptr), integer_(false), unsigned_(false), integerValue_(0) {}
+    template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+    DbParam(T value)
+        : value_(std::to_string(value)), null_(false), integer_(true),
+          unsigned_(std::is_unsigned<T>::value), integerValue_(static_cast<unsigned long long>(value)) {}
+
+    static DbParam null() { return DbParam(static_cast<const char*>(nullptr)); }
+
+    const std::string& value() const { return value_; }
+    bool isNull() const { return null_; }
+    bool isInteger() const { return integer_; }
+    bool isUnsigned() const { return unsigned_; }
+    // 整数参数的64位表示，有符号数按补码保存
+    const unsigned long long* integerValue() const { return &integerValue_; }
+
+private:
+    std::string value_;
+    bool null_;
+    bool integer_;
+    bool unsigned_;
+    unsigned long long integerValue_;
+};
+
+// 结果集中的一行，operator[]与MYSQL_ROW一致：NULL列返回nullptr
+class DbRow {
+public:
+    const char* operator[](size_t col) const {
+        return nulls_[col] ? nullptr : values_[col].c_str();
+    }
+    size_t size() const { return values_.size(); }
+
+private:
+    friend class DbConnection;
+    std::vector<std::string> values_;
+    std::vector<bool> nulls_;
+};
+
+// 预处理语句的完整结果集（mysql_stmt_store_result之后拷贝出来）
+class DbResult {
+public:
+    bool empty() const { return rows_.empty(); }
+    size_t size() const { return rows_.size(); }
+    const DbRow& operator[](size_t i) const { return rows_[i]; }
+    std::vector<DbRow>::const_iterator begin() const { return rows_.begin(); }
+    std::vector<DbRow>::const_iterator end() const { return rows_.end(); }
+
+private:
+    friend class DbConnection;
+    std::vector<DbRow> rows_;
+};
+
+// 单个MySQL连接，只能在创建它的线程中使用
+// 预处理语句按SQL文本缓存，同一连接上每条语句只prepare一次
+class DbConnection : mymuduo::noncopyable {
+public:
+    explicit DbConnection(const DbConfig& config);
+    ~DbConnection();
+
+    bool connected() const { return mysql_ != nullptr; }
+
+    // 执行预处理语句，result非空时取回结果集
+    // 连接断开时会重连并重试一次
+    bool execute(const std::string& sql,
+                 const std::vector<DbParam>& params = std::vector<DbParam>(),
+                 DbResult* result = nullptr);
+
+    // 最近一次execute插入的自增id
+    unsigned long long lastInsertId() const { return lastInsertId_; }
+    // 最近一次execute影响的行数
+    unsigned long long affectedRows() const { return affectedRows_; }
+
+    // 执行普通SQL（用于无法参数化的动态语句）
+    bool query(const std::string& sql);
+    MYSQL_RES* queryWithResult(const std::string& sql);
+    std::string escape(const std::string& str);
+
+    // ping服务器，失败则重连
+    bool checkHealth();
+    // 距离上次检查超过interval秒时才做健康检查
+    void checkHealthIfIdle(double interval);
+
+private:
+    bool connect();
+    void close();
+    MYSQL_STMT* prepare(const std::string& sql);
+    bool executeOnce(const std::string& sql, const std::vector<DbParam>& params,
+                     DbResult* result, unsigned int* err);
+    bool fetchAll(MYSQL_STMT* stmt, DbResult* result);
+
+    const DbConfig config_;
+    MYSQL* mysql_;
+    std::unordered_map<std::string, MYSQL_STMT*> statements_;  // SQL文本 -> 预处理语句
+    unsigned long long lastInsertId_;
+    unsigned long long affectedRows_;
+    mymuduo::Timestamp lastCheck_;
+};
+
+// 数据库连接池：每个ThreadPool工作线程持有自己的连接
+// 连接在线程第一次访问时创建，之后距离上次检查超过healthCheckInterval时在使用前检查。
+// 查询会阻塞调用线程，不要在EventLoop线程中访问
+class DbPool : mymuduo::noncopyable {
+public:
+    explicit DbPool(const DbConfig& config);
+    ~DbPool();
+
+    // 当前线程的连接
+    DbConnection& local();
+
+private:
+    const DbConfig config_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<DbConnection>> connections_;  // 所有线程的连接，由连接池统一释放
+};
@@ -0,0 +1,104 @@
+#include "FileListCache.h"
+
+FileListCache::FileListCache(size_t maxBytes)
+    : maxBytes_(maxBytes)
+    , bytes_(0)
+    , version_(0)
+    , sharedGeneration_(0)
+{
+}
+
+void FileListCache::setMaxBytes(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxBytes_ = maxBytes;
+    evict();
+}
+
+uint64_t FileListCache::version() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return version_;
+}
+
+bool FileListCache::get(int userId, const std::string& key, std::string* body) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(userId);
+    if (it == entries_.end()) {
+        return false;
+    }
+    Entry& entry = it->second;
+    auto page = entry.pages.find(key);
+    if (page == entry.pages.end()) {
+        return false;
+    }
+    if (page->second.withShared && page->second.sharedGeneration != sharedGeneration_) {
+        size_t bytes = pageBytes(key, page->second);
+        entry.bytes -= bytes;
+        bytes_ -= bytes;
+        entry.pages.erase(page);
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, entry.lru);
+    *body = page->second.body;
+    return true;
+}
+
+void FileListCache::put(int userId, const std::string& key, bool withShared, uint64_t version,
+                        const std::string& body) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (version != version_) {
+        return;
+    }
+    Page page{body, withShared, sharedGeneration_};
+    size_t bytes = pageBytes(key, page);
+    if (bytes > maxBytes_) {
+        return;
+    }
+
+    auto it = entries_.find(userId);
+    if (it == entries_.end()) {
+        lru_.push_front(userId);
+        it = entries_.emplace(userId, Entry{{}, 0, lru_.begin()}).first;
+    } else {
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+    }
+    Entry& entry = it->second;
+    auto old = entry.pages.find(key);
+    if (old != entry.pages.end()) {
+        size_t oldBytes = pageBytes(key, old->second);
+        entry.bytes -= oldBytes;
+        bytes_ -= oldBytes;
+        entry.pages.erase(old);
+    }
+    entry.pages.emplace(key, std::move(page));
+    entry.bytes += bytes;
+    bytes_ += bytes;
+    evict();
+}
+
+void FileListCache::invalidateUser(int userId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++version_;
+    auto it = entries_.find(userId);
+    if (it != entries_.end()) {
+        removeEntry(it);
+    }
+}
+
+void FileListCache::invalidateShared() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++version_;
+    // 页面在下次访问或被淘汰时才释放
+    ++sharedGeneration_;
+}
+
+void FileListCache::removeEntry(std::unordered_map<int, Entry>::iterator it) {
+    bytes_ -= it->second.bytes;
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
+
+void FileListCache::evict() {
+    while (bytes_ > maxBytes_ && !lru_.empty()) {
+        removeEntry(entries_.find(lru_.back()));
+    }
+}
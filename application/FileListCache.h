@@ -0,0 +1,63 @@
+#pragma once
+
+#include "base/noncopyable.h"
+
+#include <stdint.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 文件列表缓存：按用户保存/files每一页的响应，用户之间按LRU淘汰，总大小不超过字节预算
+// 用户自己的文件或分享发生变化时丢弃该用户的全部页面；
+// 别人分享给所有人的文件变化时，所有包含分享文件的页面一起失效
+class FileListCache : mymuduo::noncopyable {
+public:
+    explicit FileListCache(size_t maxBytes);
+
+    void setMaxBytes(size_t maxBytes);
+
+    // 查询数据库之前取得的版本号，put时版本号已变说明查询期间有失效，结果不放入缓存
+    uint64_t version();
+
+    // key是规范化后的分页参数
+    bool get(int userId, const std::string& key, std::string* body);
+    // withShared表示页面中包含别人分享的文件
+    void put(int userId, const std::string& key, bool withShared, uint64_t version,
+             const std::string& body);
+
+    // 用户自己的文件增删、分享变化，或有文件分享给该用户
+    void invalidateUser(int userId);
+    // 公开分享的文件变化，影响所有用户的分享列表
+    void invalidateShared();
+
+private:
+    struct Page {
+        std::string body;
+        bool withShared;
+        uint64_t sharedGeneration;  // 放入时的sharedGeneration_，不同时页面已失效
+    };
+
+    struct Entry {
+        std::unordered_map<std::string, Page> pages;
+        size_t bytes;
+        std::list<int>::iterator lru;
+    };
+
+    static const size_t kPageOverhead = 64;  // 每页除key和body外的估计内存开销
+
+    static size_t pageBytes(const std::string& key, const Page& page) {
+        return key.size() + page.body.size() + kPageOverhead;
+    }
+
+    void removeEntry(std::unordered_map<int, Entry>::iterator it);
+    void evict();
+
+    std::mutex mutex_;
+    size_t maxBytes_;
+    size_t bytes_;
+    uint64_t version_;           // 每次失效加一
+    uint64_t sharedGeneration_;  // 每次invalidateShared加一
+    std::list<int> lru_;         // 最近访问的用户在前
+    std::unordered_map<int, Entry> entries_;
+};
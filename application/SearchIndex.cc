@@ -0,0 +1,245 @@
+#include "SearchIndex.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+// 词首：前一个字符是ASCII的空白或标点
+bool isSeparator(char32_t c) {
+    return c < 0x80 && !((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'));
+}
+
+} // namespace
+
+SearchIndex::SearchIndex()
+    : postingCount_(0)
+    , staleCount_(0)
+{
+}
+
+std::u32string SearchIndex::normalize(const std::string& text) {
+    std::u32string result;
+    result.reserve(text.size());
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        size_t len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+        char32_t cp = 0;
+        if (len == 0 || i + len > text.size()) {
+            // 非法的UTF-8字节按替换字符处理
+            cp = 0xFFFD;
+            len = 1;
+        } else if (len == 1) {
+            cp = (c >= 'A' && c <= 'Z') ? static_cast<char32_t>(c - 'A' + 'a') : c;
+        } else {
+            cp = c & (0x7F >> len);
+            for (size_t k = 1; k < len; ++k) {
+                unsigned char next = static_cast<unsigned char>(text[i + k]);
+                if ((next & 0xC0) != 0x80) {
+                    cp = 0xFFFD;
+                    len = k;
+                    break;
+                }
+                cp = (cp << 6) | (next & 0x3F);
+            }
+        }
+        result.push_back(cp);
+        i += len;
+    }
+    return result;
+}
+
+std::vector<std::u32string> SearchIndex::splitTerms(const std::u32string& query) {
+    std::vector<std::u32string> terms;
+    std::u32string term;
+    for (char32_t c : query) {
+        if (c == ' ' || c == '\t' || c == 0x3000) {  // 含全角空格
+            if (!term.empty()) {
+                terms.push_back(term);
+                term.clear();
+            }
+        } else {
+            term.push_back(c);
+        }
+    }
+    if (!term.empty()) {
+        terms.push_back(term);
+    }
+    return terms;
+}
+
+uint64_t SearchIndex::gramKey(const char32_t* p, size_t n) {
+    // 每个码点21位，不足3个码点时低位补0（名字中不会出现U+0000）
+    uint64_t key = 0;
+    for (size_t i = 0; i < kMaxGram; ++i) {
+        key = (key << 21) | (i < n ? (p[i] & 0x1FFFFF) : 0);
+    }
+    return key;
+}
+
+int SearchIndex::matchRank(const std::u32string& name, const std::u32string& term) {
+    size_t pos = name.find(term);
+    if (pos == std::u32string::npos) {
+        return -1;
+    }
+    if (pos == 0) {
+        return name.size() == term.size() ? 0 : 1;
+    }
+    // 再找一个词首位置的匹配
+    for (; pos != std::u32string::npos; pos = name.find(term, pos + 1)) {
+        if (isSeparator(name[pos - 1])) {
+            return 2;
+        }
+    }
+    return 3;
+}
+
+void SearchIndex::add(int scope, int id, const std::string& name, const std::string& payload) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = documents_.find(id);
+    if (it != documents_.end()) {
+        dropDocument(it);
+    }
+    Document& doc = documents_[id];
+    doc.scope = scope;
+    doc.name = normalize(name);
+    doc.payload = payload;
+    indexDocument(id, doc);
+}
+
+void SearchIndex::remove(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = documents_.find(id);
+    if (it != documents_.end()) {
+        dropDocument(it);
+    }
+}
+
+void SearchIndex::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    documents_.clear();
+    scopes_.clear();
+    postingCount_ = 0;
+    staleCount_ = 0;
+}
+
+size_t SearchIndex::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return documents_.size();
+}
+
+void SearchIndex::indexDocument(int id, Document& doc) {
+    std::vector<uint64_t> keys;
+    const std::u32string& name = doc.name;
+    for (size_t i = 0; i < name.size(); ++i) {
+        for (size_t n = 1; n <= kMaxGram && i + n <= name.size(); ++n) {
+            keys.push_back(gramKey(name.data() + i, n));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    Postings& postings = scopes_[doc.scope];
+    for (uint64_t key : keys) {
+        postings[key].push_back(id);
+    }
+    doc.grams = keys.size();
+    postingCount_ += keys.size();
+}
+
+void SearchIndex::dropDocument(std::unordered_map<int, Document>::iterator it) {
+    staleCount_ += it->second.grams;
+    documents_.erase(it);
+
+    // 过期条目超过一半时按现有文档重建倒排表
+    if (staleCount_ > 1024 && staleCount_ * 2 > postingCount_) {
+        scopes_.clear();
+        postingCount_ = 0;
+        staleCount_ = 0;
+        for (auto& entry : documents_) {
+            indexDocument(entry.first, entry.second);
+        }
+    }
+}
+
+const std::vector<int>* SearchIndex::postingsFor(const Postings& postings,
+                                                 const std::u32string& term) const {
+    // 不超过3个码点的关键词本身就是一个n-gram，更长的取其中倒排表最短的三元组
+    size_t n = std::min(term.size(), kMaxGram);
+    const std::vector<int>* best = nullptr;
+    for (size_t i = 0; i + n <= term.size(); ++i) {
+        auto it = postings.find(gramKey(term.data() + i, n));
+        if (it == postings.end()) {
+            return nullptr;
+        }
+        if (!best || it->second.size() < best->size()) {
+            best = &it->second;
+        }
+    }
+    return best;
+}
+
+std::vector<SearchIndex::Hit> SearchIndex::search(int scope, const std::string& query,
+                                                  size_t offset, size_t limit, size_t* total) {
+    std::vector<Hit> hits;
+    *total = 0;
+    std::vector<std::u32string> terms = splitTerms(normalize(query));
+    if (terms.empty()) {
+        return hits;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto scopeIt = scopes_.find(scope);
+    if (scopeIt == scopes_.end()) {
+        return hits;
+    }
+    const std::vector<int>* shortest = nullptr;
+    for (const std::u32string& term : terms) {
+        const std::vector<int>* postings = postingsFor(scopeIt->second, term);
+        if (!postings) {
+            return hits;
+        }
+        if (!shortest || postings->size() < shortest->size()) {
+            shortest = postings;
+        }
+    }
+
+    // 改过名的文档可能在同一个倒排表中出现多次
+    std::vector<int> candidates(*shortest);
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // (级别, 名字长度, -id, 文档)
+    using Match = std::tuple<int, size_t, int, const Document*>;
+    std::vector<Match> matches;
+    for (int id : candidates) {
+        auto doc = documents_.find(id);
+        if (doc == documents_.end() || doc->second.scope != scope) {
+            continue;
+        }
+        int rank = 0;
+        for (const std::u32string& term : terms) {
+            int r = matchRank(doc->second.name, term);
+            if (r < 0) {
+                rank = -1;
+                break;
+            }
+            rank += r;
+        }
+        if (rank >= 0) {
+            matches.emplace_back(rank, doc->second.name.size(), -id, &doc->second);
+        }
+    }
+
+    *total = matches.size();
+    if (offset >= matches.size()) {
+        return hits;
+    }
+    size_t end = std::min(matches.size(), offset + limit);
+    std::partial_sort(matches.begin(), matches.begin() + static_cast<std::ptrdiff_t>(end), matches.end());
+    for (size_t i = offset; i < end; ++i) {
+        hits.push_back(Hit{-std::get<2>(matches[i]), std::get<3>(matches[i])->payload});
+    }
+    return hits;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "base/noncopyable.h"
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 内存中的名字搜索索引，支持中文和ASCII名字的子串、前缀搜索
+// 名字按Unicode码点切成1到3个码点的n-gram，倒排表记录包含每个n-gram的文档id；
+// 查询时从最短的倒排表取候选，再逐个核对名字是否包含全部关键词。
+// 每个文档属于一个范围（scope，例如文件的所有者），搜索只在一个范围内进行。
+// 删除和改名只去掉文档表中的旧记录，倒排表中过期的id在核对时跳过，过多时整体重建
+class SearchIndex : mymuduo::noncopyable {
+public:
+    struct Hit {
+        int id;
+        std::string payload;
+    };
+
+    SearchIndex();
+
+    // 加入文档，id已存在时视为改名；payload随搜索结果原样返回
+    void add(int scope, int id, const std::string& name, const std::string& payload);
+    void remove(int id);
+    void clear();
+    size_t size();
+
+    // 在scope中查找名字包含query中全部关键词（以空白分隔，ASCII不区分大小写）的文档。
+    // 名字与关键词相同、以关键词开头、关键词在词首、关键词在其他位置依次排在前面，
+    // 同级时名字短的在前，再按id从新到旧；返回从第offset个开始的至多limit个，total为匹配总数
+    std::vector<Hit> search(int scope, const std::string& query, size_t offset, size_t limit,
+                            size_t* total);
+
+private:
+    struct Document {
+        int scope;
+        std::u32string name;  // 规范化后的名字
+        std::string payload;
+        size_t grams;         // 在倒排表中的条目数
+    };
+
+    using Postings = std::unordered_map<uint64_t, std::vector<int>>;
+
+    static std::u32string normalize(const std::string& text);
+    static std::vector<std::u32string> splitTerms(const std::u32string& query);
+    static uint64_t gramKey(const char32_t* p, size_t n);
+    static int matchRank(const std::u32string& name, const std::u32string& term);
+
+    void indexDocument(int id, Document& doc);
+    void dropDocument(std::unordered_map<int, Document>::iterator it);
+    const std::vector<int>* postingsFor(const Postings& postings, const std::u32string& term) const;
+
+    static const size_t kMaxGram = 3;
+
+    std::mutex mutex_;
+    std::unordered_map<int, Document> documents_;
+    std::unordered_map<int, Postings> scopes_;  // scope -> n-gram -> 文档id
+    size_t postingCount_;  // 倒排表的总条目数，含过期条目
+    size_t staleCount_;    // 过期条目数
+};
@@ -0,0 +1,288 @@
+#include "SeekableGzip.h"
+#include "base/Logging.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// ID1 ID2 CM=deflate FLG=0 MTIME=0 XFL=0 OS=unix
+const char kGzipHeader[10] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3};
+
+void appendLittleEndian32(std::string* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+} // namespace
+
+SeekableGzipWriter::SeekableGzipWriter(int fd, bool adaptive)
+    : fd_(fd)
+    , mode_(adaptive ? kProbing : kCompressing)
+    , crc_(static_cast<uint32_t>(::crc32(0L, Z_NULL, 0)))
+    , rawBytes_(0)
+    , storedBytes_(0)
+    , error_(false)
+{
+    memset(&stream_, 0, sizeof(stream_));
+    // 负的windowBits表示不带zlib头尾的deflate数据，gzip头尾由这里自己写
+    if (::deflateInit2(&stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        LOG_ERROR << "deflateInit2 failed";
+        error_ = true;
+    }
+    frame_.reserve(kFrameSize);
+}
+
+SeekableGzipWriter::~SeekableGzipWriter() {
+    ::deflateEnd(&stream_);
+}
+
+bool SeekableGzipWriter::write(const char* data, size_t len) {
+    if (error_) {
+        return false;
+    }
+    rawBytes_ += len;
+    while (len > 0) {
+        size_t n = std::min(len, kFrameSize - frame_.size());
+        crc_ = static_cast<uint32_t>(::crc32(crc_, reinterpret_cast<const Bytef*>(data),
+                                              static_cast<uInt>(n)));
+        frame_.append(data, n);
+        data += n;
+        len -= n;
+        if (frame_.size() == kFrameSize && !flushFrame(false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SeekableGzipWriter::finish() {
+    return !error_ && flushFrame(true);
+}
+
+bool SeekableGzipWriter::flushFrame(bool last) {
+    if (mode_ == kRaw) {
+        bool ok = writeAll(frame_.data(), frame_.size());
+        frame_.clear();
+        return ok;
+    }
+
+    std::string out;
+    if (frameOffsets_.empty()) {
+        out.append(kGzipHeader, sizeof(kGzipHeader));
+    }
+    frameOffsets_.push_back(storedBytes_ + out.size());
+
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(frame_.data()));
+    stream_.avail_in = static_cast<uInt>(frame_.size());
+    char buf[64 * 1024];
+    do {
+        stream_.next_out = reinterpret_cast<Bytef*>(buf);
+        stream_.avail_out = sizeof(buf);
+        if (::deflate(&stream_, last ? Z_FINISH : Z_FULL_FLUSH) == Z_STREAM_ERROR) {
+            LOG_ERROR << "deflate failed";
+            error_ = true;
+            return false;
+        }
+        out.append(buf, sizeof(buf) - stream_.avail_out);
+    } while (stream_.avail_out == 0);
+    if (last) {
+        appendLittleEndian32(&out, crc_);
+        appendLittleEndian32(&out, static_cast<uint32_t>(rawBytes_));
+    }
+
+    if (mode_ == kProbing) {
+        if (out.size() >= frame_.size() / 10 * 9) {
+            // 第一帧压缩效果不明显（例如已经压缩过的图片、视频），整个文件按原样保存
+            mode_ = kRaw;
+            frameOffsets_.clear();
+            out.swap(frame_);
+        } else {
+            mode_ = kCompressing;
+        }
+    }
+    frame_.clear();
+    return writeAll(out.data(), out.size());
+}
+
+bool SeekableGzipWriter::writeAll(const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR << "SeekableGzipWriter failed to write, error: " << strerror(errno);
+            error_ = true;
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+        storedBytes_ += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool SeekableGzipWriter::writeIndex(const std::string& path) const {
+    std::ostringstream out;
+    out << rawBytes_ << " " << kFrameSize << " " << storedBytes_ << "\n";
+    for (uint64_t offset : frameOffsets_) {
+        out << offset << "\n";
+    }
+    std::string content = out.str();
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR << "Failed to create frame index " << path << ", error: " << strerror(errno);
+        return false;
+    }
+    bool ok = ::write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size());
+    ::close(fd);
+    if (!ok) {
+        LOG_ERROR << "Failed to write frame index " << path;
+        ::unlink(path.c_str());
+    }
+    return ok;
+}
+
+SeekableGzipReader::SeekableGzipReader()
+    : fd_(-1)
+    , inflating_(false)
+    , rawSize_(0)
+    , compressedSize_(0)
+    , frameSize_(0)
+    , skip_(0)
+    , remaining_(0)
+    , input_(kBufferSize)
+    , scratch_(kBufferSize)
+{
+    memset(&stream_, 0, sizeof(stream_));
+}
+
+SeekableGzipReader::~SeekableGzipReader() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    if (inflating_) {
+        ::inflateEnd(&stream_);
+    }
+}
+
+bool SeekableGzipReader::open(const std::string& path, const std::string& indexPath) {
+    std::ifstream in(indexPath);
+    if (!(in >> rawSize_ >> frameSize_ >> compressedSize_) || frameSize_ == 0) {
+        LOG_ERROR << "Invalid frame index " << indexPath;
+        return false;
+    }
+    frameOffsets_.clear();
+    uint64_t offset;
+    while (in >> offset) {
+        if (offset >= compressedSize_ || (!frameOffsets_.empty() && offset <= frameOffsets_.back())) {
+            break;
+        }
+        frameOffsets_.push_back(offset);
+    }
+    uint64_t frames = rawSize_ == 0 ? 1 : (rawSize_ + frameSize_ - 1) / frameSize_;
+    if (!in.eof() || frameOffsets_.size() != frames) {
+        LOG_ERROR << "Corrupted frame index " << indexPath;
+        return false;
+    }
+
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        LOG_ERROR << "Failed to open " << path << ", error: " << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd_, &st) != 0 || static_cast<uint64_t>(st.st_size) != compressedSize_) {
+        LOG_ERROR << "Compressed file " << path << " does not match its frame index";
+        return false;
+    }
+    if (::inflateInit2(&stream_, -15) != Z_OK) {
+        LOG_ERROR << "inflateInit2 failed";
+        return false;
+    }
+    inflating_ = true;
+    return true;
+}
+
+int SeekableGzipReader::releaseFd() {
+    int fd = fd_;
+    fd_ = -1;
+    return fd;
+}
+
+bool SeekableGzipReader::seek(uint64_t offset, uint64_t len) {
+    if (fd_ < 0 || !inflating_ || offset > rawSize_ || len > rawSize_ - offset) {
+        return false;
+    }
+    // 区间开头所在的帧，结尾正好在文件末尾的空区间也落在最后一帧
+    size_t frame = static_cast<size_t>(std::min<uint64_t>(offset / frameSize_, frameOffsets_.size() - 1));
+    if (::lseek(fd_, static_cast<off_t>(frameOffsets_[frame]), SEEK_SET) < 0 ||
+        ::inflateReset(&stream_) != Z_OK) {
+        return false;
+    }
+    stream_.avail_in = 0;
+    skip_ = offset - frame * frameSize_;
+    remaining_ = len;
+    return true;
+}
+
+ssize_t SeekableGzipReader::read(char* buf, size_t len) {
+    len = static_cast<size_t>(std::min<uint64_t>(len, remaining_));
+    if (len == 0) {
+        return 0;
+    }
+    while (true) {
+        if (stream_.avail_in == 0) {
+            ssize_t n = ::read(fd_, input_.data(), input_.size());
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                LOG_ERROR << "SeekableGzipReader unexpected end of compressed data";
+                return -1;
+            }
+            stream_.next_in = reinterpret_cast<Bytef*>(input_.data());
+            stream_.avail_in = static_cast<uInt>(n);
+        }
+
+        // 先解压并丢弃帧开头到offset之间的数据
+        char* dest = buf;
+        size_t want = len;
+        if (skip_ > 0) {
+            dest = scratch_.data();
+            want = static_cast<size_t>(std::min<uint64_t>(skip_, scratch_.size()));
+        }
+        stream_.next_out = reinterpret_cast<Bytef*>(dest);
+        stream_.avail_out = static_cast<uInt>(want);
+        int ret = ::inflate(&stream_, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            LOG_ERROR << "inflate failed: " << ret;
+            return -1;
+        }
+        size_t produced = want - stream_.avail_out;
+        if (skip_ > 0) {
+            skip_ -= produced;
+        } else if (produced > 0) {
+            remaining_ -= produced;
+            return static_cast<ssize_t>(produced);
+        }
+        if (ret == Z_STREAM_END || (ret == Z_BUF_ERROR && stream_.avail_in > 0)) {
+            LOG_ERROR << "SeekableGzipReader compressed data is shorter than its frame index";
+            return -1;
+        }
+    }
+}
+
+bool SeekableGzipReader::readRawSize(const std::string& indexPath, uint64_t* rawSize) {
+    std::ifstream in(indexPath);
+    return static_cast<bool>(in >> *rawSize);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "base/noncopyable.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <zlib.h>
+#include <string>
+#include <vector>
+
+// 可以随机读取的gzip文件
+// 每kFrameSize字节原始数据做一次Z_FULL_FLUSH，之后的压缩数据从字节边界开始且不引用之前的内容，
+// 因此每一帧都可以从它的压缩偏移处单独解压；整个文件仍是一个标准的gzip流，
+// 可以原样作为 Content-Encoding: gzip 的响应体发送。
+// 帧索引单独保存为文本：第一行是原始大小和帧大小，之后每行一个帧的压缩偏移
+class SeekableGzipWriter : mymuduo::noncopyable {
+public:
+    static const size_t kFrameSize = 1024 * 1024;
+
+    // 数据写入fd（不取得所有权）。adaptive为true时先试压第一帧，
+    // 压缩后仍有原大小的90%以上时放弃压缩，整个文件按原样写入
+    SeekableGzipWriter(int fd, bool adaptive);
+    ~SeekableGzipWriter();
+
+    bool write(const char* data, size_t len);
+    // 写入剩余数据和gzip尾部
+    bool finish();
+
+    // finish之后有效，false表示文件中是原始数据
+    bool compressed() const { return mode_ == kCompressing; }
+    uint64_t rawBytes() const { return rawBytes_; }
+    uint64_t storedBytes() const { return storedBytes_; }
+
+    // 把帧索引写入path，只在compressed()时有意义
+    bool writeIndex(const std::string& path) const;
+
+private:
+    enum Mode { kProbing, kCompressing, kRaw };
+
+    bool flushFrame(bool last);
+    bool writeAll(const char* data, size_t len);
+
+    int fd_;
+    Mode mode_;
+    z_stream stream_;
+    std::string frame_;                  // 当前帧还没有压缩的数据
+    std::vector<uint64_t> frameOffsets_; // 每一帧在文件中的压缩偏移
+    uint32_t crc_;
+    uint64_t rawBytes_;
+    uint64_t storedBytes_;
+    bool error_;
+};
+
+// 读取SeekableGzipWriter写出的文件中任意一段原始数据
+class SeekableGzipReader : mymuduo::noncopyable {
+public:
+    SeekableGzipReader();
+    ~SeekableGzipReader();
+
+    // 打开压缩文件及其帧索引，索引与文件不符时返回false
+    bool open(const std::string& path, const std::string& indexPath);
+
+    uint64_t rawSize() const { return rawSize_; }
+    uint64_t compressedSize() const { return compressedSize_; }
+    // 把压缩文件的描述符交给调用者（用于原样发送），之后不能再read
+    int releaseFd();
+
+    // 定位到原始数据的offset处，之后最多读取len个字节
+    bool seek(uint64_t offset, uint64_t len);
+    // 返回读到的字节数，0表示已经读完seek指定的区间，-1表示出错
+    ssize_t read(char* buf, size_t len);
+    // seek指定的区间内还没有读出的字节数
+    uint64_t remaining() const { return remaining_; }
+
+    // 读取帧索引中记录的原始大小
+    static bool readRawSize(const std::string& indexPath, uint64_t* rawSize);
+
+private:
+    static const size_t kBufferSize = 64 * 1024;
+
+    int fd_;
+    z_stream stream_;
+    bool inflating_;
+    uint64_t rawSize_;
+    uint64_t compressedSize_;
+    uint64_t frameSize_;
+    std::vector<uint64_t> frameOffsets_;
+    uint64_t skip_;       // 定位的帧开头到offset之间需要丢弃的字节数
+    uint64_t remaining_;  // 区间内还没有读出的字节数
+    std::vector<char> input_;
+    std::vector<char> scratch_;
+};
@@ -0,0 +1,72 @@
+#include "SessionCache.h"
+
+using namespace mymuduo;
+
+SessionCache::SessionCache(double ttlSeconds)
+    : ttl_(ttlSeconds)
+{
+}
+
+bool SessionCache::touch(const std::string& sessionId, int* userId, std::string* username) {
+    Shard& shard = shardFor(sessionId);
+    Timestamp now = Timestamp::now();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(sessionId);
+    if (it == shard.sessions.end()) {
+        return false;
+    }
+    Entry& entry = it->second;
+    if (entry.expireTime < now) {
+        shard.sessions.erase(it);
+        return false;
+    }
+    entry.expireTime = addTime(now, ttl_);
+    entry.dirty = true;
+    *userId = entry.userId;
+    *username = entry.username;
+    return true;
+}
+
+void SessionCache::put(const std::string& sessionId, int userId, const std::string& username) {
+    Shard& shard = shardFor(sessionId);
+    Entry entry = { userId, username, addTime(Timestamp::now(), ttl_), false };
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.sessions[sessionId] = std::move(entry);
+}
+
+void SessionCache::remove(const std::string& sessionId) {
+    Shard& shard = shardFor(sessionId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.sessions.erase(sessionId);
+}
+
+std::vector<std::string> SessionCache::takeDirty() {
+    std::vector<std::string> dirty;
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& entry : shard.sessions) {
+            if (entry.second.dirty) {
+                entry.second.dirty = false;
+                dirty.push_back(entry.first);
+            }
+        }
+    }
+    return dirty;
+}
+
+size_t SessionCache::evictExpired() {
+    size_t evicted = 0;
+    Timestamp now = Timestamp::now();
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+            if (it->second.expireTime < now) {
+                it = shard.sessions.erase(it);
+                ++evicted;
+            } else {
+                ++it;
+            }
+        }
+    }
+    return evicted;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "base/noncopyable.h"
+#include "base/Timestamp.h"
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 进程内的会话表，按session_id分片加锁
+// 每次访问只在内存中滑动过期时间并标记为脏，
+// 由定时任务通过takeDirty()取出后批量写回数据库
+class SessionCache : mymuduo::noncopyable {
+public:
+    explicit SessionCache(double ttlSeconds);
+
+    // 查找会话并把过期时间顺延ttl，未命中或已过期返回false
+    bool touch(const std::string& sessionId, int* userId, std::string* username);
+
+    // 登录或从数据库加载后放入缓存
+    void put(const std::string& sessionId, int userId, const std::string& username);
+
+    void remove(const std::string& sessionId);
+
+    // 取出自上次调用以来被访问过的会话id，并清除脏标记
+    std::vector<std::string> takeDirty();
+
+    // 删除内存中已经过期的会话
+    size_t evictExpired();
+
+    double ttl() const { return ttl_; }
+
+private:
+    struct Entry {
+        int userId;
+        std::string username;
+        mymuduo::Timestamp expireTime;
+        bool dirty;  // 过期时间是否尚未写回数据库
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> sessions;
+    };
+
+    static const size_t kNumShards = 16;
+
+    Shard& shardFor(const std::string& sessionId) {
+        return shards_[std::hash<std::string>()(sessionId) % kNumShards];
+    }
+
+    const double ttl_;
+    std::array<Shard, kNumShards> shards_;
+};
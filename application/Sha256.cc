@@ -0,0 +1,172 @@
+#include "Sha256.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+} // namespace
+
+Sha256::Sha256() {
+    reset();
+}
+
+void Sha256::reset() {
+    state_[0] = 0x6a09e667;
+    state_[1] = 0xbb67ae85;
+    state_[2] = 0x3c6ef372;
+    state_[3] = 0xa54ff53a;
+    state_[4] = 0x510e527f;
+    state_[5] = 0x9b05688c;
+    state_[6] = 0x1f83d9ab;
+    state_[7] = 0x5be0cd19;
+    totalBytes_ = 0;
+    blockLen_ = 0;
+}
+
+void Sha256::transform(const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = static_cast<uint32_t>(block[i * 4]) << 24 |
+               static_cast<uint32_t>(block[i * 4 + 1]) << 16 |
+               static_cast<uint32_t>(block[i * 4 + 2]) << 8 |
+               static_cast<uint32_t>(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + kRoundConstants[i] + w[i];
+        uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+}
+
+void Sha256::update(const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    totalBytes_ += len;
+    if (blockLen_ > 0) {
+        size_t n = std::min(len, sizeof block_ - blockLen_);
+        ::memcpy(block_ + blockLen_, p, n);
+        blockLen_ += n;
+        p += n;
+        len -= n;
+        if (blockLen_ < sizeof block_) {
+            return;
+        }
+        transform(block_);
+        blockLen_ = 0;
+    }
+    // 整块直接从调用者的缓冲区计算，不拷贝
+    while (len >= sizeof block_) {
+        transform(p);
+        p += sizeof block_;
+        len -= sizeof block_;
+    }
+    if (len > 0) {
+        ::memcpy(block_, p, len);
+        blockLen_ = len;
+    }
+}
+
+std::string Sha256::hexDigest() {
+    uint64_t bitLength = totalBytes_ * 8;
+    block_[blockLen_++] = 0x80;
+    if (blockLen_ > 56) {
+        ::memset(block_ + blockLen_, 0, sizeof block_ - blockLen_);
+        transform(block_);
+        blockLen_ = 0;
+    }
+    ::memset(block_ + blockLen_, 0, 56 - blockLen_);
+    for (int i = 0; i < 8; ++i) {
+        block_[56 + i] = static_cast<uint8_t>(bitLength >> (56 - i * 8));
+    }
+    transform(block_);
+
+    static const char kHex[] = "0123456789abcdef";
+    std::string digest(kDigestLength * 2, '0');
+    for (size_t i = 0; i < 8; ++i) {
+        for (size_t j = 0; j < 4; ++j) {
+            uint8_t byte = static_cast<uint8_t>(state_[i] >> (24 - j * 8));
+            digest[(i * 4 + j) * 2] = kHex[byte >> 4];
+            digest[(i * 4 + j) * 2 + 1] = kHex[byte & 0x0f];
+        }
+    }
+    reset();
+    return digest;
+}
+
+bool Sha256::updateFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    std::vector<char> buf(1024 * 1024);
+    bool ok = true;
+    while (true) {
+        ssize_t n = ::read(fd, buf.data(), buf.size());
+        if (n > 0) {
+            update(buf.data(), static_cast<size_t>(n));
+        } else if (n == 0) {
+            break;
+        } else if (errno != EINTR) {
+            ok = false;
+            break;
+        }
+    }
+    ::close(fd);
+    return ok;
+}
+
+bool Sha256::hashFile(const std::string& path, std::string* hexDigest) {
+    Sha256 sha;
+    if (!sha.updateFile(path)) {
+        return false;
+    }
+    *hexDigest = sha.hexDigest();
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// 增量计算SHA-256，用于在上传数据写盘的同时得到文件内容的哈希
+class Sha256 {
+public:
+    static const size_t kDigestLength = 32;
+
+    Sha256();
+
+    void update(const void* data, size_t len);
+    // 读取整个文件加入计算，读取失败返回false
+    bool updateFile(const std::string& path);
+    // 结束计算并返回64个字符的小写十六进制摘要，之后对象回到初始状态
+    std::string hexDigest();
+
+    // 计算文件内容的哈希，读取失败返回false
+    static bool hashFile(const std::string& path, std::string* hexDigest);
+
+private:
+    void reset();
+    void transform(const uint8_t* block);
+
+    uint32_t state_[8];
+    uint64_t totalBytes_;
+    uint8_t block_[64];
+    size_t blockLen_;
+};
@@ -0,0 +1,103 @@
+#include "ShareCache.h"
+
+#include <algorithm>
+
+using namespace mymuduo;
+
+ShareCache::ShareCache(size_t capacity, double ttlSeconds, double negativeTtlSeconds)
+    : capacity_(capacity)
+    , ttl_(ttlSeconds)
+    , negativeTtl_(negativeTtlSeconds)
+    , version_(0)
+{
+}
+
+uint64_t ShareCache::version() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return version_;
+}
+
+bool ShareCache::get(const std::string& shareCode, std::shared_ptr<const ShareRecord>* share) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(shareCode);
+    if (it == entries_.end()) {
+        return false;
+    }
+    if (it->second.expireTime < Timestamp::now()) {
+        removeEntry(it);
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    *share = it->second.share;
+    return true;
+}
+
+void ShareCache::put(const std::string& shareCode, std::shared_ptr<const ShareRecord> share,
+                     double remainingSeconds, uint64_t version) {
+    double ttl = share ? ttl_ : negativeTtl_;
+    if (share && remainingSeconds >= 0) {
+        // 分享过期后不能再从缓存中取到
+        ttl = std::min(ttl, remainingSeconds);
+    }
+    if (ttl <= 0 || capacity_ == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (version != version_) {
+        return;
+    }
+    auto it = entries_.find(shareCode);
+    if (it != entries_.end()) {
+        removeEntry(it);
+    }
+    if (share) {
+        fileCodes_[share->fileId].insert(shareCode);
+    }
+    lru_.push_front(shareCode);
+    entries_[shareCode] = Entry{std::move(share), addTime(Timestamp::now(), ttl), lru_.begin()};
+
+    while (entries_.size() > capacity_) {
+        removeEntry(entries_.find(lru_.back()));
+    }
+}
+
+void ShareCache::remove(const std::string& shareCode) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++version_;
+    auto it = entries_.find(shareCode);
+    if (it != entries_.end()) {
+        removeEntry(it);
+    }
+}
+
+void ShareCache::removeFile(int fileId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++version_;
+    auto codes = fileCodes_.find(fileId);
+    if (codes == fileCodes_.end()) {
+        return;
+    }
+    // removeEntry会修改fileCodes_，先拷贝出来
+    std::unordered_set<std::string> shareCodes = codes->second;
+    for (const std::string& code : shareCodes) {
+        auto it = entries_.find(code);
+        if (it != entries_.end()) {
+            removeEntry(it);
+        }
+    }
+}
+
+void ShareCache::removeEntry(std::unordered_map<std::string, Entry>::iterator it) {
+    if (it->second.share) {
+        auto codes = fileCodes_.find(it->second.share->fileId);
+        if (codes != fileCodes_.end()) {
+            codes->second.erase(it->first);
+            if (codes->second.empty()) {
+                fileCodes_.erase(codes);
+            }
+        }
+    }
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "base/noncopyable.h"
+#include "base/Timestamp.h"
+
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// 一条分享及其文件、所有者的信息
+struct ShareRecord {
+    int shareId;
+    int fileId;
+    int ownerId;
+    int sharedWithId;         // 0表示不是指定用户分享
+    std::string shareType;
+    std::string shareCode;
+    std::string extractCode;
+    std::string createdAt;
+    std::string expireTime;   // 空表示永不过期
+    std::string filename;
+    std::string originalFilename;
+    uint64_t fileSize;
+    std::string fileType;
+    std::string contentHash;
+    std::string ownerUsername;
+};
+
+// 分享码 -> 分享信息的缓存，容量有限，按LRU淘汰
+// 不存在的分享码也会缓存一段时间（负缓存），随机猜测分享码的请求不会每次都查询数据库。
+// 缓存时间不超过分享本身的剩余有效期；分享或文件被删除时按文件id失效
+class ShareCache : mymuduo::noncopyable {
+public:
+    ShareCache(size_t capacity, double ttlSeconds, double negativeTtlSeconds);
+
+    // 查询数据库之前取得的版本号，put时版本号已变说明查询期间有失效，结果不放入缓存
+    uint64_t version();
+
+    // 命中时返回true，*share为空指针表示分享码不存在
+    bool get(const std::string& shareCode, std::shared_ptr<const ShareRecord>* share);
+
+    // share为空指针时作为不存在缓存；remainingSeconds为分享的剩余有效期，小于0表示永不过期
+    void put(const std::string& shareCode, std::shared_ptr<const ShareRecord> share,
+             double remainingSeconds, uint64_t version);
+
+    // 新建分享时去掉该分享码可能存在的负缓存
+    void remove(const std::string& shareCode);
+    // 文件的分享被取消或文件被删除
+    void removeFile(int fileId);
+
+private:
+    struct Entry {
+        std::shared_ptr<const ShareRecord> share;
+        mymuduo::Timestamp expireTime;
+        std::list<std::string>::iterator lru;
+    };
+
+    void removeEntry(std::unordered_map<std::string, Entry>::iterator it);
+
+    const size_t capacity_;
+    const double ttl_;
+    const double negativeTtl_;
+
+    std::mutex mutex_;
+    uint64_t version_;            // 每次失效加一
+    std::list<std::string> lru_;  // 最近访问的分享码在前
+    std::unordered_map<std::string, Entry> entries_;
+    std::unordered_map<int, std::unordered_set<std::string>> fileCodes_;  // 文件id -> 已缓存的分享码
+};
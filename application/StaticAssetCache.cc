@@ -0,0 +1,188 @@
+#include "StaticAssetCache.h"
+#include "Sha256.h"
+#include "base/Logging.h"
+#include "net/Channel.h"
+#include "net/EventLoop.h"
+#include "net/HttpRequest.h"
+#include "net/HttpResponse.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fstream>
+#include <iterator>
+
+using namespace mymuduo;
+using namespace mymuduo::net;
+
+namespace {
+
+// If-None-Match中是否有与etag相同的实体标签，按弱比较（忽略W/前缀）
+bool etagMatches(const std::string& ifNoneMatch, const std::string& etag) {
+    size_t start = 0;
+    while (start < ifNoneMatch.size()) {
+        size_t comma = ifNoneMatch.find(',', start);
+        if (comma == std::string::npos) {
+            comma = ifNoneMatch.size();
+        }
+        std::string tag = ifNoneMatch.substr(start, comma - start);
+        start = comma + 1;
+
+        size_t begin = tag.find_first_not_of(" \t");
+        if (begin == std::string::npos) {
+            continue;
+        }
+        tag = tag.substr(begin, tag.find_last_not_of(" \t") - begin + 1);
+        if (tag.compare(0, 2, "W/") == 0) {
+            tag.erase(0, 2);
+        }
+        if (tag == "*" || tag == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+StaticAssetCache::StaticAssetCache()
+    : generation_(0)
+    , inotifyFd_(-1)
+{
+}
+
+StaticAssetCache::~StaticAssetCache() {
+    if (channel_) {
+        channel_->disableAll();
+        channel_->remove();
+    }
+    if (inotifyFd_ >= 0) {
+        ::close(inotifyFd_);
+    }
+}
+
+bool StaticAssetCache::watch(EventLoop* loop, const std::string& dir) {
+    if (inotifyFd_ < 0) {
+        inotifyFd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd_ < 0) {
+            LOG_ERROR << "inotify_init1 failed: " << strerror(errno);
+            return false;
+        }
+        channel_.reset(new Channel(loop, inotifyFd_));
+        channel_->setReadCallback(std::bind(&StaticAssetCache::handleRead, this, std::placeholders::_1));
+        channel_->enableReading();
+    }
+    int wd = ::inotify_add_watch(inotifyFd_, dir.c_str(),
+                                 IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+    if (wd < 0) {
+        LOG_ERROR << "Failed to watch " << dir << ": " << strerror(errno);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    watchedDirs_[wd] = dir;
+    return true;
+}
+
+std::shared_ptr<const StaticAssetCache::Asset> StaticAssetCache::get(const std::string& path,
+                                                                     const std::string& contentType,
+                                                                     const std::string& cacheControl) {
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = assets_.find(path);
+        if (it != assets_.end()) {
+            return it->second;
+        }
+        generation = generation_;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return nullptr;
+    }
+    auto asset = std::make_shared<Asset>();
+    asset->contentType = contentType;
+    asset->cacheControl = cacheControl;
+    std::string& body = asset->encoded[ContentEncoding::kIdentity];
+    body.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    Sha256 sha;
+    sha.update(body.data(), body.size());
+    asset->etag = "\"" + sha.hexDigest().substr(0, 16) + "\"";
+    for (ContentEncoding::Coding coding : {ContentEncoding::kGzip, ContentEncoding::kBrotli}) {
+        std::string encoded;
+        if (ContentEncoding::available(coding) &&
+            ContentEncoding::encode(coding, body, &encoded, true) && encoded.size() < body.size()) {
+            asset->encoded[coding].swap(encoded);
+        }
+    }
+    LOG_INFO << "Loaded static asset " << path << ", size: " << body.size()
+             << ", gzip: " << asset->encoded[ContentEncoding::kGzip].size()
+             << ", br: " << asset->encoded[ContentEncoding::kBrotli].size();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 读取期间有文件变化时，读到的内容可能已经过期，只用于这一次请求
+    if (generation == generation_) {
+        assets_[path] = asset;
+    }
+    return asset;
+}
+
+void StaticAssetCache::serve(const std::shared_ptr<const Asset>& assetPtr, const HttpRequest& req,
+                             HttpResponse* resp) {
+    const Asset& asset = *assetPtr;
+    ContentEncoding::Coding coding = ContentEncoding::negotiate(req.getHeader("Accept-Encoding"));
+    if (asset.encoded[coding].empty()) {
+        coding = ContentEncoding::kIdentity;
+    }
+    // 同一内容的不同编码是不同的表示，强ETag也要不同
+    std::string etag = asset.etag;
+    if (coding != ContentEncoding::kIdentity) {
+        etag.insert(etag.size() - 1, std::string("-") + ContentEncoding::name(coding));
+    }
+
+    resp->setContentType(asset.contentType);
+    resp->addHeader("ETag", etag);
+    resp->addHeader("Cache-Control", asset.cacheControl);
+    if (!asset.encoded[ContentEncoding::kGzip].empty() || !asset.encoded[ContentEncoding::kBrotli].empty()) {
+        resp->addHeader("Vary", "Accept-Encoding");
+    }
+    if (etagMatches(req.getHeader("If-None-Match"), etag)) {
+        resp->setStatusCode(HttpResponse::k304NotModified);
+        resp->setStatusMessage("Not Modified");
+        return;
+    }
+
+    resp->setStatusCode(HttpResponse::k200Ok);
+    resp->setStatusMessage("OK");
+    if (coding != ContentEncoding::kIdentity) {
+        resp->addHeader("Content-Encoding", ContentEncoding::name(coding));
+    }
+    resp->setBody(std::shared_ptr<const std::string>(assetPtr, &asset.encoded[coding]));
+}
+
+void StaticAssetCache::handleRead(Timestamp receiveTime) {
+    alignas(struct inotify_event) char buf[4096];
+    while (true) {
+        ssize_t n = ::read(inotifyFd_, buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+        for (char* p = buf; p < buf + n; ) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+            if (event->mask & IN_Q_OVERFLOW) {
+                // 丢失了事件，无法知道哪些文件变了
+                assets_.clear();
+            } else if (event->len > 0) {
+                auto dir = watchedDirs_.find(event->wd);
+                if (dir != watchedDirs_.end() && assets_.erase(dir->second + "/" + event->name) > 0) {
+                    LOG_INFO << "Static asset " << dir->second << "/" << event->name << " changed";
+                }
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
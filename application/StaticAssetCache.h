@@ -0,0 +1,58 @@
+#pragma once
+
+#include "base/noncopyable.h"
+#include "base/Timestamp.h"
+#include "net/ContentEncoding.h"
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace mymuduo {
+namespace net {
+class Channel;
+class EventLoop;
+class HttpRequest;
+class HttpResponse;
+} // namespace net
+} // namespace mymuduo
+
+// 静态资源缓存
+// 文件第一次被请求时读入内存，计算强ETag并按每种内容编码预先压缩一次，之后的请求不再访问磁盘。
+// 用inotify监视文件所在的目录，文件被修改、替换或删除后丢弃缓存，下次请求时重新加载
+class StaticAssetCache : mymuduo::noncopyable {
+public:
+    struct Asset {
+        std::string contentType;
+        std::string cacheControl;
+        std::string etag;         // 未压缩内容的ETag，压缩版本在引号内加上编码名
+        std::string encoded[3];   // 下标为ContentEncoding::Coding，为空表示该编码不可用或没有变小
+    };
+
+    StaticAssetCache();
+    ~StaticAssetCache();
+
+    // 在loop上监视dir中文件的变化，需在loop所在线程中调用；失败时缓存的文件不再更新
+    bool watch(mymuduo::net::EventLoop* loop, const std::string& dir);
+
+    // 取出path的缓存，没有时从磁盘加载；文件不存在时返回空指针
+    std::shared_ptr<const Asset> get(const std::string& path, const std::string& contentType,
+                                     const std::string& cacheControl);
+
+    // 按请求填写resp：If-None-Match与ETag匹配时返回304，否则按Accept-Encoding选择预先压缩的版本
+    // 响应体与缓存共享，不拷贝
+    static void serve(const std::shared_ptr<const Asset>& asset, const mymuduo::net::HttpRequest& req,
+                      mymuduo::net::HttpResponse* resp);
+
+private:
+    void handleRead(mymuduo::Timestamp receiveTime);
+
+    std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<const Asset>> assets_;  // 文件路径 -> 缓存
+    uint64_t generation_;  // 每次收到文件变化时加一，用于丢弃与变化交错的加载结果
+    int inotifyFd_;
+    std::map<int, std::string> watchedDirs_;  // inotify watch描述符 -> 目录
+    std::unique_ptr<mymuduo::net::Channel> channel_;
+};
@@ -0,0 +1,171 @@
+#include "UploadSession.h"
+#include "base/Logging.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace mymuduo;
+
+UploadSession::UploadSession(const std::string& uploadId, const std::string& filepath,
+                             const std::string& originalFilename, int userId,
+                             uint64_t fileSize, size_t chunkSize)
+    : uploadId_(uploadId)
+    , filepath_(filepath)
+    , originalFilename_(originalFilename)
+    , userId_(userId)
+    , fileSize_(fileSize)
+    , chunkSize_(chunkSize)
+    , fd_(-1)
+    , committed_(false)
+    , received_(static_cast<size_t>((fileSize + chunkSize - 1) / chunkSize), false)
+    , receivedCount_(0)
+    , inflight_(0)
+    , finished_(false)
+    , lastActive_(Timestamp::now())
+{
+}
+
+UploadSession::~UploadSession() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    if (!committed_) {
+        ::unlink(filepath_.c_str());
+        LOG_INFO << "Upload session " << uploadId_ << " discarded, removed " << filepath_;
+    }
+}
+
+bool UploadSession::open() {
+    fd_ = ::open(filepath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        LOG_ERROR << "Failed to create file: " << filepath_ << ", error: " << strerror(errno);
+        return false;
+    }
+    // 预先分配磁盘空间，各分块乱序写入时不会产生碎片，空间不足也能在开始时发现
+    int err = ::posix_fallocate(fd_, 0, static_cast<off_t>(fileSize_));
+    if (err == EOPNOTSUPP || err == EINVAL) {
+        // 文件系统不支持预分配，退化为设置文件长度
+        err = ::ftruncate(fd_, static_cast<off_t>(fileSize_)) == 0 ? 0 : errno;
+    }
+    if (err != 0) {
+        LOG_ERROR << "Failed to allocate " << fileSize_ << " bytes for " << filepath_
+                  << ", error: " << strerror(err);
+        return false;
+    }
+    return true;
+}
+
+size_t UploadSession::chunkLength(size_t index) const {
+    uint64_t offset = chunkOffset(index);
+    if (offset >= fileSize_) {
+        return 0;
+    }
+    uint64_t remaining = fileSize_ - offset;
+    return remaining < chunkSize_ ? static_cast<size_t>(remaining) : chunkSize_;
+}
+
+bool UploadSession::beginChunk(size_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_ || index >= received_.size()) {
+        return false;
+    }
+    ++inflight_;
+    lastActive_ = Timestamp::now();
+    return true;
+}
+
+void UploadSession::endChunk(size_t index, bool ok) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --inflight_;
+    lastActive_ = Timestamp::now();
+    if (ok && !received_[index]) {
+        received_[index] = true;
+        ++receivedCount_;
+    }
+}
+
+bool UploadSession::writeAt(uint64_t offset, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::pwrite(fd_, data, len, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR << "Failed to write to file: " << filepath_ << ", errno: " << errno;
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+size_t UploadSession::receivedCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return receivedCount_;
+}
+
+std::vector<size_t> UploadSession::missingChunks() const {
+    std::vector<size_t> missing;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < received_.size(); ++i) {
+        if (!received_[i]) {
+            missing.push_back(i);
+        }
+    }
+    return missing;
+}
+
+bool UploadSession::finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_) {
+        return false;
+    }
+    if (receivedCount_ != received_.size() || inflight_ > 0) {
+        return false;
+    }
+    finished_ = true;
+    return true;
+}
+
+Timestamp UploadSession::lastActive() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lastActive_;
+}
+
+void UploadSessionStore::add(const UploadSessionPtr& session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessions_[session->uploadId()] = session;
+}
+
+UploadSessionStore::UploadSessionPtr UploadSessionStore::get(const std::string& uploadId) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(uploadId);
+    return it == sessions_.end() ? UploadSessionPtr() : it->second;
+}
+
+void UploadSessionStore::remove(const std::string& uploadId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessions_.erase(uploadId);
+}
+
+size_t UploadSessionStore::evictIdle(double idleSeconds) {
+    std::vector<UploadSessionPtr> evicted;
+    Timestamp now = Timestamp::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = sessions_.begin(); it != sessions_.end();) {
+            if (timeDifference(now, it->second->lastActive()) > idleSeconds) {
+                evicted.push_back(it->second);
+                it = sessions_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    // 会话（及其文件）在锁外释放
+    return evicted.size();
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "base/noncopyable.h"
+#include "base/Timestamp.h"
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 分块上传会话
+// 文件在创建会话时按总大小预分配，各个分块可以从多条连接并行上传，
+// 用pwrite写到各自的偏移，互不干扰；收到的分块记录在位图中，
+// 连接中断后客户端查询缺失的分块继续上传即可
+class UploadSession : mymuduo::noncopyable {
+public:
+    UploadSession(const std::string& uploadId, const std::string& filepath,
+                  const std::string& originalFilename, int userId,
+                  uint64_t fileSize, size_t chunkSize);
+    // 没有完成（commit）的会话删除已写入的文件
+    ~UploadSession();
+
+    // 创建并预分配文件，失败返回false
+    bool open();
+
+    const std::string& uploadId() const { return uploadId_; }
+    const std::string& filepath() const { return filepath_; }
+    const std::string& originalFilename() const { return originalFilename_; }
+    int userId() const { return userId_; }
+    uint64_t fileSize() const { return fileSize_; }
+    size_t chunkSize() const { return chunkSize_; }
+    size_t chunkCount() const { return received_.size(); }
+
+    uint64_t chunkOffset(size_t index) const { return static_cast<uint64_t>(index) * chunkSize_; }
+    size_t chunkLength(size_t index) const;
+
+    // 开始写入一个分块；会话已经完成或下标越界时返回false
+    bool beginChunk(size_t index);
+    // 分块写入结束，ok表示完整收到，之后该分块被标记为已接收
+    void endChunk(size_t index, bool ok);
+
+    // 在文件的offset处写入数据，可以在任意线程中调用
+    bool writeAt(uint64_t offset, const char* data, size_t len);
+
+    size_t receivedCount() const;
+    std::vector<size_t> missingChunks() const;
+
+    // 所有分块都已收到且没有正在写入的分块时，把会话标记为完成并返回true
+    // 之后不再接受新的分块
+    bool finish();
+    // 文件已经入库，析构时保留
+    void commit() { committed_ = true; }
+
+    mymuduo::Timestamp lastActive() const;
+
+private:
+    const std::string uploadId_;
+    const std::string filepath_;
+    const std::string originalFilename_;
+    const int userId_;
+    const uint64_t fileSize_;
+    const size_t chunkSize_;
+    int fd_;
+    bool committed_;
+
+    mutable std::mutex mutex_;
+    std::vector<bool> received_;  // 分块位图
+    size_t receivedCount_;
+    int inflight_;                // 正在写入的分块数
+    bool finished_;
+    mymuduo::Timestamp lastActive_;
+};
+
+// 进行中的分块上传会话表
+class UploadSessionStore : mymuduo::noncopyable {
+public:
+    using UploadSessionPtr = std::shared_ptr<UploadSession>;
+
+    void add(const UploadSessionPtr& session);
+    UploadSessionPtr get(const std::string& uploadId) const;
+    void remove(const std::string& uploadId);
+
+    // 删除超过idleSeconds没有活动的会话，返回删除的个数
+    size_t evictIdle(double idleSeconds);
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, UploadSessionPtr> sessions_;
+};
@@ -0,0 +1,249 @@
+#include "net/TcpServer.h"
+#include "net/EventLoop.h"
+#include "net/InetAddress.h"
+#include "net/TcpConnection.h"
+#include "net/TimerId.h"
+#include "base/Logging.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mymuduo;
+using namespace mymuduo::net;
+
+// 边沿触发（EPOLLET）与水平触发的对比测试
+// 一个IO线程上同时有持续上传的连接、一问一答的短消息连接和大量空闲连接，
+// 统计上传吞吐、服务器读回调次数，以及上传压力下短消息的往返延迟
+// 用法：./epoll_bench [秒数] [上传连接数] [问答连接数] [空闲连接数]
+
+namespace {
+
+const int kPingSize = 64;
+const size_t kUploadBlock = 64 * 1024;
+
+struct Options {
+    int seconds = 5;
+    int heavy = 4;
+    int light = 8;
+    int idle = 1000;
+};
+
+struct Result {
+    double uploadMBps = 0;
+    long callbacks = 0;
+    size_t pings = 0;
+    double p50Us = 0;
+    double p99Us = 0;
+};
+
+int connectTo(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0) {
+        ::perror("connect");
+        ::exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    // 测试结束时服务器停止读取，阻塞的send超时返回
+    struct timeval timeout = {0, 100 * 1000};
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    return fd;
+}
+
+// 持续上传：第一个字节'U'表明连接类型，之后不停地发送数据
+void uploadClient(uint16_t port, const std::atomic<bool>* stop) {
+    int fd = connectTo(port);
+    std::string block(kUploadBlock, 'x');
+    block[0] = 'U';
+    while (!stop->load()) {
+        if (::send(fd, block.data(), block.size(), MSG_NOSIGNAL) < 0 && errno != EAGAIN) {
+            break;
+        }
+        block[0] = 'x';
+    }
+    ::close(fd);
+}
+
+// 一问一答：发送以'\n'结尾的短消息，等服务器原样返回，记录往返时间（微秒）
+void pingClient(uint16_t port, const std::atomic<bool>* stop, const std::atomic<bool>* measuring,
+                std::vector<double>* latencies) {
+    int fd = connectTo(port);
+    char message[kPingSize];
+    std::fill(message, message + kPingSize - 1, 'p');
+    message[0] = 'P';
+    message[kPingSize - 1] = '\n';
+    char reply[kPingSize];
+    while (!stop->load()) {
+        auto start = std::chrono::steady_clock::now();
+        if (::send(fd, message, kPingSize, MSG_NOSIGNAL) != kPingSize) {
+            break;
+        }
+        ssize_t received = 0;
+        while (received < kPingSize) {
+            ssize_t n = ::recv(fd, reply + received, static_cast<size_t>(kPingSize - received), 0);
+            if (n < 0 && errno == EAGAIN && !stop->load()) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            received += n;
+        }
+        if (received < kPingSize) {
+            break;
+        }
+        if (measuring->load()) {
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            latencies->push_back(elapsed.count());
+        }
+    }
+    ::close(fd);
+}
+
+// 空闲的keep-alive连接：只占用poller中的位置
+void idleClients(uint16_t port, int count, const std::atomic<bool>* stop) {
+    std::vector<int> fds;
+    for (int i = 0; i < count; ++i) {
+        fds.push_back(connectTo(port));
+    }
+    while (!stop->load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    for (int fd : fds) {
+        ::close(fd);
+    }
+}
+
+Result runOnce(bool edgeTriggered, uint16_t port, const Options& options) {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), edgeTriggered ? "bench-et" : "bench-lt");
+    server.setEdgeTriggered(edgeTriggered);
+    server.setConnectionCallback([](const TcpConnectionPtr&) {});
+
+    long callbacks = 0;
+    size_t uploaded = 0;
+    bool counting = false;
+    server.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        if (counting) {
+            ++callbacks;
+        }
+        if (!conn->getContext()) {
+            conn->setContext(std::make_shared<char>(*buf->peek()));
+        }
+        if (*std::static_pointer_cast<char>(conn->getContext()) == 'U') {
+            if (counting) {
+                uploaded += buf->readableBytes();
+            }
+            buf->retrieveAll();
+            return;
+        }
+        while (const char* eol = buf->findEOL()) {
+            conn->send(buf->peek(), static_cast<int>(eol + 1 - buf->peek()));
+            buf->retrieveUntil(eol + 1);
+        }
+    });
+    server.start();
+
+    std::atomic<bool> stop(false);
+    std::atomic<bool> measuring(false);
+    std::vector<std::vector<double>> latencies(static_cast<size_t>(options.light));
+    std::vector<std::thread> clients;
+    clients.emplace_back(idleClients, port, options.idle, &stop);
+    for (int i = 0; i < options.heavy; ++i) {
+        clients.emplace_back(uploadClient, port, &stop);
+    }
+    for (int i = 0; i < options.light; ++i) {
+        clients.emplace_back(pingClient, port, &stop, &measuring, &latencies[static_cast<size_t>(i)]);
+    }
+
+    // 先预热一秒，再统计options.seconds秒
+    auto begin = std::chrono::steady_clock::now();
+    loop.runAfter(1.0, [&]() {
+        counting = true;
+        measuring = true;
+        begin = std::chrono::steady_clock::now();
+    });
+    double elapsed = 0;
+    loop.runAfter(1.0 + options.seconds, [&]() {
+        counting = false;
+        measuring = false;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        stop = true;
+    });
+    // 客户端退出期间继续处理事件，不让阻塞的send卡住
+    loop.runAfter(1.5 + options.seconds, [&]() { loop.quit(); });
+    loop.loop();
+    for (std::thread& client : clients) {
+        client.join();
+    }
+
+    Result result;
+    result.uploadMBps = static_cast<double>(uploaded) / (1024 * 1024) / elapsed;
+    result.callbacks = callbacks;
+    std::vector<double> all;
+    for (const std::vector<double>& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+    result.pings = all.size();
+    if (!all.empty()) {
+        result.p50Us = all[all.size() / 2];
+        result.p99Us = all[all.size() * 99 / 100];
+    }
+    return result;
+}
+
+void printResult(const char* mode, const Result& result) {
+    std::printf("%-4s %12.1f %12ld %10zu %12.1f %12.1f\n", mode, result.uploadMBps, result.callbacks,
+                result.pings, result.p50Us, result.p99Us);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Logger::setLogLevel(Logger::WARN);
+    Options options;
+    if (argc > 1) {
+        options.seconds = std::atoi(argv[1]);
+    }
+    if (argc > 2) {
+        options.heavy = std::atoi(argv[2]);
+    }
+    if (argc > 3) {
+        options.light = std::atoi(argv[3]);
+    }
+    if (argc > 4) {
+        options.idle = std::atoi(argv[4]);
+    }
+
+    std::printf("%d s, %d upload, %d ping-pong, %d idle connections on one IO thread\n",
+                options.seconds, options.heavy, options.light, options.idle);
+    std::printf("%-4s %12s %12s %10s %12s %12s\n", "mode", "upload MB/s", "read calls", "pings",
+                "p50 (us)", "p99 (us)");
+    // 每种模式在自己的线程中运行一个EventLoop
+    Result lt, et;
+    std::thread([&]() { lt = runOnce(false, 19190, options); }).join();
+    printResult("LT", lt);
+    std::thread([&]() { et = runOnce(true, 19191, options); }).join();
+    printResult("ET", et);
+    return 0;
+}
@@ -3,6 +3,20 @@
 #include "net/HttpResponse.h"
 #include "net/EventLoop.h"
 #include "net/HttpContext.h"
+#include "net/TimerId.h"
+#include "net/MultipartParser.h"
+#include "net/ContentEncoding.h"
+#include "DbPool.h"
+#include "SessionCache.h"
+#include "FileListCache.h"
+#include "SearchIndex.h"
+#include "ShareCache.h"
+#include "UploadSession.h"
+#include "BlobStore.h"
+#include "BodyWriteQueue.h"
+#include "Sha256.h"
+#include "StaticAssetCache.h"
+#include "SeekableGzip.h"
 #include "base/ThreadPool.h"
 #include "base/Logging.h"
 #include <nlohmann/json.hpp>
@@ -21,7 +35,10 @@
 #include <atomic>
 #include <vector>
 #include <cstdio>
+#include <cerrno>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <mysql/mysql.h>
 #include <sstream>
 
@@ -31,249 +48,479 @@ using json = nlohmann::json;
 namespace fs = std::experimental::filesystem;
 
 // 文件上传上下文
+// 请求头到达时创建，请求体经过BodyWriteQueue在工作线程中由MultipartParser增量解析，
+// 文件part的数据写入临时文件，不在内存中累积，同时计算内容哈希；
+// 使用分块存储时不写临时文件，数据边接收边切分成分块保存到chunkStore中；
+// 开启压缩时临时文件由SeekableGzipWriter写入，第一帧压缩效果差时按原样保存
 class FileUploadContext {
 public:
-    enum class State {
-        kExpectHeaders,    // 等待头部
-        kExpectContent,    // 等待文件内容
-        kExpectBoundary,   // 等待边界
-        kComplete         // 上传完成
-    };
-
-    FileUploadContext(const std::string& filename, const std::string& originalFilename)
+    FileUploadContext(const std::string& filename, const std::string& originalFilename,
+                      const std::string& boundary, int userId, ChunkStore* chunkStore = nullptr,
+                      bool compress = false)
         : filename_(filename)
         , originalFilename_(originalFilename)
+        , userId_(userId)
+        , fd_(-1)
         , totalBytes_(0)
-        , state_(State::kExpectHeaders)
-        , boundary_("")
+        , parser_(boundary)
+        , inFilePart_(false)
+        , gotFilePart_(false)
+        , writeError_(false)
+        , committed_(false)
     {
-        // 确保目录存在
-        fs::path filePath(filename_);
-        fs::path dir = filePath.parent_path();
-        if (!dir.empty() && !fs::exists(dir)) {
-            fs::create_directories(dir);
-        }
+        if (chunkStore) {
+            chunkList_.reset(new ChunkList(chunkStore));
+            chunker_.reset(new CdcChunker([this](const char* data, size_t len) {
+                return chunkList_->add(data, len);
+            }));
+            LOG_INFO << "Receiving " << originalFilename << " into the chunk store";
+        } else {
+            // 确保目录存在
+            fs::path filePath(filename_);
+            fs::path dir = filePath.parent_path();
+            if (!dir.empty() && !fs::exists(dir)) {
+                fs::create_directories(dir);
+            }
 
-        // 打开文件
-        file_.open(filename_, std::ios::binary | std::ios::out);
-        if (!file_.is_open()) {
-            LOG_ERROR << "Failed to open file: " << filename;
-            throw std::runtime_error("Failed to open file: " + filename);
+            // 打开文件
+            fd_ = ::open(filename_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd_ < 0) {
+                LOG_ERROR << "Failed to open file: " << filename;
+                throw std::runtime_error("Failed to open file: " + filename);
+            }
+            if (compress) {
+                gzipWriter_.reset(new SeekableGzipWriter(fd_, true));
+            }
+            LOG_INFO << "Creating file: " << filename << ", original name: " << originalFilename;
         }
-        LOG_INFO << "Creating file: " << filename << ", original name: " << originalFilename;
+
+        parser_.setPartBeginCallback([this](const MultipartParser::Part& part) {
+            // 只保存第一个文件part，其余表单字段忽略
+            inFilePart_ = !part.filename.empty() && !gotFilePart_;
+            if (inFilePart_) {
+                gotFilePart_ = true;
+                if (originalFilename_.empty()) {
+                    originalFilename_ = part.filename;
+                }
+            }
+        });
+        parser_.setPartDataCallback([this](const char* data, size_t len) {
+            if (inFilePart_) {
+                writeData(data, len);
+            }
+        });
+        parser_.setPartEndCallback([this]() { inFilePart_ = false; });
     }
 
     ~FileUploadContext() {
-        if (file_.is_open()) {
-            file_.close();
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        // 上传没有完成（连接中断或出错），删除写了一半的文件
+        if (!committed_) {
+            ::unlink(filename_.c_str());
+            ::unlink(indexFilename().c_str());
         }
     }
 
-    void writeData(const char* data, size_t len) {
-        if (!file_.is_open()) {
-            throw std::runtime_error("File is not open: " + filename_);
+    FileUploadContext(const FileUploadContext&) = delete;
+    FileUploadContext& operator=(const FileUploadContext&) = delete;
+
+    // 喂入一段请求体，返回false表示格式错误或写盘失败。由writeQueue()在工作线程中调用
+    bool feed(const char* data, size_t len) {
+        return parser_.feed(data, len) && !writeError_;
+    }
+
+    void setWriteQueue(const std::shared_ptr<BodyWriteQueue>& writeQueue) { writeQueue_ = writeQueue; }
+    const std::shared_ptr<BodyWriteQueue>& writeQueue() const { return writeQueue_; }
+    bool writeFailed() const { return writeError_; }
+
+    // 是否收到了结束边界
+    bool finished() const { return parser_.finished(); }
+    bool gotFilePart() const { return gotFilePart_; }
+
+    // 上传成功，保留文件
+    void commit() { committed_ = true; }
+
+    // 分块存储：请求体结束后切出最后的分块，之后chunkList()中是完整的文件
+    bool finishChunks() { return chunker_->finish(); }
+    ChunkList* chunkList() const { return chunkList_.get(); }
+
+    // 请求体结束后写完压缩数据的尾部和帧索引
+    bool finishFile() {
+        if (!gzipWriter_) {
+            return true;
         }
-        
-        if (!file_.write(data, len)) {
-            throw std::runtime_error("Failed to write to file: " + filename_);
+        if (!gzipWriter_->finish()) {
+            return false;
         }
-        
-        file_.flush();  // 确保数据写入磁盘
-        totalBytes_ += len;
-        // LOG_INFO << "Wrote " << len << " bytes, total: " << totalBytes_;
+        return !gzipWriter_->compressed() || gzipWriter_->writeIndex(indexFilename());
+    }
+    // 临时文件是压缩数据时返回它的帧索引文件名，否则返回空串
+    std::string storedIndexFile() const {
+        return gzipWriter_ && gzipWriter_->compressed() ? indexFilename() : std::string();
     }
 
     uintmax_t getTotalBytes() const { return totalBytes_; }
+    // 文件内容的SHA-256，在请求体全部写入之后调用
+    const std::string& contentHash() {
+        if (contentHash_.empty()) {
+            contentHash_ = sha256_.hexDigest();
+        }
+        return contentHash_;
+    }
     const std::string& getFilename() const { return filename_; }
     const std::string& getOriginalFilename() const { return originalFilename_; }
-
-    void setBoundary(const std::string& boundary) { boundary_ = boundary; }
-    State getState() const { return state_; }
-    void setState(State state) { state_ = state; }
-    const std::string& getBoundary() const { return boundary_; }
+    int getUserId() const { return userId_; }
 
 private:
+    void writeData(const char* data, size_t len) {
+        sha256_.update(data, len);
+        if (chunker_) {
+            if (!writeError_ && !chunker_->update(data, len)) {
+                LOG_ERROR << "Failed to store chunks of " << originalFilename_;
+                writeError_ = true;
+            }
+            totalBytes_ += len;
+            return;
+        }
+        if (gzipWriter_) {
+            if (!writeError_ && !gzipWriter_->write(data, len)) {
+                LOG_ERROR << "Failed to write compressed file: " << filename_;
+                writeError_ = true;
+            }
+            totalBytes_ += len;
+            return;
+        }
+        while (len > 0 && !writeError_) {
+            ssize_t n = ::write(fd_, data, len);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOG_ERROR << "Failed to write to file: " << filename_ << ", errno: " << errno;
+                writeError_ = true;
+                return;
+            }
+            data += n;
+            len -= static_cast<size_t>(n);
+            totalBytes_ += static_cast<uintmax_t>(n);
+        }
+    }
+
+    std::string indexFilename() const { return filename_ + ".idx"; }
+
     std::string filename_;        // 保存在服务器上的文件名
     std::string originalFilename_; // 原始文件名
-    std::ofstream file_;
+    int userId_;                  // 上传者
+    int fd_;
     uintmax_t totalBytes_;
-    State state_;                 // 当前状态
-    std::string boundary_;        // multipart边界
+    Sha256 sha256_;               // 边写边计算的内容哈希
+    std::string contentHash_;
+    std::unique_ptr<ChunkList> chunkList_;  // 分块存储时已经保存的分块
+    std::unique_ptr<CdcChunker> chunker_;
+    std::unique_ptr<SeekableGzipWriter> gzipWriter_;  // 压缩保存时写入fd_
+    MultipartParser parser_;      // multipart请求体解析器
+    std::shared_ptr<BodyWriteQueue> writeQueue_;  // 请求体的写入队列
+    bool inFilePart_;             // 当前是否处于文件part中
+    bool gotFilePart_;            // 是否已经遇到文件part
+    bool writeError_;             // 写盘是否失败
+    bool committed_;              // 上传是否已完成并入库
 };
 
 // 文件下载上下文
+// 只负责打开文件和计算发送区间，文件内容由TcpConnection::sendFile直接从页缓存发送
+// 分块存储的文件按清单顺序拼接各个分块，每个分块在发送到它时才打开
 class FileDownContext {
 public:
+    struct Segment {
+        std::string path;
+        uintmax_t size;
+    };
+
     FileDownContext(const std::string& filepath, const std::string& originalFilename)
         : filepath_(filepath)
         , originalFilename_(originalFilename)
+        , fd_(-1)
         , fileSize_(0)
         , currentPosition_(0)
-        , isComplete_(false)
     {
-        // 获取文件大小
-        fileSize_ = fs::file_size(filepath_);
-        
         // 打开文件
-        file_.open(filepath_, std::ios::binary | std::ios::in);
-        if (!file_.is_open()) {
+        fd_ = ::open(filepath_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
             LOG_ERROR << "Failed to open file: " << filepath_;
             throw std::runtime_error("Failed to open file: " + filepath_);
         }
+
+        // 获取文件大小
+        struct stat st;
+        if (::fstat(fd_, &st) < 0) {
+            ::close(fd_);
+            throw std::runtime_error("Failed to stat file: " + filepath_);
+        }
+        fileSize_ = static_cast<uintmax_t>(st.st_size);
         LOG_INFO << "Opening file for download: " << filepath_ << ", size: " << fileSize_;
     }
 
-    ~FileDownContext() {
-        if (file_.is_open()) {
-            file_.close();
+    FileDownContext(std::vector<Segment> segments, const std::string& originalFilename)
+        : originalFilename_(originalFilename)
+        , fd_(-1)
+        , fileSize_(0)
+        , currentPosition_(0)
+        , segments_(std::move(segments))
+    {
+        for (const Segment& segment : segments_) {
+            fileSize_ += segment.size;
         }
+        LOG_INFO << "Opening chunked file for download: " << originalFilename_
+                 << ", chunks: " << segments_.size() << ", size: " << fileSize_;
     }
 
-    void seekTo(uintmax_t position) {
-        if (!file_.is_open()) {
-            throw std::runtime_error("File is not open: " + filepath_);
-        }
-        file_.seekg(position);
-        currentPosition_ = position;
-        isComplete_ = false;
+    // 压缩保存的文件，发送时从区间所在的帧开始解压
+    FileDownContext(std::shared_ptr<SeekableGzipReader> reader, const std::string& originalFilename)
+        : originalFilename_(originalFilename)
+        , fd_(-1)
+        , fileSize_(reader->rawSize())
+        , currentPosition_(0)
+        , gzipReader_(std::move(reader))
+    {
+        LOG_INFO << "Opening compressed file for download: " << originalFilename_
+                 << ", size: " << fileSize_ << ", stored: " << gzipReader_->compressedSize();
     }
 
-    bool readNextChunk(std::string& chunk) {
-        if (!file_.is_open() || isComplete_) {
-            return false;
+    ~FileDownContext() {
+        if (fd_ >= 0) {
+            ::close(fd_);
         }
+    }
 
-        const uintmax_t chunkSize = 1024 * 1024; // 1MB
-        uintmax_t remainingBytes = fileSize_ - currentPosition_;
-        uintmax_t bytesToRead = std::min(chunkSize, remainingBytes);
+    FileDownContext(const FileDownContext&) = delete;
+    FileDownContext& operator=(const FileDownContext&) = delete;
 
-        if (bytesToRead == 0) {
-            isComplete_ = true;
-            return false;
-        }
+    void seekTo(uintmax_t position) {
+        currentPosition_ = position;
+    }
 
-        std::vector<char> buffer(bytesToRead);
-        file_.read(buffer.data(), bytesToRead);
-        chunk.assign(buffer.data(), bytesToRead);
-        currentPosition_ += bytesToRead;
+    // 把从当前位置开始的len个字节设为resp的文件响应体
+    void attachBody(HttpResponse* resp, uintmax_t len) {
+        if (gzipReader_) {
+            if (len == 0) {
+                return;
+            }
+            if (!gzipReader_->seek(currentPosition_, len)) {
+                throw std::runtime_error("Failed to seek compressed file");
+            }
+            // 输出缓冲区发空时才解压下一段，内存占用与文件大小无关
+            std::shared_ptr<SeekableGzipReader> reader = std::move(gzipReader_);
+            resp->setBodyStream([reader](Buffer* out) {
+                while (out->readableBytes() < kStreamPiece && reader->remaining() > 0) {
+                    out->ensureWritableBytes(kStreamPiece - out->readableBytes());
+                    ssize_t n = reader->read(out->beginWrite(), out->writableBytes());
+                    if (n < 0) {
+                        out->retrieveAll();
+                        return false;
+                    }
+                    out->hasWritten(static_cast<size_t>(n));
+                }
+                return reader->remaining() > 0;
+            });
+            return;
+        }
+        if (segments_.empty()) {
+            // 文件描述符交给HttpResponse/TcpConnection负责关闭
+            resp->setFileBody(fd_, static_cast<off_t>(currentPosition_), static_cast<size_t>(len));
+            fd_ = -1;
+            return;
+        }
+        uintmax_t segmentStart = 0;
+        for (const Segment& segment : segments_) {
+            uintmax_t segmentEnd = segmentStart + segment.size;
+            if (len > 0 && currentPosition_ < segmentEnd) {
+                uintmax_t offset = currentPosition_ > segmentStart ? currentPosition_ - segmentStart : 0;
+                uintmax_t n = std::min(segment.size - offset, len);
+                resp->addFileSegment(segment.path, static_cast<off_t>(offset), static_cast<size_t>(n));
+                len -= n;
+            }
+            segmentStart = segmentEnd;
+        }
+    }
 
-        LOG_INFO << "Read chunk of " << bytesToRead << " bytes, current position: " 
-                 << currentPosition_ << "/" << fileSize_;
-        return true;
+    // 把保存的gzip数据原样设为resp的文件响应体，用于 Content-Encoding: gzip
+    void attachCompressedBody(HttpResponse* resp) {
+        size_t size = static_cast<size_t>(gzipReader_->compressedSize());
+        resp->setFileBody(gzipReader_->releaseFd(), 0, size);
+        gzipReader_.reset();
     }
 
-    bool isComplete() const { return isComplete_; }
+    bool compressed() const { return static_cast<bool>(gzipReader_); }
+    uintmax_t getCompressedSize() const { return gzipReader_ ? gzipReader_->compressedSize() : 0; }
     uintmax_t getCurrentPosition() const { return currentPosition_; }
     uintmax_t getFileSize() const { return fileSize_; }
     const std::string& getOriginalFilename() const { return originalFilename_; }
 
 private:
+    static const size_t kStreamPiece = 256 * 1024;  // 边解压边发送时每次解压的字节数
+
     std::string filepath_;        // 文件路径
     std::string originalFilename_; // 原始文件名
-    std::ifstream file_;          // 文件流
+    int fd_;                      // 文件描述符
     uintmax_t fileSize_;          // 文件总大小，使用 uintmax_t 替代 size_t
-    uintmax_t currentPosition_;   // 当前读取位置，使用 uintmax_t 替代 size_t
-    bool isComplete_;             // 是否完成
+    uintmax_t currentPosition_;   // 发送起始位置，使用 uintmax_t 替代 size_t
+    std::vector<Segment> segments_;  // 分块存储的文件按顺序排列的分块，整文件时为空
+    std::shared_ptr<SeekableGzipReader> gzipReader_;  // 压缩保存的文件
+};
+
+// 分块上传中一个分块的写入上下文
+// 请求体经过BodyWriteQueue在工作线程中pwrite到会话文件中该分块的位置，析构时结束该分块的写入
+class ChunkWriteContext {
+public:
+    ChunkWriteContext(const std::shared_ptr<UploadSession>& session, size_t index)
+        : session_(session)
+        , index_(index)
+        , offset_(session->chunkOffset(index))
+        , length_(session->chunkLength(index))
+        , written_(0)
+        , ended_(false)
+    {
+    }
+
+    ~ChunkWriteContext() {
+        end();
+    }
+
+    ChunkWriteContext(const ChunkWriteContext&) = delete;
+    ChunkWriteContext& operator=(const ChunkWriteContext&) = delete;
+
+    // 写入一段请求体，超出分块长度或写盘失败返回false
+    bool feed(const char* data, size_t len) {
+        if (written_ + len > length_) {
+            LOG_ERROR << "Chunk " << index_ << " of upload " << session_->uploadId()
+                      << " is longer than " << length_ << " bytes";
+            return false;
+        }
+        if (!session_->writeAt(offset_ + written_, data, len)) {
+            return false;
+        }
+        written_ += len;
+        return true;
+    }
+
+    // 请求体结束后调用，结束该分块的写入，长度正确时把分块标记为已接收
+    // 连接中断时由析构函数结束写入，分块不会被标记
+    bool end() {
+        bool complete = written_ == length_;
+        if (!ended_) {
+            ended_ = true;
+            session_->endChunk(index_, complete);
+        }
+        return complete;
+    }
+
+    const std::shared_ptr<UploadSession>& session() const { return session_; }
+    size_t index() const { return index_; }
+    size_t written() const { return written_; }
+
+    void setWriteQueue(const std::shared_ptr<BodyWriteQueue>& writeQueue) { writeQueue_ = writeQueue; }
+    const std::shared_ptr<BodyWriteQueue>& writeQueue() const { return writeQueue_; }
+
+private:
+    std::shared_ptr<UploadSession> session_;
+    size_t index_;
+    uint64_t offset_;
+    size_t length_;
+    size_t written_;
+    bool ended_;
+    std::shared_ptr<BodyWriteQueue> writeQueue_;  // 请求体的写入队列
 };
 
 class HttpUploadHandler {
 private:
     ThreadPool threadPool_;              // 线程池
+    HttpServer* server_;                // 异步处理的请求通过它发送响应，由registerRoutes设置
     std::string uploadDir_;             // 上传目录
+    BlobStore blobStore_;               // 按内容哈希保存的文件，相同内容只存一份
+    bool chunkedStorage_;               // 新上传的文件按内容定义分块保存
+    bool compressedStorage_;            // 新上传的文件压缩保存（分块存储时不生效）
     std::string mappingFile_;           // 文件名映射文件
     std::atomic<int> activeRequests_;   // 活跃请求计数
     std::mutex mappingMutex_;           // 保护文件名映射的互斥锁
     std::map<std::string, std::string> filenameMapping_;  // 文件名映射 <服务器文件名, 原始文件名>
 
-    // MySQL连接
-    MYSQL* mysql;
-    std::string dbHost;
-    std::string dbUser;
-    std::string dbPassword;
-    std::string dbName;
-    unsigned int dbPort;
+    // 数据库连接池，每个线程使用自己的连接
+    DbPool dbPool_;
+
+    // 会话缓存，过期时间的刷新定期批量写回数据库
+    SessionCache sessionCache_;
+    static constexpr double kSessionTtl = 30 * 60;          // 与数据库中的30分钟一致
+    static constexpr double kSessionFlushInterval = 10.0;   // 写回间隔（秒）
+    static constexpr size_t kSessionFlushBatch = 64;        // 每条UPDATE包含的会话数
+
+    // 分块上传会话，文件在complete之前不入库
+    UploadSessionStore uploadSessions_;
+    static constexpr size_t kDefaultChunkSize = 4 * 1024 * 1024;
+    static constexpr size_t kMinChunkSize = 64 * 1024;
+    static constexpr size_t kMaxChunkSize = 64 * 1024 * 1024;
+    static constexpr double kUploadSessionIdle = 24 * 3600;  // 超过该时间没有活动的上传会话被丢弃
+    static constexpr double kUploadSweepInterval = 600.0;
+    static constexpr double kStagedChunkTtl = 3600;  // 单独上传的分块等待提交清单的时间
+    static constexpr size_t kUploadQueueBytes = 4 * 1024 * 1024;  // 每个上传请求排队等待写盘的数据上限
+
+    // 页面和图标，加载一次后从内存发送，文件修改后自动重新加载
+    std::string staticDir_;
+    StaticAssetCache staticAssets_;
+
+    // 文件列表分页
+    static constexpr int kDefaultPageSize = 100;
+    static constexpr int kMaxPageSize = 500;
+    // 每个用户的文件列表页面缓存在内存中，文件或分享变化时失效
+    FileListCache fileListCache_;
+    static constexpr size_t kDefaultFileListCacheBytes = 32 * 1024 * 1024;
+
+    // 文件名（按所有者分范围）和用户名的内存搜索索引，启动时从数据库加载，之后随增删更新
+    SearchIndex fileIndex_;
+    SearchIndex userIndex_;
+    static constexpr int kUserScope = 0;
+    static constexpr int kDefaultSearchLimit = 20;
+    static constexpr int kMaxSearchLimit = 100;
+    static constexpr int kUserSearchLimit = 10;
+
+    // 分享码 -> 分享信息，不存在的分享码也缓存一段时间
+    ShareCache shareCache_;
+    static constexpr size_t kShareCacheCapacity = 10000;
+    static constexpr double kShareCacheTtl = 300.0;
+    static constexpr double kShareNegativeTtl = 60.0;
 
     // 定义处理函数类型
     using RequestHandler = bool (HttpUploadHandler::*)(const TcpConnectionPtr&, HttpRequest&, HttpResponse*);
-    
-    // 路由模式结构
-    struct RoutePattern {
-        std::regex pattern;              // 正则表达式模式
-        std::vector<std::string> params; // 路径参数名列表
-        RequestHandler handler;          // 处理函数
-        HttpRequest::Method method;      // HTTP方法
-
-        RoutePattern(const std::string& pattern_str, 
-                    const std::vector<std::string>& param_names,
-                    RequestHandler h,
-                    HttpRequest::Method m)
-            : pattern(pattern_str)
-            , params(param_names)
-            , handler(h)
-            , method(m)
-        {}
-    };
 
-    // 路由表
-    std::vector<RoutePattern> routes_;
-
-    // 初始化数据库连接
-    bool initDatabase() {
-        mysql = mysql_init(NULL);
-        if (!mysql) {
-            LOG_ERROR << "MySQL初始化失败";
-            return false;
-        }
-
-        if (!mysql_real_connect(mysql, dbHost.c_str(), dbUser.c_str(), 
-                              dbPassword.c_str(), dbName.c_str(), dbPort, NULL, 0)) {
-            LOG_ERROR << "连接到MySQL服务器失败: " << mysql_error(mysql);
-            mysql_close(mysql);
-            mysql = NULL;
-            return false;
-        }
-
-        // 设置字符集为utf8
-        if (mysql_set_character_set(mysql, "utf8") != 0) {
-            LOG_ERROR << "设置字符集失败: " << mysql_error(mysql);
-            return false;
-        }
-
-        LOG_INFO << "数据库连接成功";
-        return true;
-    }
-
-    // 关闭数据库连接
-    void closeDatabase() {
-        if (mysql) {
-            mysql_close(mysql);
-            mysql = NULL;
-        }
-    }
+    // 当前线程的数据库连接
+    DbConnection& db() { return dbPool_.local(); }
 
     // 执行SQL查询
     bool executeQuery(const std::string& query) {
-        if (!mysql) {
-            LOG_ERROR << "数据库未连接";
-            return false;
-        }
-
-        if (mysql_query(mysql, query.c_str()) != 0) {
-            LOG_ERROR << "执行查询失败: " << mysql_error(mysql);
-            return false;
-        }
-        return true;
+        return db().query(query);
     }
 
     // 执行SQL查询并获取结果
     MYSQL_RES* executeQueryWithResult(const std::string& query) {
-        if (!executeQuery(query)) {
-            return NULL;
-        }
-        return mysql_store_result(mysql);
+        return db().queryWithResult(query);
+    }
+
+    static DbConfig makeDbConfig(const std::string& host, const std::string& user,
+                                 const std::string& password, const std::string& database,
+                                 unsigned int port) {
+        DbConfig config;
+        config.host = host;
+        config.user = user;
+        config.password = password;
+        config.database = database;
+        config.port = port;
+        return config;
     }
 
 public:
+    static constexpr size_t kCompressionMinSize = 1024;  // 不小于该大小的JSON、HTML等响应体被压缩
+
     HttpUploadHandler(int numThreads, 
                      const std::string& dbHost = "localhost",
                      const std::string& dbUser = "root",
@@ -281,15 +528,18 @@ public:
                      const std::string& dbName = "file_manager",
                      unsigned int dbPort = 3306)
         : threadPool_("UploadHandler")
+        , server_(nullptr)
         , uploadDir_("uploads")
+        , blobStore_(uploadDir_)
+        , chunkedStorage_(false)
+        , compressedStorage_(false)
         , mappingFile_("uploads/filename_mapping.json")
         , activeRequests_(0)
-        , dbHost(dbHost)
-        , dbUser(dbUser)
-        , dbPassword(dbPassword)
-        , dbName(dbName)
-        , dbPort(dbPort)
-        , mysql(NULL)
+        , dbPool_(makeDbConfig(dbHost, dbUser, dbPassword, dbName, dbPort))
+        , sessionCache_(kSessionTtl)
+        , staticDir_(fs::path(__FILE__).parent_path().string())  // 页面与源文件在同一目录
+        , fileListCache_(kDefaultFileListCacheBytes)
+        , shareCache_(kShareCacheCapacity, kShareCacheTtl, kShareNegativeTtl)
     {
         threadPool_.start(numThreads);
         
@@ -298,30 +548,28 @@ public:
             fs::create_directory(uploadDir_);
         }
 
-        // 初始化数据库连接
-        if (!initDatabase()) {
+        // 检查数据库连接
+        if (!db().connected()) {
             LOG_ERROR << "数据库初始化失败，系统可能无法正常工作";
         }
 
         // 加载文件名映射
         loadFilenameMapping();
+
+        loadSearchIndex();
         
-        // 初始化路由表
-        initRoutes();
     }
 
     ~HttpUploadHandler() {
         threadPool_.stop();
         // 保存文件名映射
         saveFilenameMapping();
-        closeDatabase();
     }
 
     void onConnection(const TcpConnectionPtr& conn) {
         if (conn->connected()) {
+            // HttpContext由HttpServer在调用本回调之前创建
             LOG_INFO << "New connection from " << conn->peerAddress().toIpPort();
-            // 为每个新连接创建一个 HttpContext
-            conn->setContext(std::make_shared<HttpContext>());
         } else {
             LOG_INFO << "Connection closed from " << conn->peerAddress().toIpPort();
             // 清理上下文
@@ -334,346 +582,950 @@ public:
         }
     }
 
+    // 新上传的文件按内容定义分块保存，修改过的大文件可以只重传变化的分块
+    // 已经保存的文件不受影响，两种方式保存的文件可以共存
+    void setChunkedStorage(bool on) { chunkedStorage_ = on; }
+
+    // 新上传的文件以可随机读取的gzip格式保存，压缩效果差的文件仍按原样保存
+    void setCompressedStorage(bool on) { compressedStorage_ = on; }
+
+    // 文件列表缓存的内存上限，0表示不缓存
+    void setFileListCacheBytes(size_t bytes) { fileListCache_.setMaxBytes(bytes); }
+
+    // 在loop上监视静态页面所在的目录，文件修改后重新加载
+    void startStaticWatch(EventLoop* loop) {
+        staticAssets_.watch(loop, staticDir_);
+    }
+
+    // 由loop上的定时器定期把会话过期时间批量写回数据库，写回在threadPool_中执行，不阻塞loop
+    void startSessionFlush(EventLoop* loop) {
+        loop->runEvery(kSessionFlushInterval, [this]() {
+            threadPool_.run([this]() { flushSessions(); });
+        });
+    }
+
+    // 由loop上的定时器定期清理长时间没有活动的分块上传会话和过期的暂存分块，
+    // 删除文件在threadPool_中执行，不阻塞loop
+    void startUploadSweep(EventLoop* loop) {
+        loop->runEvery(kUploadSweepInterval, [this]() {
+            threadPool_.run([this]() { sweepUploads(); });
+        });
+    }
+
+    // 请求头解析完成、请求体尚未读取时调用，上传请求的请求体交给写入队列，在threadPool_中写盘
+    // 会话不在缓存中时到threadPool_中查询数据库，查完再由resumeHeaders回到IO线程继续
+    HttpServer::HeadersResult onHeaders(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        std::string uploadId;
+        size_t index;
+        bool upload = (req.method() == HttpRequest::kPost && req.path() == "/upload") ||
+                      (req.method() == HttpRequest::kPut && parseChunkPath(req.path(), &uploadId, &index));
+        if (!upload) {
+            return HttpServer::kHeadersAccept;
+        }
+        std::string sessionId = req.getHeader("X-Session-ID");
+        int userId;
+        std::string username;
+        if (sessionId.empty() || sessionCache_.touch(sessionId, &userId, &username)) {
+            return beginUpload(conn, req, resp);
+        }
+        threadPool_.run([this, conn, sessionId]() {
+            int loadedUserId;
+            std::string loadedUsername;
+            // 有效的会话被加载到缓存中，beginUpload只查缓存
+            validateSession(sessionId, loadedUserId, loadedUsername);
+            server_->resumeHeaders(conn,
+                [this](const TcpConnectionPtr& c, HttpRequest& r, HttpResponse* rp) {
+                    return beginUpload(c, r, rp);
+                });
+        });
+        return HttpServer::kHeadersPending;
+    }
+
+    // 注册路由，路径参数用":name"表示
+    // 需要查询数据库的路由用addAsyncRoute注册，在threadPool_中执行
+    void registerRoutes(HttpServer& server) {
+        server_ = &server;
+        // 不需要会话验证的路由
+        addRoute(server, HttpRequest::kGet, "/favicon.ico", &HttpUploadHandler::handleFavicon);
+        addAsyncRoute(server, HttpRequest::kPost, "/register", &HttpUploadHandler::handleRegister);
+        addAsyncRoute(server, HttpRequest::kPost, "/login", &HttpUploadHandler::handleLogin);
+        addRoute(server, HttpRequest::kGet, "/", &HttpUploadHandler::handleIndex);
+        addRoute(server, HttpRequest::kGet, "/index.html", &HttpUploadHandler::handleIndex);
+        addRoute(server, HttpRequest::kGet, "/register.html", &HttpUploadHandler::handleIndex);
+        addAsyncRoute(server, HttpRequest::kGet, "/share/:code", &HttpUploadHandler::handleShareAccess);
+        addAsyncRoute(server, HttpRequest::kGet, "/share/download/:filename", &HttpUploadHandler::handleShareDownload);
+        addAsyncRoute(server, HttpRequest::kGet, "/share/info/:code", &HttpUploadHandler::handleShareInfo);
+
+        // 需要会话验证的路由
+        // 上传的请求体经写入队列在threadPool_中写盘，上传上下文挂在连接上；写完后同样在threadPool_中入库
+        addRoute(server, HttpRequest::kPost, "/upload", &HttpUploadHandler::handleFileUpload);
+        // 秒传：服务器已有相同内容时直接入库，不需要上传请求体
+        addAsyncRoute(server, HttpRequest::kPost, "/upload/instant", &HttpUploadHandler::handleInstantUpload);
+        // 增量上传：客户端按同样的参数做内容定义分块，只上传服务器没有的分块，再提交分块清单
+        addAsyncRoute(server, HttpRequest::kPost, "/upload/chunks/missing", &HttpUploadHandler::handleMissingChunks);
+        addAsyncRoute(server, HttpRequest::kPut, "/upload/chunks/:hash", &HttpUploadHandler::handleStageChunk);
+        addAsyncRoute(server, HttpRequest::kPost, "/upload/chunks/commit", &HttpUploadHandler::handleCommitChunks);
+        // 分块上传：init创建会话，PUT上传分块（可并行、可重传），GET查询缺失的分块，complete入库
+        addAsyncRoute(server, HttpRequest::kPost, "/upload/init", &HttpUploadHandler::handleUploadInit);
+        addAsyncRoute(server, HttpRequest::kGet, "/upload/:uploadId", &HttpUploadHandler::handleUploadStatus);
+        addRoute(server, HttpRequest::kPut, "/upload/:uploadId/chunks/:index", &HttpUploadHandler::handleChunkUpload);
+        addAsyncRoute(server, HttpRequest::kPost, "/upload/:uploadId/complete", &HttpUploadHandler::handleUploadComplete);
+        addAsyncRoute(server, HttpRequest::kGet, "/files", &HttpUploadHandler::handleListFiles);
+        addAsyncRoute(server, HttpRequest::kGet, "/files/search", &HttpUploadHandler::handleSearchFiles);
+        addAsyncRoute(server, HttpRequest::kHead, "/download/:filename", &HttpUploadHandler::handleDownload);
+        addAsyncRoute(server, HttpRequest::kGet, "/download/:filename", &HttpUploadHandler::handleDownload);
+        addAsyncRoute(server, HttpRequest::kDelete, "/delete/:filename", &HttpUploadHandler::handleDelete);
+        addAsyncRoute(server, HttpRequest::kPost, "/share", &HttpUploadHandler::handleShareFile);
+        addAsyncRoute(server, HttpRequest::kGet, "/users/search", &HttpUploadHandler::handleSearchUsers);
+        addAsyncRoute(server, HttpRequest::kPost, "/logout", &HttpUploadHandler::handleLogout);
+    }
+
+    // 没有匹配的路由时调用
     // 返回 true 表示同步处理完成，false 表示异步处理
     bool onRequest(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        LOG_WARN << "No matching route found for " << req.methodString() << " " << req.path();
+        return handleNotFound(conn, resp);
+    }
+
+private:
+    bool handleIndex(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        // 根据请求路径选择不同的HTML文件
         std::string path = req.path();
-        LOG_INFO << "Headers " << req.methodString() << " " << path;
-        LOG_INFO << "Content-Type: " << req.getHeader("Content-Type");
-        LOG_INFO << "Body size: " << req.body().size();
+        std::string filename;
+        if (path == "/register.html") {
+            filename = "register.html";
+        } else if (path == "/share.html" || path.find("/share/") == 0) {
+            filename = "share.html";
+        } else {
+            filename = "index.html";
+        }
+
+        // 页面每次都向服务器确认是否有更新，没有变化时只需要一个304响应
+        std::string filePath = staticDir_ + "/" + filename;
+        auto asset = staticAssets_.get(filePath, "text/html; charset=utf-8", "no-cache");
+        if (!asset) {
+            LOG_ERROR << "Failed to open " << filePath;
+            sendError(resp, "Failed to open " + filePath, HttpResponse::k500InternalServerError);
+            return true;
+        }
+        StaticAssetCache::serve(asset, req, resp);
+        return true;
+    }
+
+    // 在IO线程中开始接收上传的请求体，会话只从缓存中验证
+    HttpServer::HeadersResult beginUpload(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        if (req.method() == HttpRequest::kPost && req.path() == "/upload") {
+            return beginFileUpload(conn, req, resp);
+        }
+        std::string uploadId;
+        size_t index;
+        if (req.method() == HttpRequest::kPut && parseChunkPath(req.path(), &uploadId, &index)) {
+            return beginChunkUpload(conn, req, resp, uploadId, index);
+        }
+        return HttpServer::kHeadersAccept;
+    }
+
+    // 上传请求的请求头到达时调用：校验会话、创建上传上下文并接管请求体
+    HttpServer::HeadersResult beginFileUpload(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        // 验证会话
+        std::string sessionId = req.getHeader("X-Session-ID");
+        int userId;
+        std::string usernameFromSession;
+
+        if (!validateSession(sessionId, userId, usernameFromSession, true)) {
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
+            return HttpServer::kHeadersReject;
+        }
+
+        // 获取 HttpContext
+        auto httpContext = std::static_pointer_cast<HttpContext>(conn->getContext());
+        if (!httpContext) {
+            LOG_ERROR << "HttpContext is null";
+            sendError(resp, "Internal Server Error", HttpResponse::k500InternalServerError);
+            return HttpServer::kHeadersReject;
+        }
+
+        // 解析 multipart/form-data 边界
+        std::string contentType = req.getHeader("Content-Type");
+        if (contentType.empty()) {
+            sendError(resp, "Content-Type header is missing", HttpResponse::k400BadRequest);
+            return HttpServer::kHeadersReject;
+        }
+        std::string boundary = MultipartParser::boundaryFromContentType(contentType);
+        if (boundary.empty()) {
+            sendError(resp, "Invalid Content-Type", HttpResponse::k400BadRequest);
+            return HttpServer::kHeadersReject;
+        }
+        LOG_INFO << "Boundary: " << boundary;
 
+        // 优先从X-File-Name头部获取文件名，没有则使用文件part的Content-Disposition
+        std::string originalFilename;
+        std::string headerFilename = req.getHeader("X-File-Name");
+        if (!headerFilename.empty()) {
+            originalFilename = urlDecode(headerFilename);
+            LOG_INFO << "Got filename from X-File-Name header: " << originalFilename;
+        }
+
+        std::shared_ptr<FileUploadContext> uploadContext;
         try {
-            // 查找匹配的路由
-            for (const auto& route : routes_) {
-                if (route.method != req.method()) {
-                    LOG_INFO << "Method mismatch: expected " << route.method << ", got " << req.method();
-                    continue;
+            // 生成服务器端文件名
+            std::string filename = generateUniqueFilename("upload");
+            std::string filepath = blobStore_.tempPath(filename);
+            uploadContext = std::make_shared<FileUploadContext>(
+                filepath, originalFilename, boundary, userId,
+                chunkedStorage_ ? &blobStore_.chunks() : nullptr,
+                compressedStorage_);
+            LOG_INFO << "Created upload context for file: " << filepath;
+        } catch (const std::exception& e) {
+            LOG_ERROR << "Failed to create upload context: " << e.what();
+            sendError(resp, "Failed to create file", HttpResponse::k500InternalServerError);
+            return HttpServer::kHeadersReject;
+        }
+
+        httpContext->setContext(uploadContext);
+        // 队列只持有上传上下文的弱引用，连接断开后剩下的数据直接丢弃
+        std::weak_ptr<FileUploadContext> weakUpload(uploadContext);
+        uploadContext->setWriteQueue(startBodyQueue(conn, httpContext.get(),
+            [weakUpload](const char* data, size_t len) {
+                std::shared_ptr<FileUploadContext> upload = weakUpload.lock();
+                return upload && upload->feed(data, len);
+            }));
+        return HttpServer::kHeadersAccept;
+    }
+
+    // 请求体全部到达后调用，此时部分数据可能还在写入队列中
+    bool handleFileUpload(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        auto httpContext = std::static_pointer_cast<HttpContext>(conn->getContext());
+        std::shared_ptr<FileUploadContext> uploadContext;
+        if (httpContext) {
+            uploadContext = httpContext->getContext<FileUploadContext>();
+        }
+        if (!uploadContext) {
+            LOG_ERROR << "Upload context is null";
+            sendError(resp, "Invalid upload request", HttpResponse::k400BadRequest);
+            return true;
+        }
+        // 清理上下文，之后上传上下文只由工作线程使用
+        httpContext->setContext(nullptr);
+
+        // 队列中的数据全部写完之后，在threadPool_中检查请求体、结束写入、移入blob和写数据库，不阻塞IO线程
+        uploadContext->writeQueue()->finish(asyncTask(conn, req, resp,
+            [this, uploadContext](HttpRequest&, HttpResponse* response) {
+                if (uploadContext->writeFailed()) {
+                    sendError(response, "Failed to write file", HttpResponse::k500InternalServerError);
+                    return;
                 }
+                if (!uploadContext->finished() || !uploadContext->gotFilePart()) {
+                    LOG_ERROR << "Incomplete multipart body for file: " << uploadContext->getFilename();
+                    sendError(response, "Incomplete multipart body", HttpResponse::k400BadRequest);
+                    return;
+                }
+                storeFileUpload(uploadContext, response);
+            }));
+        return false;
+    }
 
-                std::smatch matches;
-                if (std::regex_match(path, matches, route.pattern)) {
-                    LOG_INFO << "Found matching route: " << path;
-                    // 提取路径参数
-                    std::unordered_map<std::string, std::string> params;
-                    for (size_t i = 0; i < route.params.size() && i + 1 < matches.size(); ++i) {
-                        params[route.params[i]] = matches[i + 1];
-                    }
+    // 把上传完成的文件入库，在工作线程中执行
+    void storeFileUpload(const std::shared_ptr<FileUploadContext>& uploadContext, HttpResponse* resp) {
+        std::string serverFilename = fs::path(uploadContext->getFilename()).filename().string();
+        std::string originalFilename = uploadContext->getOriginalFilename();
+        if (originalFilename.empty()) {
+            originalFilename = "unknown_file";
+        }
+        uintmax_t fileSize = uploadContext->getTotalBytes();
+        int userId = uploadContext->getUserId();
+        LOG_INFO << "Upload finished: " << serverFilename << ", size: " << fileSize;
+
+        // 检测文件类型
+        std::string fileType = getFileType(originalFilename);
+
+        // 临时文件或分块存入blob（已有相同内容时直接丢弃），并保存文件信息到数据库
+        std::string contentHash = uploadContext->contentHash();
+        int fileId = 0;
+        auto addRef = [&]() {
+            return insertFileRecord(serverFilename, originalFilename, fileSize, fileType,
+                                    userId, contentHash, &fileId);
+        };
+        bool stored;
+        if (ChunkList* chunks = uploadContext->chunkList()) {
+            stored = uploadContext->finishChunks() && blobStore_.putChunks(chunks, contentHash, addRef);
+        } else {
+            stored = uploadContext->finishFile() &&
+                     blobStore_.put(uploadContext->getFilename(), contentHash, addRef,
+                                    uploadContext->storedIndexFile());
+        }
+        if (!stored) {
+            LOG_ERROR << "保存文件信息到数据库失败";
+            sendError(resp, "保存文件信息失败", HttpResponse::k500InternalServerError);
+            return;
+        }
+        uploadContext->commit();
 
-                    // 将参数存储到请求对象中
-                    req.setPathParams(params);
+        json response = {
+            {"code", 0},
+            {"message", "上传成功"},
+            {"fileId", fileId},
+            {"filename", serverFilename},
+            {"originalFilename", originalFilename},
+            {"size", fileSize}
+        };
 
-                    // 调用处理函数
-                    return (this->*route.handler)(conn, req, resp);
-                }
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("application/json");
+        resp->setBody(response.dump());
+    }
+
+    // 插入一条引用contentHash对应blob的文件记录，新记录的id存入fileId
+    // 之后的查询会覆盖lastInsertId()，调用者应使用fileId
+    bool insertFileRecord(const std::string& serverFilename, const std::string& originalFilename,
+                          uint64_t fileSize, const std::string& fileType, int userId,
+                          const std::string& contentHash, int* fileId) {
+        if (!db().execute("INSERT INTO files (filename, original_filename, file_size, file_type, "
+                          "user_id, content_hash) VALUES (?, ?, ?, ?, ?, ?)",
+                          {serverFilename, originalFilename, fileSize, fileType, userId, contentHash})) {
+            return false;
+        }
+        *fileId = static_cast<int>(db().lastInsertId());
+        fileListCache_.invalidateUser(userId);
+
+        DbResult result;
+        if (db().execute("SELECT id, user_id, filename, original_filename, file_size, file_type, created_at "
+                         "FROM files WHERE id = ?",
+                         {*fileId}, &result) &&
+            !result.empty()) {
+            indexFile(result[0]);
+        }
+        return true;
+    }
+
+    // 把文件记录加入搜索索引，row的列依次为id, user_id, filename, original_filename, file_size, file_type, created_at
+    void indexFile(const DbRow& row) {
+        json file = {
+            {"id", std::stoi(row[0])},
+            {"name", row[2]},
+            {"originalName", row[3]},
+            {"size", static_cast<uintmax_t>(std::stoull(row[4]))},
+            {"type", row[5] ? row[5] : ""},
+            {"createdAt", row[6] ? row[6] : ""},
+            {"isOwner", true}
+        };
+        fileIndex_.add(std::stoi(row[1]), std::stoi(row[0]), row[3], file.dump());
+    }
+
+    void indexUser(int id, const std::string& username, const std::string& email) {
+        json user = {
+            {"id", id},
+            {"username", username},
+            {"email", email}
+        };
+        userIndex_.add(kUserScope, id, username, user.dump());
+    }
+
+    // 从数据库加载全部文件名和用户名
+    void loadSearchIndex() {
+        DbResult files;
+        if (db().execute("SELECT id, user_id, filename, original_filename, file_size, file_type, created_at "
+                         "FROM files", {}, &files)) {
+            for (const DbRow& row : files) {
+                indexFile(row);
+            }
+        }
+        DbResult users;
+        if (db().execute("SELECT id, username, email FROM users", {}, &users)) {
+            for (const DbRow& row : users) {
+                indexUser(std::stoi(row[0]), row[1], row[2] ? row[2] : "");
+            }
+        }
+        LOG_INFO << "Search index loaded, files: " << fileIndex_.size() << ", users: " << userIndex_.size();
+    }
+
+    // 读取文件，切分成分块保存到chunks中，同时计算整个文件的哈希
+    static bool chunkFile(const std::string& path, ChunkList* chunks, std::string* contentHash) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            return false;
+        }
+        Sha256 sha;
+        CdcChunker chunker([chunks](const char* data, size_t len) {
+            return chunks->add(data, len);
+        });
+        std::vector<char> buf(1024 * 1024);
+        while (in) {
+            in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+            size_t n = static_cast<size_t>(in.gcount());
+            sha.update(buf.data(), n);
+            if (!chunker.update(buf.data(), n)) {
+                return false;
+            }
+        }
+        if (in.bad() || !chunker.finish()) {
+            return false;
+        }
+        *contentHash = sha.hexDigest();
+        return true;
+    }
+
+    // 读取文件并压缩到tempFile，同时计算整个文件的哈希
+    // 压缩后帧索引写入tempFile.idx并通过indexFile返回；压缩效果差时删除tempFile，indexFile为空
+    static bool compressFile(const std::string& path, const std::string& tempFile,
+                             std::string* contentHash, std::string* indexFile) {
+        std::ifstream in(path, std::ios::binary);
+        int fd = ::open(tempFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (!in || fd < 0) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return false;
+        }
+        Sha256 sha;
+        bool ok = true;
+        {
+            SeekableGzipWriter writer(fd, true);
+            std::vector<char> buf(1024 * 1024);
+            while (ok && in) {
+                in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+                size_t n = static_cast<size_t>(in.gcount());
+                sha.update(buf.data(), n);
+                ok = writer.write(buf.data(), n);
+            }
+            ok = ok && !in.bad() && writer.finish();
+            if (ok && writer.compressed()) {
+                *indexFile = tempFile + ".idx";
+                ok = writer.writeIndex(*indexFile);
+            }
+        }
+        ::close(fd);
+        if (!ok || indexFile->empty()) {
+            ::unlink(tempFile.c_str());
+            indexFile->clear();
+        }
+        if (!ok) {
+            return false;
+        }
+        *contentHash = sha.hexDigest();
+        return true;
+    }
+
+    // 秒传握手
+    // 请求体: {"filename": "...", "size": 字节数, "hash": "SHA-256十六进制"}
+    // 已有相同内容时创建文件记录并返回instant=true，否则返回instant=false，客户端再正常上传
+    bool handleInstantUpload(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        std::string sessionId = req.getHeader("X-Session-ID");
+        int userId;
+        std::string usernameFromSession;
+        if (!validateSession(sessionId, userId, usernameFromSession)) {
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
+            return true;
+        }
+
+        json requestData = json::parse(req.body(), nullptr, false);
+        if (requestData.is_discarded() || !requestData.contains("size") ||
+            !requestData["size"].is_number_unsigned() ||
+            !requestData.contains("hash") || !requestData["hash"].is_string()) {
+            sendError(resp, "Invalid upload request", HttpResponse::k400BadRequest);
+            return true;
+        }
+        uint64_t fileSize = requestData["size"].get<uint64_t>();
+        std::string contentHash = requestData["hash"].get<std::string>();
+        std::transform(contentHash.begin(), contentHash.end(), contentHash.begin(), ::tolower);
+        if (!BlobStore::isValidHash(contentHash)) {
+            sendError(resp, "Invalid hash", HttpResponse::k400BadRequest);
+            return true;
+        }
+        std::string originalFilename = requestData.value("filename", "");
+        if (originalFilename.empty()) {
+            originalFilename = "unknown_file";
+        }
+
+        std::string serverFilename = generateUniqueFilename("upload");
+        std::string fileType = getFileType(originalFilename);
+        int fileId = 0;
+        BlobStore::LinkResult linked = blobStore_.link(contentHash, fileSize, [&]() {
+            return insertFileRecord(serverFilename, originalFilename, fileSize, fileType,
+                                    userId, contentHash, &fileId);
+        });
+        if (linked == BlobStore::kLinkFailed) {
+            LOG_ERROR << "保存文件信息到数据库失败";
+            sendError(resp, "保存文件信息失败", HttpResponse::k500InternalServerError);
+            return true;
+        }
+
+        json response;
+        if (linked == BlobStore::kLinked) {
+            LOG_INFO << "Instant upload of " << originalFilename << " as " << serverFilename
+                     << ", hash: " << contentHash;
+            response = {
+                {"code", 0},
+                {"message", "秒传成功"},
+                {"instant", true},
+                {"fileId", fileId},
+                {"filename", serverFilename},
+                {"originalFilename", originalFilename},
+                {"size", fileSize}
+            };
+        } else {
+            response = {
+                {"code", 0},
+                {"message", "需要上传文件内容"},
+                {"instant", false}
+            };
+        }
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("application/json");
+        resp->setBody(response.dump());
+        return true;
+    }
+
+    // 查询服务器缺少哪些分块
+    // 请求体: {"chunks": ["分块SHA-256", ...]}，返回其中服务器没有保存的分块
+    bool handleMissingChunks(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        std::string sessionId = req.getHeader("X-Session-ID");
+        int userId;
+        std::string usernameFromSession;
+        if (!validateSession(sessionId, userId, usernameFromSession)) {
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
+            return true;
+        }
+
+        json requestData = json::parse(req.body(), nullptr, false);
+        if (requestData.is_discarded() || !requestData.contains("chunks") ||
+            !requestData["chunks"].is_array()) {
+            sendError(resp, "Invalid request", HttpResponse::k400BadRequest);
+            return true;
+        }
+        json missing = json::array();
+        for (const json& item : requestData["chunks"]) {
+            if (!item.is_string() || !blobStore_.chunks().hasChunk(item.get<std::string>())) {
+                missing.push_back(item);
             }
+        }
+
+        json response = {
+            {"code", 0},
+            {"message", "success"},
+            {"missing", missing}
+        };
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("application/json");
+        resp->setBody(response.dump());
+        return true;
+    }
+
+    // 上传一个分块，请求体是分块内容，校验哈希后暂存，等待提交清单
+    bool handleStageChunk(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        std::string sessionId = req.getHeader("X-Session-ID");
+        int userId;
+        std::string usernameFromSession;
+        if (!validateSession(sessionId, userId, usernameFromSession)) {
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
+            return true;
+        }
+
+        std::string hash = req.getPathParam("hash");
+        const std::string& body = req.body();
+        if (!BlobStore::isValidHash(hash) || body.empty() || body.size() > CdcChunker::kMaxSize) {
+            sendError(resp, "Invalid chunk", HttpResponse::k400BadRequest);
+            return true;
+        }
+        Sha256 sha;
+        sha.update(body.data(), body.size());
+        if (sha.hexDigest() != hash) {
+            sendError(resp, "Chunk hash mismatch", HttpResponse::k400BadRequest);
+            return true;
+        }
+        if (!blobStore_.chunks().stage(hash, body.data(), body.size(), kStagedChunkTtl)) {
+            sendError(resp, "Failed to store chunk", HttpResponse::k500InternalServerError);
+            return true;
+        }
+
+        json response = {
+            {"code", 0},
+            {"message", "success"},
+            {"hash", hash},
+            {"size", body.size()}
+        };
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("application/json");
+        resp->setBody(response.dump());
+        return true;
+    }
+
+    // 提交分块清单，由已经保存的分块组成新文件
+    // 请求体: {"filename": "...", "chunks": [{"hash": "...", "size": 字节数}, ...]}
+    // 有分块不存在时返回409和缺少的分块，客户端上传之后重新提交
+    bool handleCommitChunks(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        std::string sessionId = req.getHeader("X-Session-ID");
+        int userId;
+        std::string usernameFromSession;
+        if (!validateSession(sessionId, userId, usernameFromSession)) {
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
+            return true;
+        }
+
+        json requestData = json::parse(req.body(), nullptr, false);
+        if (requestData.is_discarded() || !requestData.contains("chunks") ||
+            !requestData["chunks"].is_array() || requestData["chunks"].empty()) {
+            sendError(resp, "Invalid request", HttpResponse::k400BadRequest);
+            return true;
+        }
+        std::string originalFilename = requestData.value("filename", "");
+        if (originalFilename.empty()) {
+            originalFilename = "unknown_file";
+        }
+
+        // 先持有所有分块的引用，之后它们不会被删除
+        ChunkList chunks(&blobStore_.chunks());
+        json missing = json::array();
+        for (const json& item : requestData["chunks"]) {
+            if (!item.is_object() || !item.contains("hash") || !item["hash"].is_string() ||
+                !item.contains("size") || !item["size"].is_number_unsigned()) {
+                sendError(resp, "Invalid chunk", HttpResponse::k400BadRequest);
+                return true;
+            }
+            std::string hash = item["hash"].get<std::string>();
+            size_t size = item["size"].get<size_t>();
+            if (!BlobStore::isValidHash(hash) || size == 0 || size > CdcChunker::kMaxSize) {
+                sendError(resp, "Invalid chunk", HttpResponse::k400BadRequest);
+                return true;
+            }
+            if (!chunks.addExisting(hash, size)) {
+                missing.push_back(hash);
+            }
+        }
+        if (!missing.empty()) {
+            json response = {
+                {"code", 409},
+                {"message", "Missing chunks"},
+                {"missing", missing}
+            };
+            resp->setStatusCode(HttpResponse::k409Conflict);
+            resp->setStatusMessage("Conflict");
+            resp->setContentType("application/json");
+            resp->setBody(response.dump());
+            return true;
+        }
+
+        // 整个文件的哈希由服务器按顺序读取分块计算，不信任客户端
+        Sha256 sha;
+        for (const ChunkStore::Chunk& chunk : chunks.chunks()) {
+            if (!sha.updateFile(blobStore_.chunks().chunkPath(chunk.hash))) {
+                sendError(resp, "Failed to read chunk", HttpResponse::k500InternalServerError);
+                return true;
+            }
+        }
+        std::string contentHash = sha.hexDigest();
+        std::string serverFilename = generateUniqueFilename("upload");
+        uint64_t fileSize = chunks.totalSize();
+        std::string fileType = getFileType(originalFilename);
+        int fileId = 0;
+        if (!blobStore_.putChunks(&chunks, contentHash, [&]() {
+                return insertFileRecord(serverFilename, originalFilename, fileSize, fileType,
+                                        userId, contentHash, &fileId);
+            })) {
+            LOG_ERROR << "保存文件信息到数据库失败";
+            sendError(resp, "保存文件信息失败", HttpResponse::k500InternalServerError);
+            return true;
+        }
+        LOG_INFO << "Committed " << chunks.chunks().size() << " chunks as " << serverFilename
+                 << ", size: " << fileSize;
+
+        json response = {
+            {"code", 0},
+            {"message", "上传成功"},
+            {"fileId", fileId},
+            {"filename", serverFilename},
+            {"originalFilename", originalFilename},
+            {"hash", contentHash},
+            {"size", fileSize}
+        };
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("application/json");
+        resp->setBody(response.dump());
+        return true;
+    }
+
+    // 创建分块上传会话
+    // 请求体: {"filename": "...", "size": 字节数, "chunkSize": 可选}
+    bool handleUploadInit(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        std::string sessionId = req.getHeader("X-Session-ID");
+        int userId;
+        std::string usernameFromSession;
+        if (!validateSession(sessionId, userId, usernameFromSession)) {
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
+            return true;
+        }
 
-            // 未找到匹配的路由，返回404
-            LOG_WARN << "No matching route found for " << path;
-            return handleNotFound(conn, resp);
+        json requestData = json::parse(req.body(), nullptr, false);
+        if (requestData.is_discarded() || !requestData.contains("size") ||
+            !requestData["size"].is_number_unsigned()) {
+            sendError(resp, "Invalid upload request", HttpResponse::k400BadRequest);
+            return true;
         }
-        catch (const std::exception& e) {
-            LOG_ERROR << "Error processing request: " << e.what();
-            sendError(resp, "Internal Server Error", HttpResponse::k500InternalServerError, conn);
+        uint64_t fileSize = requestData["size"].get<uint64_t>();
+        size_t chunkSize = requestData.value("chunkSize", kDefaultChunkSize);
+        std::string originalFilename = requestData.value("filename", "");
+        if (originalFilename.empty()) {
+            originalFilename = "unknown_file";
+        }
+        if (fileSize == 0 || chunkSize < kMinChunkSize || chunkSize > kMaxChunkSize) {
+            sendError(resp, "Invalid file size or chunk size", HttpResponse::k400BadRequest);
             return true;
         }
-    }
 
-private:
-    bool handleIndex(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        std::string uploadId = generateSessionId();
+        std::string filepath = blobStore_.tempPath(generateUniqueFilename("upload"));
+        auto session = std::make_shared<UploadSession>(uploadId, filepath, originalFilename,
+                                                       userId, fileSize, chunkSize);
+        if (!session->open()) {
+            sendError(resp, "Failed to create file", HttpResponse::k500InternalServerError);
+            return true;
+        }
+        uploadSessions_.add(session);
+        LOG_INFO << "Upload session " << uploadId << " created for " << originalFilename
+                 << ", size: " << fileSize << ", chunks: " << session->chunkCount();
+
+        json response = {
+            {"code", 0},
+            {"message", "success"},
+            {"uploadId", uploadId},
+            {"chunkSize", chunkSize},
+            {"chunkCount", session->chunkCount()}
+        };
         resp->setStatusCode(HttpResponse::k200Ok);
         resp->setStatusMessage("OK");
-        resp->setContentType("text/html; charset=utf-8");
-        
-        // 获取请求的路径
-        std::string path = req.path();
-        std::string filePath;
-        
-        LOG_INFO << "path = " << path;
-        // 编译时获取当前文件目录
-        std::string currentDir = __FILE__;
-        std::string::size_type pos = currentDir.find_last_of("/");
-        std::string projectRoot = currentDir.substr(0, pos);
-        LOG_INFO << "projectRoot = " << projectRoot;
-        // 根据请求路径选择不同的HTML文件
-        if (path == "/register.html") {
-            filePath = projectRoot + "/register.html";
-        } else if (path == "/share.html" || path.find("/share/") == 0) {
-            filePath = projectRoot + "/share.html";
-        } else {
-            filePath = projectRoot + "/index.html";
+        resp->setContentType("application/json");
+        resp->setBody(response.dump());
+        return true;
+    }
+
+    // 解析 /upload/<uploadId>/chunks/<index>
+    static bool parseChunkPath(const std::string& path, std::string* uploadId, size_t* index) {
+        static const std::string prefix = "/upload/";
+        static const std::string middle = "/chunks/";
+        if (path.compare(0, prefix.size(), prefix) != 0) {
+            return false;
         }
-        
-        // 从文件中读取 HTML 内容
-        std::ifstream file(filePath);
-        if (!file.is_open()) {
-            LOG_ERROR << "Failed to open " << filePath;
-            sendError(resp, "Failed to open " + filePath, HttpResponse::k500InternalServerError, conn);
-            return true;
+        size_t pos = path.find(middle, prefix.size());
+        if (pos == std::string::npos || pos == prefix.size()) {
+            return false;
         }
-        
-        std::string html((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-        file.close();
-        
-        resp->addHeader("Connection", "close");
-        resp->setBody(html);
-        
-        conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-            connection->shutdown();
-            return true;
-        });
+        std::string indexStr = path.substr(pos + middle.size());
+        if (indexStr.empty() || indexStr.size() > 9 ||
+            !std::all_of(indexStr.begin(), indexStr.end(), ::isdigit)) {
+            return false;
+        }
+        *uploadId = path.substr(prefix.size(), pos - prefix.size());
+        *index = static_cast<size_t>(std::stoul(indexStr));
         return true;
     }
 
-    bool handleFileUpload(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
-        // 验证会话
+    // 查找当前用户的上传会话，失败时填好错误响应并返回空指针
+    // cacheOnly为true时只从缓存中验证会话，用于IO线程
+    std::shared_ptr<UploadSession> findUploadSession(HttpRequest& req, HttpResponse* resp,
+                                                     const std::string& uploadId,
+                                                     bool cacheOnly = false) {
         std::string sessionId = req.getHeader("X-Session-ID");
         int userId;
         std::string usernameFromSession;
-        
-        if (!validateSession(sessionId, userId, usernameFromSession)) {
-            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized, conn);
-            return true;
+        if (!validateSession(sessionId, userId, usernameFromSession, cacheOnly)) {
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
+            return nullptr;
         }
-        
-        // 获取 HttpContext
+        std::shared_ptr<UploadSession> session = uploadSessions_.get(uploadId);
+        if (!session || session->userId() != userId) {
+            sendError(resp, "Upload session not found", HttpResponse::k404NotFound);
+            return nullptr;
+        }
+        return session;
+    }
+
+    // 分块请求的请求头到达时调用：找到会话并接管请求体，直接写入文件中该分块的位置
+    HttpServer::HeadersResult beginChunkUpload(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp,
+                                               const std::string& uploadId, size_t index) {
+        std::shared_ptr<UploadSession> session = findUploadSession(req, resp, uploadId, true);
+        if (!session) {
+            return HttpServer::kHeadersReject;
+        }
+        if (!session->beginChunk(index)) {
+            sendError(resp, "Invalid chunk index", HttpResponse::k400BadRequest);
+            return HttpServer::kHeadersReject;
+        }
+        auto chunkContext = std::make_shared<ChunkWriteContext>(session, index);
+
         auto httpContext = std::static_pointer_cast<HttpContext>(conn->getContext());
-        if (!httpContext) {
-            LOG_ERROR << "HttpContext is null";
-            sendError(resp, "Internal Server Error", HttpResponse::k500InternalServerError, conn);
+        httpContext->setContext(chunkContext);
+        std::weak_ptr<ChunkWriteContext> weakChunk(chunkContext);
+        chunkContext->setWriteQueue(startBodyQueue(conn, httpContext.get(),
+            [weakChunk](const char* data, size_t len) {
+                std::shared_ptr<ChunkWriteContext> chunk = weakChunk.lock();
+                return chunk && chunk->feed(data, len);
+            }));
+        return HttpServer::kHeadersAccept;
+    }
+
+    // 分块的请求体全部到达之后调用，等写入队列写完再回复
+    bool handleChunkUpload(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        auto httpContext = std::static_pointer_cast<HttpContext>(conn->getContext());
+        std::shared_ptr<ChunkWriteContext> chunkContext = httpContext->getContext<ChunkWriteContext>();
+        if (!chunkContext) {
+            // 没有请求体的PUT不会经过onHeaders
+            sendError(resp, "Empty chunk", HttpResponse::k400BadRequest);
             return true;
         }
-        LOG_INFO << "body.size() = " << req.body().size();
-        // 尝试获取已存在的上传上下文
-        std::shared_ptr<FileUploadContext> uploadContext = httpContext->getContext<FileUploadContext>();
-
-        if (!uploadContext) {
-            // 解析 multipart/form-data 边界
-            std::string contentType = req.getHeader("Content-Type");
-            if (contentType.empty()) {
-                sendError(resp, "Content-Type header is missing", HttpResponse::k400BadRequest, conn);
-                return true;
-            }
-            
-            std::regex boundaryRegex("boundary=(.+)$");
-            std::smatch matches;
-            if (!std::regex_search(contentType, matches, boundaryRegex)) {
-                sendError(resp, "Invalid Content-Type", HttpResponse::k400BadRequest, conn);
-                return true;
-            }
-            std::string boundary = "--" + matches[1].str();
-            LOG_INFO << "Boundary: " << boundary;
+        httpContext->setContext(nullptr);
 
-            try {
-                // 获取原始文件名
-                std::string originalFilename;
-                
-                // 首先尝试从X-File-Name头部获取文件名
-                std::string headerFilename = req.getHeader("X-File-Name");
-                if (!headerFilename.empty()) {
-                    originalFilename = urlDecode(headerFilename);
-                    LOG_INFO << "Got filename from X-File-Name header: " << originalFilename;
-                } else {
-                    // 从Content-Disposition头中获取文件名
-                    std::string body = req.body();
-                    if (body.empty()) {
-                        sendError(resp, "Request body is empty", HttpResponse::k400BadRequest, conn);
-                        return true;
-                    }
-                    
-                    std::regex filenameRegex("Content-Disposition:.*filename=\"([^\"]+)\"");
-                    if (std::regex_search(body, matches, filenameRegex) && matches[1].matched) {
-                        originalFilename = matches[1].str();
-                        LOG_INFO << "Got filename from Content-Disposition: " << originalFilename;
-                    } else {
-                        originalFilename = "unknown_file";
-                        LOG_INFO << "Using default filename: " << originalFilename;
-                    }
+        chunkContext->writeQueue()->finish(asyncTask(conn, req, resp,
+            [chunkContext](HttpRequest&, HttpResponse* response) {
+                // 在发送响应之前结束写入，客户端收到响应后马上complete也能看到这个分块
+                if (!chunkContext->end()) {
+                    sendError(response, "Incomplete chunk", HttpResponse::k400BadRequest);
+                    return;
                 }
+                const std::shared_ptr<UploadSession>& session = chunkContext->session();
+                json body = {
+                    {"code", 0},
+                    {"message", "success"},
+                    {"index", chunkContext->index()},
+                    {"size", chunkContext->written()},
+                    {"received", session->receivedCount()},
+                    {"chunkCount", session->chunkCount()}
+                };
 
-                // 生成服务器端文件名
-                std::string filename = generateUniqueFilename("upload");
-                std::string filepath = uploadDir_ + "/" + filename;
-                
-                // 创建上传上下文
-                uploadContext = std::make_shared<FileUploadContext>(filepath, originalFilename);
-                httpContext->setContext(uploadContext);
-                
-                // 设置边界
-                uploadContext->setBoundary(boundary);
-                
-                // 解析body中的文件内容
-                std::string body = req.body();
-                size_t pos = body.find("\r\n\r\n");
-                if (pos != std::string::npos) {
-                    // 跳过头部信息，获取文件内容
-                    pos += 4;
-                    
-                    // 检查是否是结束边界
-                    std::string endBoundary = boundary + "--";
-                    size_t endPos = body.find(endBoundary);
-                    if (endPos != std::string::npos) {
-                        LOG_INFO << "Found end boundary";
-                        // 先写入边界之前的内容
-                        if (endPos > 0) {
-                            uploadContext->writeData(body.data() + pos, endPos - pos);
-                            LOG_INFO << "Wrote " << endPos - pos << " bytes before end boundary, total: " << uploadContext->getTotalBytes();
-                        }
-                        // 找到结束边界，上传完成
-                        uploadContext->setState(FileUploadContext::State::kComplete);
-                    } else {
-                        // 直接写入从pos开始的所有内容
-                        if (pos < body.size()) {
-                            uploadContext->writeData(body.data() + pos, body.size() - pos);
-                            LOG_INFO << "Wrote " << body.size() - pos << " bytes, total: " << uploadContext->getTotalBytes();
-                        }
-                        uploadContext->setState(FileUploadContext::State::kExpectBoundary);
-                    }
-                }
-                
-                req.setBody(""); // 清空请求体
-                LOG_INFO << "Created upload context for file: " << filepath;
-            } catch (const std::exception& e) {
-                LOG_ERROR << "Failed to create upload context: " << e.what();
-                sendError(resp, "Failed to create file", HttpResponse::k500InternalServerError, conn);
-                return true;
-            }
-        } else {
-            try {
-                // 处理后续的数据块
-                std::string body = req.body();
-                if (!body.empty()) {
-                    LOG_INFO << "uploadContext->getState() = " << static_cast<int>(uploadContext->getState());
-                    switch (uploadContext->getState()) {
-                        case FileUploadContext::State::kExpectBoundary: {
-                            // 检查是否是结束边界 格式为：--boundary--
-                            std::string endBoundary = uploadContext->getBoundary() + "--";
-                            size_t endPos = body.find(endBoundary);
-                            if (endPos != std::string::npos) {
-                                // 在这里添加写入边界之前的内容
-                                if (endPos > 0) {
-                                    uploadContext->writeData(body.data(), endPos);
-                                    LOG_INFO << "Wrote " << endPos << " bytes before end boundary, total: " << uploadContext->getTotalBytes();
-                                }
-                                LOG_INFO << "Found end boundary";
-                                // 找到结束边界，上传完成
-                                uploadContext->setState(FileUploadContext::State::kComplete);
-                                break;
-                            }
-                            // 检查是否是普通边界 格式为：--boundary
-                            size_t boundaryPos = body.find(uploadContext->getBoundary());
-                            LOG_INFO << "检查是否是普通边界 boundaryPos:" << boundaryPos;
-                            if (boundaryPos != std::string::npos) {
-                                // 找到新边界的开始，跳过边界和头部
-                                size_t contentStart = body.find("\r\n\r\n", boundaryPos);
-                                if (contentStart != std::string::npos) {
-                                    contentStart += 4;
-                                    // 写入边界之前的内容
-                                    if (boundaryPos > 0) {
-                                        uploadContext->writeData(body.data(), boundaryPos);
-                                        LOG_INFO << "Wrote " << boundaryPos << " bytes, total: " << uploadContext->getTotalBytes();
-                                    }
-                                    // 更新状态
-                                    uploadContext->setState(FileUploadContext::State::kExpectContent);
-                                }
-                            } else {
-                                // 没有找到边界，写入所有内容
-                                uploadContext->writeData(body.data(), body.size());
-                                
-                                LOG_INFO << "Wrote " << body.size() << " bytes, total: " << uploadContext->getTotalBytes();
-                            }
-                            break;
-                        }
-                        
-                        case FileUploadContext::State::kExpectContent: {
-                            // 检查是否包含下一个边界
-                            size_t boundaryPos = body.find(uploadContext->getBoundary());
-                            if (boundaryPos != std::string::npos) {
-                                // 写入边界之前的内容
-                                uploadContext->writeData(body.data(), boundaryPos);
-                                LOG_INFO << "Wrote " << boundaryPos << " bytes, total: " << uploadContext->getTotalBytes();
-                                // 更新状态
-                                uploadContext->setState(FileUploadContext::State::kExpectBoundary);
-                            } else {
-                                // 没有找到边界，写入所有内容
-                                uploadContext->writeData(body.data(), body.size());
-                                LOG_INFO << "Wrote " << body.size() << " bytes, total: " << uploadContext->getTotalBytes();
-                            }
-                            break;
-                        }
-                        
-                        case FileUploadContext::State::kComplete:
-                            // 上传已完成，忽略后续数据
-                            break;
-                            
-                        default:
-                            LOG_INFO << "Unknown state: " << static_cast<int>(uploadContext->getState());
-                            break;
-                    }
-                    
-                    // 更新总处理字节数
-                    // uploadContext->addProcessedBytes(body.size());
-                }
-            } catch (const std::exception& e) {
-                LOG_ERROR << "Error processing data chunk: " << e.what();
-                sendError(resp, "Failed to process data", HttpResponse::k500InternalServerError, conn);
-                return true;
-            }
+                response->setStatusCode(HttpResponse::k200Ok);
+                response->setStatusMessage("OK");
+                response->setContentType("application/json");
+                response->setBody(body.dump());
+            }));
+        return false;
+    }
+
+    // 查询上传进度，客户端断线重连后只需要重传missing中的分块
+    bool handleUploadStatus(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        std::shared_ptr<UploadSession> session =
+            findUploadSession(req, resp, req.getPathParam("uploadId"));
+        if (!session) {
+            return true;
         }
-        req.setBody(""); // 清空请求体
+        json response = {
+            {"code", 0},
+            {"message", "success"},
+            {"uploadId", session->uploadId()},
+            {"filename", session->originalFilename()},
+            {"size", session->fileSize()},
+            {"chunkSize", session->chunkSize()},
+            {"chunkCount", session->chunkCount()},
+            {"received", session->receivedCount()},
+            {"missing", session->missingChunks()}
+        };
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("application/json");
+        resp->setBody(response.dump());
+        return true;
+    }
 
-        // 检查是否完成
-        if (uploadContext->getState() == FileUploadContext::State::kComplete || httpContext->gotAll()) {
-            // 上传完成，准备响应
-            std::string serverFilename = fs::path(uploadContext->getFilename()).filename().string();
-            std::string originalFilename = uploadContext->getOriginalFilename();
-            uintmax_t fileSize = uploadContext->getTotalBytes();
-            
-            // 检测文件类型
-            std::string fileType = getFileType(originalFilename);
-            
-            // 保存文件信息到数据库
-            std::string query = "INSERT INTO files (filename, original_filename, file_size, file_type, user_id) VALUES ('" +
-                              escapeString(serverFilename) + "', '" +
-                              escapeString(originalFilename) + "', " +
-                              std::to_string(fileSize) + ", '" +
-                              escapeString(fileType) + "', " +
-                              std::to_string(userId) + ")";
-            
-            if (!executeQuery(query)) {
-                LOG_ERROR << "保存文件信息到数据库失败";
-            }
-            
-            int fileId = static_cast<int>(mysql_insert_id(mysql));
-            
+    // 所有分块到齐后把文件入库
+    bool handleUploadComplete(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        std::shared_ptr<UploadSession> session =
+            findUploadSession(req, resp, req.getPathParam("uploadId"));
+        if (!session) {
+            return true;
+        }
+        if (!session->finish()) {
             json response = {
-                {"code", 0},
-                {"message", "上传成功"},
-                {"fileId", fileId},
-                {"filename", serverFilename},
-                {"originalFilename", originalFilename},
-                {"size", fileSize}
+                {"code", 409},
+                {"message", "Upload is not complete"},
+                {"missing", session->missingChunks()}
             };
-
-            resp->setStatusCode(HttpResponse::k200Ok);
-            resp->setStatusMessage("OK");
+            resp->setStatusCode(HttpResponse::k409Conflict);
+            resp->setStatusMessage("Conflict");
             resp->setContentType("application/json");
-            resp->addHeader("Connection", "close");
             resp->setBody(response.dump());
+            return true;
+        }
+        uploadSessions_.remove(session->uploadId());
+
+        std::string serverFilename = fs::path(session->filepath()).filename().string();
+        std::string originalFilename = session->originalFilename();
+        uint64_t fileSize = session->fileSize();
+        std::string fileType = getFileType(originalFilename);
+        // 分块乱序到达，无法边写边算哈希，在这里（工作线程中）读一遍文件
+        // 使用分块存储时同时切分文件，压缩保存时同时压缩到临时文件，会话文件随会话删除
+        std::string contentHash;
+        ChunkList chunks(&blobStore_.chunks());
+        std::string compressedFile = blobStore_.tempPath(serverFilename + ".gz");
+        std::string indexFile;
+        bool hashed;
+        if (chunkedStorage_) {
+            hashed = chunkFile(session->filepath(), &chunks, &contentHash);
+        } else if (compressedStorage_) {
+            hashed = compressFile(session->filepath(), compressedFile, &contentHash, &indexFile);
+        } else {
+            hashed = Sha256::hashFile(session->filepath(), &contentHash);
+        }
+        if (!hashed) {
+            LOG_ERROR << "Failed to hash " << session->filepath() << ", error: " << strerror(errno);
+            sendError(resp, "保存文件信息失败", HttpResponse::k500InternalServerError);
+            return true;
+        }
+        int fileId = 0;
+        auto addRef = [&]() {
+            return insertFileRecord(serverFilename, originalFilename, fileSize, fileType,
+                                    session->userId(), contentHash, &fileId);
+        };
+        bool stored;
+        if (chunkedStorage_) {
+            stored = blobStore_.putChunks(&chunks, contentHash, addRef);
+        } else if (!indexFile.empty()) {
+            stored = blobStore_.put(compressedFile, contentHash, addRef, indexFile);
+        } else {
+            stored = blobStore_.put(session->filepath(), contentHash, addRef);
+        }
+        if (!stored) {
+            LOG_ERROR << "保存文件信息到数据库失败";
+            if (!indexFile.empty()) {
+                ::unlink(compressedFile.c_str());
+                ::unlink(indexFile.c_str());
+            }
+            sendError(resp, "保存文件信息失败", HttpResponse::k500InternalServerError);
+            return true;
+        }
+        if (!chunkedStorage_ && indexFile.empty()) {
+            // 会话文件已经移入blob；分块存储时会话文件随会话删除
+            session->commit();
+        }
+        LOG_INFO << "Upload session " << session->uploadId() << " completed: " << serverFilename;
 
-            // 清理上下文
-            httpContext->setContext(nullptr);
-
-            conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-                LOG_INFO << "Upload complete, closing connection";
-                connection->shutdown();
-                return true;
-            });
+        json response = {
+            {"code", 0},
+            {"message", "上传成功"},
+            {"fileId", fileId},
+            {"filename", serverFilename},
+            {"originalFilename", originalFilename},
+            {"size", fileSize}
+        };
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("application/json");
+        resp->setBody(response.dump());
+        return true;
+    }
 
+    // 解析查询参数中的非负整数，参数为空时保留*value原来的值
+    static bool parseQueryNumber(const std::string& str, long long* value) {
+        if (str.empty()) {
             return true;
-        } else {
-            LOG_INFO << "Waiting for more data, current state: " 
-                     << static_cast<int>(uploadContext->getState());
+        }
+        if (str.size() > 18 || !std::all_of(str.begin(), str.end(), ::isdigit)) {
             return false;
         }
+        *value = std::stoll(str);
+        return true;
     }
 
     bool handleListFiles(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
@@ -683,133 +1535,199 @@ private:
         std::string usernameFromSession;
         
         if (!validateSession(sessionId, userId, usernameFromSession)) {
-            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized, conn);
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
             return true;
         }
         
         // 获取文件列表类型，默认只显示自己的文件
         std::string listType = req.getQuery("type", "my");  // "my", "shared", "all"
-        
-        std::string query;
+        // 排序字段和方向只能取下面的固定值，不会把请求中的字符串拼进SQL
+        std::string sort = req.getQuery("sort", "time");    // "time", "name", "size"
+        std::string order = req.getQuery("order", "desc");  // "asc", "desc"
+        long long limit = kDefaultPageSize;
+        long long after = 0;  // 上一页最后一个文件的id，0表示第一页
+        if (!parseQueryNumber(req.getQuery("limit", ""), &limit) ||
+            !parseQueryNumber(req.getQuery("after", ""), &after) ||
+            (listType != "my" && listType != "shared" && listType != "all") ||
+            (sort != "time" && sort != "name" && sort != "size") ||
+            (order != "asc" && order != "desc")) {
+            sendError(resp, "Invalid list parameters", HttpResponse::k400BadRequest);
+            return true;
+        }
+        limit = std::max(1LL, std::min(limit, static_cast<long long>(kMaxPageSize)));
+
+        std::string cacheKey = listType + "|" + sort + "|" + order + "|" +
+                               std::to_string(limit) + "|" + std::to_string(after);
+        std::string cachedBody;
+        if (fileListCache_.get(userId, cacheKey, &cachedBody)) {
+            resp->setStatusCode(HttpResponse::k200Ok);
+            resp->setStatusMessage("OK");
+            resp->setContentType("application/json");
+            resp->setBody(cachedBody);
+            return true;
+        }
+        // 在查询之前取版本号，查询期间有文件变化时结果不放入缓存
+        uint64_t cacheVersion = fileListCache_.version();
+
+        // 一次查询取出一页文件及其分享信息：只有自己的文件带分享信息，多条分享时取最早的一条
+        std::string sql =
+            "SELECT f.id, f.filename, f.original_filename, f.file_size, f.file_type, f.created_at, "
+            "f.user_id = ? AS is_owner, "
+            "s.share_type, s.shared_with_id, s.share_code, s.expire_time, s.extract_code, u.username "
+            "FROM files f "
+            "LEFT JOIN file_shares s ON s.id = (SELECT MIN(id) FROM file_shares WHERE file_id = f.id) "
+            "AND f.user_id = ? "
+            "LEFT JOIN users u ON u.id = s.shared_with_id AND s.share_type = 'user' "
+            "WHERE ";
+        std::vector<DbParam> params{userId, userId};
+
+        // 分享给自己的文件用EXISTS判断，一个文件有多条分享时也只出现一次
+        const char* sharedWithMe =
+            "EXISTS (SELECT 1 FROM file_shares x WHERE x.file_id = f.id "
+            "AND (x.shared_with_id = ? OR x.share_type = 'public'))";
         if (listType == "my") {
-            // 获取自己的文件selec
-            query = "SELECT f.id, f.filename, f.original_filename, f.file_size, f.file_type, "
-                    "f.created_at, 1 as is_owner FROM files f WHERE f.user_id = " + std::to_string(userId);
+            sql += "f.user_id = ?";
+            params.push_back(userId);
         } else if (listType == "shared") {
-            // 获取分享给自己的文件
-            query = "SELECT f.id, f.filename, f.original_filename, f.file_size, f.file_type, "
-                    "f.created_at, 0 as is_owner FROM files f "
-                    "JOIN file_shares fs ON f.id = fs.file_id "
-                    "WHERE (fs.shared_with_id = " + std::to_string(userId) + " OR fs.share_type = 'public') "
-                    "AND f.user_id != " + std::to_string(userId);
-        } else if (listType == "all") {
-            // 获取所有文件（包括自己的和分享的）
-            query = "SELECT f.id, f.filename, f.original_filename, f.file_size, f.file_type, "
-                    "f.created_at, CASE WHEN f.user_id = " + std::to_string(userId) + " THEN 1 ELSE 0 END as is_owner "
-                    "FROM files f "
-                    "LEFT JOIN file_shares fs ON f.id = fs.file_id "
-                    "WHERE f.user_id = " + std::to_string(userId) + " OR "
-                    "fs.shared_with_id = " + std::to_string(userId) + " OR fs.share_type = 'public'";
+            sql += std::string("f.user_id != ? AND ") + sharedWithMe;
+            params.push_back(userId);
+            params.push_back(userId);
+        } else {
+            sql += std::string("(f.user_id = ? OR ") + sharedWithMe + ")";
+            params.push_back(userId);
+            params.push_back(userId);
+        }
+
+        // 键集分页：从游标所指文件的排序位置之后继续，id保证排序唯一；
+        // 按时间排序直接用自增id，与created_at的先后一致
+        std::string column = sort == "name" ? "original_filename" : sort == "size" ? "file_size" : "";
+        const char* direction = order == "asc" ? "ASC" : "DESC";
+        const char* compare = order == "asc" ? " > " : " < ";
+        if (after > 0) {
+            if (!column.empty()) {
+                sql += " AND (f." + column + ", f.id)" + compare +
+                       "(SELECT " + column + ", id FROM files WHERE id = ?)";
+            } else {
+                sql += std::string(" AND f.id") + compare + "?";
+            }
+            params.push_back(after);
         }
-        LOG_INFO << "query = " << query;
-        MYSQL_RES* result = executeQueryWithResult(query);
-        
+        sql += " ORDER BY ";
+        if (!column.empty()) {
+            sql += "f." + column + " " + direction + ", ";
+        }
+        // 多取一行用来判断是否还有下一页
+        sql += std::string("f.id ") + direction + " LIMIT ?";
+        params.push_back(limit + 1);
+
+        DbResult result;
+        if (!db().execute(sql, params, &result)) {
+            sendError(resp, "Failed to list files", HttpResponse::k500InternalServerError);
+            return true;
+        }
+
         json response;
         response["code"] = 0;
         response["message"] = "Success";
         json files = json::array();
-        
-        if (result) {
-            MYSQL_ROW row;
-            while ((row = mysql_fetch_row(result))) {
-                int fileId = std::stoi(row[0]);
-                std::string filename = row[1];
-                std::string originalFilename = row[2];
-                uintmax_t fileSize = std::stoull(row[3]);
-                std::string fileType = row[4];
-                std::string createdAt = row[5];
-                bool isOwner = (std::stoi(row[6]) == 1);
-                
-                // 如果是文件所有者，获取分享信息
-                json shareInfo = nullptr;
-                if (isOwner) {
-                    std::string shareQuery = "SELECT share_type, shared_with_id, share_code, expire_time, extract_code FROM file_shares "
-                                          "WHERE file_id = " + std::to_string(fileId);
-                    MYSQL_RES* shareResult = executeQueryWithResult(shareQuery);
-                    
-                    if (shareResult && mysql_num_rows(shareResult) > 0) {
-                        MYSQL_ROW shareRow = mysql_fetch_row(shareResult);
-                        std::string shareType = shareRow[0];
-                        
-                        shareInfo = {
-                            {"type", shareType},
-                            {"shareCode", shareRow[2] ? shareRow[2] : ""}
-                        };
-
-                        if (shareType == "protected" && shareRow[4]) {
-                            shareInfo["extractCode"] = shareRow[4];
-                        }
-                        
-                        if (shareType == "user" && shareRow[1]) {
-                            int sharedWithId = std::stoi(shareRow[1]);
-                            // 获取共享用户的用户名
-                            std::string userQuery = "SELECT username FROM users WHERE id = " + std::to_string(sharedWithId);
-                            MYSQL_RES* userResult = executeQueryWithResult(userQuery);
-                            if (userResult && mysql_num_rows(userResult) > 0) {
-                                MYSQL_ROW userRow = mysql_fetch_row(userResult);
-                                shareInfo["sharedWithUsername"] = userRow[0];
-                                shareInfo["sharedWithId"] = sharedWithId;
-                            }
-                            if (userResult) mysql_free_result(userResult);
-                        }
-                        
-                        if (shareRow[3]) {
-                            shareInfo["expireTime"] = shareRow[3];
-                        }
-                    }
-                    
-                    if (shareResult) mysql_free_result(shareResult);
-                }
-                
-                json fileInfo = {
-                    {"id", fileId},
-                    {"name", filename},
-                    {"originalName", originalFilename},
-                    {"size", fileSize},
-                    {"type", fileType},
-                    {"createdAt", createdAt},
-                    {"isOwner", isOwner}
+        size_t count = std::min(result.size(), static_cast<size_t>(limit));
+        for (size_t i = 0; i < count; ++i) {
+            const DbRow& row = result[i];
+            int fileId = std::stoi(row[0]);
+            bool isOwner = row[6] && std::stoi(row[6]) == 1;
+
+            json fileInfo = {
+                {"id", fileId},
+                {"name", row[1]},
+                {"originalName", row[2]},
+                {"size", static_cast<uintmax_t>(std::stoull(row[3]))},
+                {"type", row[4] ? row[4] : ""},
+                {"createdAt", row[5] ? row[5] : ""},
+                {"isOwner", isOwner}
+            };
+
+            // 文件所有者才能看到分享信息
+            if (isOwner && row[7]) {
+                std::string shareType = row[7];
+                json shareInfo = {
+                    {"type", shareType},
+                    {"shareCode", row[9] ? row[9] : ""}
                 };
-                
-                if (shareInfo != nullptr) {
-                    fileInfo["shareInfo"] = shareInfo;
+                if (shareType == "protected" && row[11]) {
+                    shareInfo["extractCode"] = row[11];
                 }
-                
-                files.push_back(fileInfo);
+                if (shareType == "user" && row[8] && row[12]) {
+                    shareInfo["sharedWithUsername"] = row[12];
+                    shareInfo["sharedWithId"] = std::stoi(row[8]);
+                }
+                if (row[10]) {
+                    shareInfo["expireTime"] = row[10];
+                }
+                fileInfo["shareInfo"] = shareInfo;
             }
-            response["files"] = files;
+
+            files.push_back(fileInfo);
         }
+        response["files"] = files;
+        // 下一页的游标，没有更多文件时为null
+        response["nextCursor"] = result.size() > count ? json(std::stoi(result[count - 1][0])) : json(nullptr);
+
+        std::string body = response.dump();
+        fileListCache_.put(userId, cacheKey, listType != "my", cacheVersion, body);
 
         resp->setStatusCode(HttpResponse::k200Ok);
         resp->setStatusMessage("OK");
         resp->setContentType("application/json");
-        resp->addHeader("Connection", "close");
-        resp->setBody(response.dump());
+        resp->setBody(body);
+
+        return true;
+    }
+
+    // 在自己的文件中按文件名搜索，只访问内存中的索引
+    bool handleSearchFiles(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+        std::string sessionId = req.getHeader("X-Session-ID");
+        int userId;
+        std::string usernameFromSession;
+        if (!validateSession(sessionId, userId, usernameFromSession)) {
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
+            return true;
+        }
 
-        // 设置写完成回调以关闭连接
-        conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-            LOG_INFO << "List files complete, closing connection";
-            connection->shutdown();
+        std::string keyword = urlDecode(req.getQuery("q", ""));
+        long long offset = 0;
+        long long limit = kDefaultSearchLimit;
+        if (keyword.empty() ||
+            !parseQueryNumber(req.getQuery("offset", ""), &offset) ||
+            !parseQueryNumber(req.getQuery("limit", ""), &limit)) {
+            sendError(resp, "Invalid search parameters", HttpResponse::k400BadRequest);
             return true;
-        });
+        }
+        limit = std::max(1LL, std::min(limit, static_cast<long long>(kMaxSearchLimit)));
 
+        size_t total;
+        std::vector<SearchIndex::Hit> hits = fileIndex_.search(
+            userId, keyword, static_cast<size_t>(offset), static_cast<size_t>(limit), &total);
+        json files = json::array();
+        for (const SearchIndex::Hit& hit : hits) {
+            files.push_back(json::parse(hit.payload));
+        }
+        json response = {
+            {"code", 0},
+            {"message", "Success"},
+            {"files", files},
+            {"total", total}
+        };
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("application/json");
+        resp->setBody(response.dump());
         return true;
     }
 
     bool handleDownload(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
         std::string filename = req.getPathParam("filename");
         if (filename.empty()) {
-            sendError(resp, "Missing filename", HttpResponse::k400BadRequest, conn);
+            sendError(resp, "Missing filename", HttpResponse::k400BadRequest);
             return true;
         }
         
@@ -831,37 +1749,35 @@ private:
         LOG_INFO << "shareCode = " << shareCode << ", extractCode = " << extractCode;
         
         // 查询文件信息和权限
-        std::string query;
+        DbResult result;
+        bool ok;
         if (!shareCode.empty()) {
             // 通过分享链接访问
-            query = "SELECT f.id, f.filename, f.original_filename, f.user_id, "
-                    "fs.share_type, fs.shared_with_id, fs.extract_code "
-                    "FROM files f "
-                    "JOIN file_shares fs ON f.id = fs.file_id "
-                    "WHERE f.filename = '" + escapeString(filename) + "' "
-                    "AND fs.share_code = '" + escapeString(shareCode) + "' "
-                    "AND (fs.expire_time IS NULL OR fs.expire_time > NOW())";
+            ok = db().execute("SELECT f.id, f.filename, f.original_filename, f.user_id, "
+                              "fs.share_type, fs.shared_with_id, fs.extract_code, f.content_hash "
+                              "FROM files f "
+                              "JOIN file_shares fs ON f.id = fs.file_id "
+                              "WHERE f.filename = ? AND fs.share_code = ? "
+                              "AND (fs.expire_time IS NULL OR fs.expire_time > NOW())",
+                              {filename, shareCode}, &result);
         } else {
             // 直接访问(需要登录)
             if (!isAuthenticated) {
-                sendError(resp, "请先登录", HttpResponse::k401Unauthorized, conn);
+                sendError(resp, "请先登录", HttpResponse::k401Unauthorized);
                 return true;
             }
-            query = "SELECT f.id, f.filename, f.original_filename, f.user_id, "
-                    "NULL as share_type, NULL as shared_with_id, NULL as extract_code "
-                    "FROM files f WHERE f.filename = '" + escapeString(filename) + "'";
+            ok = db().execute("SELECT f.id, f.filename, f.original_filename, f.user_id, "
+                              "NULL as share_type, NULL as shared_with_id, NULL as extract_code, "
+                              "f.content_hash FROM files f WHERE f.filename = ?",
+                              {filename}, &result);
         }
-        
-        LOG_INFO << "查询文件信息: " << query;
-        MYSQL_RES* result = executeQueryWithResult(query);
-        
-        if (!result || mysql_num_rows(result) == 0) {
-            if (result) mysql_free_result(result);
-            sendError(resp, "File not found", HttpResponse::k404NotFound, conn);
+
+        if (!ok || result.empty()) {
+            sendError(resp, "File not found", HttpResponse::k404NotFound);
             return true;
         }
-        
-        MYSQL_ROW row = mysql_fetch_row(result);
+
+        const DbRow& row = result[0];
         int fileId = std::stoi(row[0]);
         std::string serverFilename = row[1];
         std::string originalFilename = row[2];
@@ -869,7 +1785,7 @@ private:
         std::string shareType = row[4] ? row[4] : "";
         int sharedWithId = row[5] ? std::stoi(row[5]) : 0;
         std::string dbExtractCode = row[6] ? row[6] : "";
-        mysql_free_result(result);
+        std::string contentHash = row[7] ? row[7] : "";
         
         // 检查访问权限
         bool hasPermission = false;
@@ -904,45 +1820,84 @@ private:
         if (!hasPermission) {
             if (shareType == "protected" && (extractCode.empty() || extractCode != dbExtractCode)) {
                 LOG_ERROR << "提取码错误或未提供";
-                sendError(resp, "需要正确的提取码", HttpResponse::k403Forbidden, conn);
+                sendError(resp, "需要正确的提取码", HttpResponse::k403Forbidden);
             } else {
                 LOG_ERROR << "权限检查失败 - 用户ID: " << userId << ", 文件ID: " << fileId;
-                sendError(resp, "您没有权限访问此文件", HttpResponse::k403Forbidden, conn);
+                sendError(resp, "您没有权限访问此文件", HttpResponse::k403Forbidden);
             }
             return true;
         }
         
         LOG_INFO << "权限检查通过，准备下载文件";
+        return serveFile(conn, req, resp, openStoredFile(serverFilename, contentHash, originalFilename));
+    }
+
+    // 打开要下载的文件：分块存储的文件读取分块清单，压缩保存的文件读取帧索引，有内容哈希的文件保存在blob中，
+    // 旧数据仍按文件名保存；文件不存在时返回空指针
+    std::unique_ptr<FileDownContext> openStoredFile(const std::string& serverFilename,
+                                                    const std::string& contentHash,
+                                                    const std::string& originalFilename) {
         std::string filepath = uploadDir_ + "/" + serverFilename;
-        
+        if (BlobStore::isValidHash(contentHash)) {
+            ChunkStore& chunkStore = blobStore_.chunks();
+            uint64_t fileSize;
+            std::vector<ChunkStore::Chunk> chunks;
+            if (chunkStore.readManifest(contentHash, &fileSize, &chunks)) {
+                std::vector<FileDownContext::Segment> segments;
+                segments.reserve(chunks.size());
+                for (const ChunkStore::Chunk& chunk : chunks) {
+                    segments.push_back(FileDownContext::Segment{chunkStore.chunkPath(chunk.hash), chunk.size});
+                }
+                return std::unique_ptr<FileDownContext>(
+                    new FileDownContext(std::move(segments), originalFilename));
+            }
+            std::string indexPath = blobStore_.indexPath(contentHash);
+            if (::access(indexPath.c_str(), F_OK) == 0) {
+                auto reader = std::make_shared<SeekableGzipReader>();
+                if (!reader->open(blobStore_.compressedPath(contentHash), indexPath)) {
+                    return nullptr;
+                }
+                return std::unique_ptr<FileDownContext>(new FileDownContext(reader, originalFilename));
+            }
+            filepath = blobStore_.blobPath(contentHash);
+        }
+        try {
+            return std::unique_ptr<FileDownContext>(new FileDownContext(filepath, originalFilename));
+        } catch (const std::exception& e) {
+            LOG_ERROR << e.what();
+            return nullptr;
+        }
+    }
+
+    // 发送文件（支持HEAD和Range），文件内容通过sendfile零拷贝发送；
+    // 压缩保存的文件边解压边发送，客户端接受gzip时原样发送压缩数据
+    bool serveFile(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp,
+                   std::unique_ptr<FileDownContext> downContext) {
         try {
-            if (!fs::exists(filepath) || !fs::is_regular_file(filepath)) {
-                sendError(resp, "File not found", HttpResponse::k404NotFound, conn);
+            if (!downContext) {
+                sendError(resp, "File not found", HttpResponse::k404NotFound);
                 return true;
             }
             
             // 获取文件大小
-            uintmax_t fileSize = fs::file_size(filepath);
+            uintmax_t fileSize = downContext->getFileSize();
+            const std::string& originalFilename = downContext->getOriginalFilename();
             
             // 如果是 HEAD 请求，只返回文件信息
+            // 总是描述未压缩的内容，客户端据此计算Range
             if (req.method() == HttpRequest::kHead) {
                 resp->setStatusCode(HttpResponse::k200Ok);
                 resp->setStatusMessage("OK");
                 resp->setContentType("application/octet-stream");
                 resp->addHeader("Content-Length", std::to_string(fileSize));
                 resp->addHeader("Accept-Ranges", "bytes");
-                resp->addHeader("Connection", "close");
-                conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-                    connection->shutdown();
-                    return true;
-                });
                 return true;
             }
             
             // 解析Range头部
             std::string rangeHeader = req.getHeader("Range");
             uintmax_t startPos = 0;
-            uintmax_t endPos = fileSize - 1;
+            uintmax_t endPos = fileSize == 0 ? 0 : fileSize - 1;
             bool isRangeRequest = false;
             
             if (!rangeHeader.empty()) {
@@ -958,7 +1913,7 @@ private:
                     
                     // 验证范围
                     if (startPos >= fileSize) {
-                        sendError(resp, "Range Not Satisfiable", HttpResponse::k416RangeNotSatisfiable, conn);
+                        sendError(resp, "Range Not Satisfiable", HttpResponse::k416RangeNotSatisfiable);
                         return true;
                     }
                     
@@ -966,71 +1921,55 @@ private:
                     if (endPos >= fileSize) {
                         endPos = fileSize - 1;
                     }
+                    if (endPos < startPos) {
+                        sendError(resp, "Range Not Satisfiable", HttpResponse::k416RangeNotSatisfiable);
+                        return true;
+                    }
                 }
             }
             //打印 startPos ， endPos
             LOG_INFO << "startPos: " << startPos << ", endPos: " << endPos;
-            
-            // 获取 HttpContext
-            auto httpContext = std::static_pointer_cast<HttpContext>(conn->getContext());
-            if (!httpContext) {
-                LOG_ERROR << "HttpContext is null";
-                sendError(resp, "Internal Server Error", HttpResponse::k500InternalServerError, conn);
-                return true;
-            }
-            
-            // 尝试获取已存在的下载上下文
-            std::shared_ptr<FileDownContext> downContext = httpContext->getContext<FileDownContext>();
-            
-            if (!downContext) {
-                // 创建新的下载上下文
-                downContext = std::make_shared<FileDownContext>(filepath, originalFilename);
-                httpContext->setContext(downContext);
-                
-                // 设置初始响应头
-                if (isRangeRequest) {
-                    resp->setStatusCode(HttpResponse::k206PartialContent);
-                    resp->setStatusMessage("Partial Content");
-                    resp->addHeader("Content-Range", 
-                                  "bytes " + std::to_string(startPos) + "-" + 
-                                  std::to_string(endPos) + "/" + 
-                                  std::to_string(fileSize));
-                } else {
-                    resp->setStatusCode(HttpResponse::k200Ok);
-                    resp->setStatusMessage("OK");
-                }
-                
-                resp->setContentType("application/octet-stream");
-                resp->addHeader("Content-Disposition", 
-                              "attachment; filename=\"" + originalFilename + "\"");
-                resp->addHeader("Accept-Ranges", "bytes");
-                resp->addHeader("Connection", "keep-alive");
-                
-                // 设置文件指针到起始位置
-                downContext->seekTo(startPos);
+
+            downContext->seekTo(startPos);
+            uintmax_t contentLength = isRangeRequest ? endPos - startPos + 1 : fileSize;
+
+            // 设置响应头
+            if (isRangeRequest) {
+                resp->setStatusCode(HttpResponse::k206PartialContent);
+                resp->setStatusMessage("Partial Content");
+                resp->addHeader("Content-Range", 
+                              "bytes " + std::to_string(startPos) + "-" + 
+                              std::to_string(endPos) + "/" + 
+                              std::to_string(fileSize));
+            } else {
+                resp->setStatusCode(HttpResponse::k200Ok);
+                resp->setStatusMessage("OK");
             }
             
-            // 设置写完成回调，继续发送下一个数据块
-            conn->setWriteCompleteCallback([this, downContext](const TcpConnectionPtr& connection) {
-                // 读取下一个数据块
-                std::string chunk;
-                if (downContext->readNextChunk(chunk)) {
-                    // 直接发送数据块
-                    connection->send(chunk);
-                    return true;
-                } else {
-                    // 下载完成，关闭连接
-                    LOG_INFO << "Download complete, closing connection";
-                    connection->shutdown();
+            resp->setContentType("application/octet-stream");
+            resp->addHeader("Content-Disposition", 
+                          "attachment; filename=\"" + originalFilename + "\"");
+            resp->addHeader("Accept-Ranges", "bytes");
+            if (downContext->compressed()) {
+                resp->addHeader("Vary", "Accept-Encoding");
+                // 压缩保存的文件在不带Range且客户端接受gzip时原样发送，不需要解压
+                if (!isRangeRequest &&
+                    ContentEncoding::accepts(req.getHeader("Accept-Encoding"), ContentEncoding::kGzip)) {
+                    resp->addHeader("Content-Encoding", "gzip");
+                    resp->addHeader("Content-Length", std::to_string(downContext->getCompressedSize()));
+                    downContext->attachCompressedBody(resp);
                     return true;
                 }
-            });
-            
+            }
+            resp->addHeader("Content-Length", std::to_string(contentLength));
+
+            // 头部发送后，由HttpServer调用TcpConnection::sendFile发送文件区间
+            downContext->attachBody(resp, contentLength);
             return true;
         }
         catch (const std::exception& e) {
             LOG_ERROR << "Error during file download: " << e.what();
-            sendError(resp, "Download failed", HttpResponse::k500InternalServerError, conn);
+            sendError(resp, "Download failed", HttpResponse::k500InternalServerError);
             return true;
         }
     }
@@ -1042,61 +1981,73 @@ private:
         std::string usernameFromSession;
         
         if (!validateSession(sessionId, userId, usernameFromSession)) {
-            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized, conn);
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
             return true;
         }
 
         // 从路径参数中获取文件名
         std::string filename = req.getPathParam("filename");
         if (filename.empty()) {
-            sendError(resp, "Missing filename", HttpResponse::k400BadRequest, conn);
+            sendError(resp, "Missing filename", HttpResponse::k400BadRequest);
             LOG_WARN << "Missing filename";
             return true;
         }
         
-        // 构建完整的文件路径
-        std::string filepath = uploadDir_ + "/" + filename;
-        LOG_INFO << "filepath = " << filepath;
-
-        // 检查文件所有权
-        std::string query = "SELECT id FROM files WHERE filename = '" + escapeString(filename) + 
-                          "' AND user_id = " + std::to_string(userId);
-        MYSQL_RES* result = executeQueryWithResult(query);
-        
-        if (!result || mysql_num_rows(result) == 0) {
-            if (result) mysql_free_result(result);
-            sendError(resp, "文件不存在或您没有权限删除此文件", HttpResponse::k403Forbidden, conn);
+        // 检查文件所有权
+        DbResult result;
+        if (!db().execute("SELECT id, content_hash FROM files WHERE filename = ? AND user_id = ?",
+                          {filename, userId}, &result) ||
+            result.empty()) {
+            sendError(resp, "文件不存在或您没有权限删除此文件", HttpResponse::k403Forbidden);
             return true;
         }
         
-        MYSQL_ROW row = mysql_fetch_row(result);
-        int fileId = std::stoi(row[0]);
-        mysql_free_result(result);
+        int fileId = std::stoi(result[0][0]);
+        std::string contentHash = result[0][1] ? result[0][1] : "";
         
         // 删除文件分享记录
-        std::string deleteSharesQuery = "DELETE FROM file_shares WHERE file_id = " + std::to_string(fileId);
-        if (!executeQuery(deleteSharesQuery)) {
+        if (!db().execute("DELETE FROM file_shares WHERE file_id = ?", {fileId})) {
             LOG_ERROR << "删除文件分享记录失败";
+        } else if (db().affectedRows() > 0) {
+            // 被分享的文件从其他用户的列表中消失
+            fileListCache_.invalidateShared();
+        }
+        shareCache_.removeFile(fileId);
+        
+        // 删除文件记录，blob只在最后一条引用它的记录删除后才删除
+        bool deleted;
+        if (BlobStore::isValidHash(contentHash)) {
+            deleted = blobStore_.release(contentHash, [&]() -> long long {
+                if (!db().execute("DELETE FROM files WHERE id = ?", {fileId})) {
+                    return -1;
+                }
+                DbResult refs;
+                if (!db().execute("SELECT COUNT(*) FROM files WHERE content_hash = ?",
+                                  {contentHash}, &refs) ||
+                    refs.empty()) {
+                    // 无法确认引用数时保留blob
+                    return 1;
+                }
+                return std::stoll(refs[0][0]);
+            });
+        } else {
+            deleted = db().execute("DELETE FROM files WHERE id = ?", {fileId});
+            if (deleted) {
+                // 旧数据按文件名保存，没有共享
+                std::string filepath = uploadDir_ + "/" + filename;
+                if (unlink(filepath.c_str()) != 0) {
+                    LOG_WARN << "Failed to delete file: " << filepath << ", error: " << strerror(errno);
+                }
+            }
         }
-        
-        // 删除文件记录
-        std::string deleteFileQuery = "DELETE FROM files WHERE id = " + std::to_string(fileId);
-        if (!executeQuery(deleteFileQuery)) {
+        fileListCache_.invalidateUser(userId);
+        if (!deleted) {
             LOG_ERROR << "删除文件记录失败";
-            sendError(resp, "删除文件记录失败", HttpResponse::k500InternalServerError, conn);
+            sendError(resp, "删除文件记录失败", HttpResponse::k500InternalServerError);
             return true;
         }
-        
-        // 检查文件是否存在
-        if (access(filepath.c_str(), F_OK) != 0) {
-            LOG_WARN << filepath << " not found";
-        } else {
-            // 删除文件
-            if (unlink(filepath.c_str()) != 0) {
-                LOG_WARN << "Failed to delete file: " << filepath << ", error: " << strerror(errno);
-            }
-            LOG_INFO << "delete file success";
-        }
+        LOG_INFO << "delete file success";
+        fileIndex_.remove(fileId);
         
         // 删除文件名映射记录
         {
@@ -1114,13 +2065,8 @@ private:
         resp->setStatusCode(HttpResponse::k200Ok);
         resp->setStatusMessage("OK");
         resp->setContentType("application/json");
-        resp->addHeader("Connection", "close");
         resp->setBody(response.dump());
 
-        conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-            connection->shutdown();
-            return true;
-        });
         return true;
     }
 
@@ -1132,18 +2078,13 @@ private:
         resp->setStatusCode(HttpResponse::k404NotFound);
         resp->setStatusMessage("Not Found");
         resp->setContentType("application/json");
-        resp->addHeader("Connection", "close");
         resp->setBody(response.dump());
 
-        conn->setWriteCompleteCallback([conn](const TcpConnectionPtr& connection) {
-            connection->shutdown();
-            return true;
-        });
         return true;
     }
 
-    static void sendError(HttpResponse* resp, const std::string& message, 
-                  HttpResponse::HttpStatusCode code, const TcpConnectionPtr& conn) {
+    static void sendError(HttpResponse* resp, const std::string& message,
+                          HttpResponse::HttpStatusCode code) {
         json response = {
             {"code", static_cast<int>(code)},
             {"message", message}
@@ -1151,15 +2092,7 @@ private:
         resp->setStatusCode(code);
         resp->setStatusMessage(message);
         resp->setContentType("application/json");
-        resp->addHeader("Connection", "close");
         resp->setBody(response.dump());
-
-        if (conn) {
-            conn->setWriteCompleteCallback([conn](const TcpConnectionPtr& connection) {
-                connection->shutdown();
-                return true;
-            });
-        }
     }
 
     std::string generateUniqueFilename(const std::string& prefix) {
@@ -1270,7 +2203,7 @@ private:
             LOG_INFO << "Register attempt for username: " << username;
             // 简单验证
             if (username.empty() || password.empty()) {
-                sendError(resp, "用户名和密码不能为空", HttpResponse::k400BadRequest, conn);
+                sendError(resp, "用户名和密码不能为空", HttpResponse::k400BadRequest);
                 return true;
             }
 
@@ -1285,7 +2218,7 @@ private:
             
             if (result && mysql_num_rows(result) > 0) {
                 mysql_free_result(result);
-                sendError(resp, "用户名已存在", HttpResponse::k400BadRequest, conn);
+                sendError(resp, "用户名已存在", HttpResponse::k400BadRequest);
                 return true;
             }
             
@@ -1300,12 +2233,13 @@ private:
                                     (email.empty() ? "NULL" : ("'" + escapeString(email) + "'")) + ")";
             
             if (!executeQuery(insertQuery)) {
-                sendError(resp, "注册失败，请稍后重试", HttpResponse::k500InternalServerError, conn);
+                sendError(resp, "注册失败，请稍后重试", HttpResponse::k500InternalServerError);
                 return true;
             }
 
             // 获取新用户ID
-            int userId = static_cast<int>(mysql_insert_id(mysql));
+            int userId = static_cast<int>(db().lastInsertId());
+            indexUser(userId, username, email);
 
             json response = {
                 {"code", 0},
@@ -1316,19 +2250,13 @@ private:
             resp->setStatusCode(HttpResponse::k200Ok);
             resp->setStatusMessage("OK");
             resp->setContentType("application/json");
-            resp->addHeader("Connection", "close");
             resp->setBody(response.dump());
 
-            conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-                connection->shutdown();
-                return true;
-            });
-
             return true;
         }
         catch (const std::exception& e) {
             LOG_ERROR << "用户注册错误: " << e.what();
-            sendError(resp, "注册失败: " + std::string(e.what()), HttpResponse::k500InternalServerError, conn);
+            sendError(resp, "注册失败: " + std::string(e.what()), HttpResponse::k500InternalServerError);
             return true;
         }
     }
@@ -1342,7 +2270,7 @@ private:
 
             // 验证参数
             if (username.empty() || password.empty()) {
-                sendError(resp, "用户名和密码不能为空", HttpResponse::k400BadRequest, conn);
+                sendError(resp, "用户名和密码不能为空", HttpResponse::k400BadRequest);
                 return true;
             }
 
@@ -1360,7 +2288,7 @@ private:
                 if (result) {
                     mysql_free_result(result);
                 }
-                sendError(resp, "用户名或密码错误", HttpResponse::k401Unauthorized, conn);
+                sendError(resp, "用户名或密码错误", HttpResponse::k401Unauthorized);
                 return true;
             }
 
@@ -1384,19 +2312,13 @@ private:
             resp->setStatusCode(HttpResponse::k200Ok);
             resp->setStatusMessage("OK");
             resp->setContentType("application/json");
-            resp->addHeader("Connection", "close");
             resp->setBody(response.dump());
 
-            conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-                connection->shutdown();
-                return true;
-            });
-
             return true;
         }
         catch (const std::exception& e) {
             LOG_ERROR << "用户登录错误: " << e.what();
-            sendError(resp, "登录失败: " + std::string(e.what()), HttpResponse::k500InternalServerError, conn);
+            sendError(resp, "登录失败: " + std::string(e.what()), HttpResponse::k500InternalServerError);
             return true;
         }
     }
@@ -1422,46 +2344,42 @@ private:
         
         // 保存会话
         void saveSession(const std::string& sessionId, int userId, const std::string& username) {
-            std::string query = "INSERT INTO sessions (session_id, user_id, username, expire_time) VALUES ('" +
-                              escapeString(sessionId) + "', " +
-                              std::to_string(userId) + ", '" +
-                              escapeString(username) + "', " +
-                              "DATE_ADD(NOW(), INTERVAL 30 MINUTE))";
-            
-            executeQuery(query);
+            db().execute("INSERT INTO sessions (session_id, user_id, username, expire_time) "
+                         "VALUES (?, ?, ?, DATE_ADD(NOW(), INTERVAL 30 MINUTE))",
+                         {sessionId, userId, username});
+            sessionCache_.put(sessionId, userId, username);
         }
         
-        // 验证会话
-        bool validateSession(const std::string& sessionId, int& userId, std::string& username) {
+        // 验证会话，cacheOnly为true时不查询数据库（IO线程中使用）
+        bool validateSession(const std::string& sessionId, int& userId, std::string& username,
+                             bool cacheOnly = false) {
             if (sessionId.empty()) {
                 LOG_WARN << "sessionId is empty";
                 return false;
             }
             
-            std::string query = "SELECT user_id, username FROM sessions WHERE session_id = '" +
-                              escapeString(sessionId) + "' AND expire_time > NOW()";
-            
-            MYSQL_RES* result = executeQueryWithResult(query);
-            
-            if (!result || mysql_num_rows(result) == 0) {
-                if (result) {
-                    mysql_free_result(result);
-                }
-                LOG_WARN << "mysql_num_rows is invalid";
+            // 命中缓存时只在内存中顺延过期时间，由flushSessions批量写回
+            if (sessionCache_.touch(sessionId, &userId, &username)) {
+                return true;
+            }
+            if (cacheOnly) {
+                LOG_WARN << "session not in cache";
                 return false;
             }
-            
-            MYSQL_ROW row = mysql_fetch_row(result);
-            userId = std::stoi(row[0]);
-            username = row[1];
-            mysql_free_result(result);
-            
-            // 更新会话过期时间
-            std::string updateQuery = "UPDATE sessions SET expire_time = DATE_ADD(NOW(), INTERVAL 30 MINUTE) WHERE session_id = '" +
-                                    escapeString(sessionId) + "'";
-            executeQuery(updateQuery);
-            LOG_INFO << "validateSession success";
-            return true;
+
+            // 未命中（例如服务重启后），从数据库加载
+            DbResult result;
+            if (!db().execute("SELECT user_id, username FROM sessions "
+                              "WHERE session_id = ? AND expire_time > NOW()",
+                              {sessionId}, &result) || result.empty()) {
+                LOG_WARN << "session not found or expired";
+                return false;
+            }
+
+            const DbRow& row = result[0];
+            sessionCache_.put(sessionId, std::stoi(row[0]), row[1] ? row[1] : "");
+            LOG_INFO << "validateSession loaded from database";
+            return sessionCache_.touch(sessionId, &userId, &username);
         }
         
         // 结束会话
@@ -1470,24 +2388,55 @@ private:
                 return;
             }
             
-            std::string query = "DELETE FROM sessions WHERE session_id = '" +
-                              escapeString(sessionId) + "'";
-            
-            executeQuery(query);
+            sessionCache_.remove(sessionId);
+            db().execute("DELETE FROM sessions WHERE session_id = ?", {sessionId});
         }
         
+        // 清理长时间没有活动的分块上传会话和过期的暂存分块
+        void sweepUploads() {
+            size_t evicted = uploadSessions_.evictIdle(kUploadSessionIdle);
+            if (evicted > 0) {
+                LOG_INFO << "Evicted " << evicted << " idle upload sessions";
+            }
+            size_t expired = blobStore_.chunks().expireStaged();
+            if (expired > 0) {
+                LOG_INFO << "Released " << expired << " staged chunks";
+            }
+        }
+
+        // 把最近被访问过的会话的过期时间写回数据库
+        // 每批固定kSessionFlushBatch个参数，不足的用最后一个id补齐，这样只需要一条预处理语句
+        void flushSessions() {
+            std::vector<std::string> dirty = sessionCache_.takeDirty();
+            size_t evicted = sessionCache_.evictExpired();
+            if (dirty.empty()) {
+                return;
+            }
+
+            static const std::string sql = [] {
+                std::string s = "UPDATE sessions SET expire_time = DATE_ADD(NOW(), INTERVAL 30 MINUTE) "
+                                "WHERE session_id IN (?";
+                for (size_t i = 1; i < kSessionFlushBatch; ++i) {
+                    s += ",?";
+                }
+                return s + ")";
+            }();
+
+            for (size_t begin = 0; begin < dirty.size(); begin += kSessionFlushBatch) {
+                size_t end = std::min(begin + kSessionFlushBatch, dirty.size());
+                std::vector<DbParam> params(dirty.begin() + static_cast<std::ptrdiff_t>(begin),
+                                            dirty.begin() + static_cast<std::ptrdiff_t>(end));
+                params.resize(kSessionFlushBatch, params.back());
+                if (!db().execute(sql, params)) {
+                    LOG_ERROR << "写回会话过期时间失败";
+                }
+            }
+            LOG_INFO << "flushSessions: " << dirty.size() << " refreshed, " << evicted << " evicted";
+        }
+
         // 转义SQL字符串
         std::string escapeString(const std::string& str) {
-            if (!mysql) {
-                return str;
-            }
-            
-            char* escaped = new char[str.length() * 2 + 1];
-            mysql_real_escape_string(mysql, escaped, str.c_str(), str.length());
-            std::string result(escaped);
-            delete[] escaped;
-            
-            return result;
+            return db().escape(str);
         }
 
     // 获取文件类型
@@ -1519,54 +2468,90 @@ private:
         return "unknown";
     }
 
-    void initRoutes() {
-        // 不需要会话验证的路由
-        addRoute("/favicon.ico", HttpRequest::kGet, &HttpUploadHandler::handleFavicon);
-        addRoute("/register", HttpRequest::kPost, &HttpUploadHandler::handleRegister);
-        addRoute("/login", HttpRequest::kPost, &HttpUploadHandler::handleLogin);
-        addRoute("/", HttpRequest::kGet, &HttpUploadHandler::handleIndex);
-        addRoute("/index.html", HttpRequest::kGet, &HttpUploadHandler::handleIndex);
-        addRoute("/register.html", HttpRequest::kGet, &HttpUploadHandler::handleIndex);
-        addRoute("/share/([^/]+)", HttpRequest::kGet, &HttpUploadHandler::handleShareAccess, {"code"});
-        addRoute("/share/download/([^/]+)", HttpRequest::kGet, &HttpUploadHandler::handleShareDownload, {"filename"});
-        addRoute("/share/info/([^/]+)", HttpRequest::kGet, &HttpUploadHandler::handleShareInfo, {"code"});
-        
-        // 需要会话验证的路由
-        addRoute("/upload", HttpRequest::kPost, &HttpUploadHandler::handleFileUpload);
-        addRoute("/files", HttpRequest::kGet, &HttpUploadHandler::handleListFiles);
-        addRoute("/download/([^/]+)", HttpRequest::kHead, &HttpUploadHandler::handleDownload, {"filename"});
+    void addRoute(HttpServer& server, HttpRequest::Method method,
+                  const std::string& pattern, RequestHandler handler) {
+        server.addRoute(method, pattern,
+            [this, handler](const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+                return dispatch(handler, conn, req, resp);
+            });
+    }
 
-        addRoute("/download/([^/]+)", HttpRequest::kGet, &HttpUploadHandler::handleDownload, {"filename"});
-        addRoute("/delete/([^/]+)", HttpRequest::kDelete, &HttpUploadHandler::handleDelete, {"filename"});
-        addRoute("/share", HttpRequest::kPost, &HttpUploadHandler::handleShareFile);
-        addRoute("/users/search", HttpRequest::kGet, &HttpUploadHandler::handleSearchUsers);
-        addRoute("/logout", HttpRequest::kPost, &HttpUploadHandler::handleLogout);
+    // 注册异步路由：处理函数在threadPool_的工作线程中执行，慢查询不会阻塞IO线程。
+    // 这些处理函数不能在工作线程中操作conn，只能填写resp
+    void addAsyncRoute(HttpServer& server, HttpRequest::Method method,
+                       const std::string& pattern, RequestHandler handler) {
+        server.addRoute(method, pattern,
+            [this, handler](const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+                runAsync(conn, req, resp, [this, handler, conn](HttpRequest& request, HttpResponse* response) {
+                    dispatch(handler, conn, request, response);
+                });
+                return false;
+            });
     }
 
-    // 添加精确匹配的路由
-    void addRoute(const std::string& path, HttpRequest::Method method, RequestHandler handler) {
-        std::string pattern = "^" + escapeRegex(path) + "$";
-        routes_.emplace_back(pattern, std::vector<std::string>(), handler, method);
+    // 在threadPool_中执行work，完成后由HttpServer::sendResponse回到连接所属的loop发送响应，
+    // 调用者返回false表示异步处理。work抛出的异常转换为500响应
+    void runAsync(const TcpConnectionPtr& conn, const HttpRequest& req, const HttpResponse* resp,
+                  const std::function<void (HttpRequest&, HttpResponse*)>& work) {
+        threadPool_.run(asyncTask(conn, req, resp, work));
     }
 
-    // 添加带参数的路由
-    void addRoute(const std::string& pattern, HttpRequest::Method method, 
-                 RequestHandler handler, const std::vector<std::string>& paramNames) {
-        routes_.emplace_back(pattern, paramNames, handler, method);
+    // 生成runAsync在工作线程中执行的任务，用于由其他方式（例如上传的写入队列）调度的异步请求
+    std::function<void ()> asyncTask(const TcpConnectionPtr& conn, const HttpRequest& req, const HttpResponse* resp,
+                                     const std::function<void (HttpRequest&, HttpResponse*)>& work) {
+        // 连接断开时HttpContext会被销毁，工作线程使用请求的副本
+        auto request = std::make_shared<HttpRequest>(req);
+        auto response = std::make_shared<HttpResponse>(resp->closeConnection());
+        return [this, work, conn, request, response]() {
+            try {
+                work(*request, response.get());
+            }
+            catch (const std::exception& e) {
+                LOG_ERROR << "Error processing request: " << e.what();
+                sendError(response.get(), "Internal Server Error", HttpResponse::k500InternalServerError);
+            }
+            // 在工作线程中压缩，不占用IO线程；已经压缩的响应HttpServer不再处理
+            response->encodeBody(request->getHeader("Accept-Encoding"), kCompressionMinSize);
+            server_->sendResponse(conn, response);
+        };
     }
 
-    // 转义正则表达式特殊字符
-    std::string escapeRegex(const std::string& str) {
-        std::string result;
-        for (char c : str) {
-            if (c == '.' || c == '+' || c == '*' || c == '?' || c == '^' || 
-                c == '$' || c == '(' || c == ')' || c == '[' || c == ']' || 
-                c == '{' || c == '}' || c == '|' || c == '\\') {
-                result += '\\';
+    // 把请求体交给写入队列：writer在threadPool_中按顺序执行，队列满时暂停读取，赶上后恢复
+    std::shared_ptr<BodyWriteQueue> startBodyQueue(const TcpConnectionPtr& conn, HttpContext* httpContext,
+                                                   const BodyWriteQueue::Writer& writer) {
+        auto writeQueue = std::make_shared<BodyWriteQueue>(
+            writer, [this](BodyWriteQueue::Task task) { threadPool_.run(std::move(task)); },
+            kUploadQueueBytes);
+        std::weak_ptr<TcpConnection> weakConn(conn);
+        writeQueue->setResumeCallback([this, weakConn]() {
+            if (TcpConnectionPtr c = weakConn.lock()) {
+                server_->resumeBody(c);
+            }
+        });
+        httpContext->setBodyCallback([writeQueue, httpContext](const char* data, size_t len) {
+            if (!writeQueue->push(data, len)) {
+                return false;
+            }
+            if (writeQueue->full()) {
+                httpContext->setBodyPaused(true);
             }
-            result += c;
+            return true;
+        });
+        return writeQueue;
+    }
+
+    // 调用处理函数，统一把异常转换为500响应
+    bool dispatch(RequestHandler handler, const TcpConnectionPtr& conn,
+                  HttpRequest& req, HttpResponse* resp) {
+        LOG_DEBUG << "Request " << req.methodString() << " " << req.path();
+        try {
+            return (this->*handler)(conn, req, resp);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR << "Error processing request: " << e.what();
+            sendError(resp, "Internal Server Error", HttpResponse::k500InternalServerError);
+            return true;
         }
-        return result;
     }
 
     // SHA256 哈希算法简单实现
@@ -1595,13 +2580,8 @@ private:
         resp->setStatusCode(HttpResponse::k200Ok);
         resp->setStatusMessage("OK");
         resp->setContentType("application/json");
-        resp->addHeader("Connection", "close");
         resp->setBody(response.dump());
 
-        conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-            connection->shutdown();
-            return true;
-        });
         return true;
     }
 
@@ -1613,7 +2593,7 @@ private:
         std::string username;
         
         if (!validateSession(sessionId, userId, username)) {
-            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized, conn);
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
             LOG_WARN << "validateSession failed";
             return true;
         }
@@ -1631,43 +2611,30 @@ private:
         if (query.find("keyword=") == 0) {
             keyword = urlDecode(query.substr(8));
         } else {
-            sendError(resp, "搜索关键词不能为空", HttpResponse::k400BadRequest, conn);
+            sendError(resp, "搜索关键词不能为空", HttpResponse::k400BadRequest);
             LOG_WARN << "keyword is empty";
             return true;
         }
         
         if (keyword.empty()) {
-            sendError(resp, "搜索关键词不能为空", HttpResponse::k400BadRequest, conn);
+            sendError(resp, "搜索关键词不能为空", HttpResponse::k400BadRequest);
             LOG_WARN << "keyword is empty";
             return true;
         }
         
-        std::string sqlQuery = "SELECT id, username, email FROM users WHERE username LIKE '%" + 
-                            escapeString(keyword) + "%' AND id != " + std::to_string(userId) + 
-                            " LIMIT 10";
-        LOG_INFO << "sqlQuery = " << sqlQuery;
-        MYSQL_RES* result = executeQueryWithResult(sqlQuery);
-        
+        // 多取一个，去掉自己之后仍有kUserSearchLimit个
+        size_t total;
+        std::vector<SearchIndex::Hit> hits =
+            userIndex_.search(kUserScope, keyword, 0, kUserSearchLimit + 1, &total);
+
         json response;
         response["code"] = 0;
         response["message"] = "Success";
         json users = json::array();
-        
-        if (result) {
-            MYSQL_ROW row;
-            while ((row = mysql_fetch_row(result))) {
-                int id = std::stoi(row[0]);
-                std::string usernameFromDb = row[1] ? row[1] : "";
-                std::string email = row[2] ? row[2] : "";
-                
-                users.push_back({
-                    {"id", id},
-                    {"username", usernameFromDb},
-                    {"email", email}
-                });
+        for (const SearchIndex::Hit& hit : hits) {
+            if (hit.id != userId && users.size() < kUserSearchLimit) {
+                users.push_back(json::parse(hit.payload));
             }
-            
-            mysql_free_result(result);
         }
         
         response["users"] = users;
@@ -1675,13 +2642,8 @@ private:
         resp->setStatusCode(HttpResponse::k200Ok);
         resp->setStatusMessage("OK");
         resp->setContentType("application/json");
-        resp->addHeader("Connection", "close");
         resp->setBody(response.dump());
         LOG_INFO << "response = " << response.dump();
-        conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-            connection->shutdown();
-            return true;
-        });
         
         return true;
     }
@@ -1728,7 +2690,7 @@ private:
         std::string usernameFromSession;
         
         if (!validateSession(sessionId, userId, usernameFromSession)) {
-            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized, conn);
+            sendError(resp, "未登录或会话已过期", HttpResponse::k401Unauthorized);
             return true;
         }
         
@@ -1744,7 +2706,7 @@ private:
             
             if (!fileResult || mysql_num_rows(fileResult) == 0) {
                 if (fileResult) mysql_free_result(fileResult);
-                sendError(resp, "您没有权限分享此文件", HttpResponse::k403Forbidden, conn);
+                sendError(resp, "您没有权限分享此文件", HttpResponse::k403Forbidden);
                 return true;
             }
             
@@ -1752,8 +2714,12 @@ private:
             
             // 如果是私有文件，删除所有分享记录
             if (shareType == "private") {
-                std::string deleteQuery = "DELETE FROM file_shares WHERE file_id = " + std::to_string(fileId);
-                executeQuery(deleteQuery);
+                if (db().execute("DELETE FROM file_shares WHERE file_id = ?", {fileId}) &&
+                    db().affectedRows() > 0) {
+                    fileListCache_.invalidateUser(userId);
+                    fileListCache_.invalidateShared();
+                }
+                shareCache_.removeFile(fileId);
                 
                 json response = {
                     {"code", 0},
@@ -1763,14 +2729,8 @@ private:
                 resp->setStatusCode(HttpResponse::k200Ok);
                 resp->setStatusMessage("OK");
                 resp->setContentType("application/json");
-                resp->addHeader("Connection", "close");
                 resp->setBody(response.dump());
-                
-                conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-                    connection->shutdown();
-                    return true;
-                });
-                
+
                 return true;
             }
             
@@ -1800,7 +2760,7 @@ private:
                 MYSQL_RES* checkResult = executeQueryWithResult(checkQuery);
                 if (checkResult && mysql_num_rows(checkResult) > 0) {
                     if (checkResult) mysql_free_result(checkResult);
-                    sendError(resp, "已经分享给该用户", HttpResponse::k400BadRequest, conn);
+                    sendError(resp, "已经分享给该用户", HttpResponse::k400BadRequest);
                     return true;
                 }
                 if (checkResult) mysql_free_result(checkResult);
@@ -1820,12 +2780,21 @@ private:
                                     expireStr + ")";
             
             if (!executeQuery(insertQuery)) {
-                sendError(resp, "创建分享失败", HttpResponse::k500InternalServerError, conn);
+                sendError(resp, "创建分享失败", HttpResponse::k500InternalServerError);
                 return true;
             }
             
             // 获取新创建的分享记录ID
-            int shareId = static_cast<int>(mysql_insert_id(mysql));
+            int shareId = static_cast<int>(db().lastInsertId());
+            shareCache_.remove(shareCode);
+
+            // 分享信息显示在所有者的列表中；指定用户分享只影响该用户的分享列表，公开分享影响所有用户
+            fileListCache_.invalidateUser(userId);
+            if (shareType == "user" && sharedWithId != "NULL") {
+                fileListCache_.invalidateUser(std::stoi(sharedWithId));
+            } else if (shareType == "public") {
+                fileListCache_.invalidateShared();
+            }
             
             json response = {
                 {"code", 0},
@@ -1845,37 +2814,86 @@ private:
             resp->setStatusCode(HttpResponse::k200Ok);
             resp->setStatusMessage("OK");
             resp->setContentType("application/json");
-            resp->addHeader("Connection", "close");
             resp->setBody(response.dump());
-            
-            conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-                connection->shutdown();
-                return true;
-            });
-            
+
             return true;
         }
         catch (const std::exception& e) {
             LOG_ERROR << "分享文件错误: " << e.what();
-            sendError(resp, "分享失败: " + std::string(e.what()), HttpResponse::k500InternalServerError, conn);
+            sendError(resp, "分享失败: " + std::string(e.what()), HttpResponse::k500InternalServerError);
             return true;
         }
     }
 
     // 通过分享码访问文件
+    // 按分享码查找未过期的分享，先查缓存；不存在、已过期或查询失败时返回空指针
+    std::shared_ptr<const ShareRecord> findShare(const std::string& shareCode) {
+        // 分享码由generateShareCode生成，格式不对的一定不存在
+        if (shareCode.size() != 32 ||
+            !std::all_of(shareCode.begin(), shareCode.end(), [](char c) {
+                return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+            })) {
+            return nullptr;
+        }
+
+        std::shared_ptr<const ShareRecord> share;
+        if (shareCache_.get(shareCode, &share)) {
+            return share;
+        }
+        uint64_t cacheVersion = shareCache_.version();
+        DbResult result;
+        if (!db().execute("SELECT fs.id, fs.file_id, f.user_id, fs.shared_with_id, fs.share_type, "
+                          "fs.extract_code, fs.created_at, fs.expire_time, "
+                          "TIMESTAMPDIFF(SECOND, NOW(), fs.expire_time), "
+                          "f.filename, f.original_filename, f.file_size, f.file_type, f.content_hash, u.username "
+                          "FROM file_shares fs "
+                          "JOIN files f ON fs.file_id = f.id "
+                          "JOIN users u ON f.user_id = u.id "
+                          "WHERE fs.share_code = ? LIMIT 1",
+                          {shareCode}, &result)) {
+            // 查询失败不缓存
+            return nullptr;
+        }
+
+        double remaining = -1;  // 剩余有效期（秒），-1表示永不过期
+        if (!result.empty()) {
+            const DbRow& row = result[0];
+            if (row[8]) {
+                remaining = std::max(0.0, std::stod(row[8]));
+            }
+            if (!row[7] || remaining > 0) {
+                auto record = std::make_shared<ShareRecord>();
+                record->shareId = std::stoi(row[0]);
+                record->fileId = std::stoi(row[1]);
+                record->ownerId = std::stoi(row[2]);
+                record->sharedWithId = row[3] ? std::stoi(row[3]) : 0;
+                record->shareType = row[4];
+                record->shareCode = shareCode;
+                record->extractCode = row[5] ? row[5] : "";
+                record->createdAt = row[6] ? row[6] : "";
+                record->expireTime = row[7] ? row[7] : "";
+                record->filename = row[9];
+                record->originalFilename = row[10];
+                record->fileSize = std::stoull(row[11]);
+                record->fileType = row[12] ? row[12] : "";
+                record->contentHash = row[13] ? row[13] : "";
+                record->ownerUsername = row[14];
+                share = record;
+            }
+        }
+        // 已过期的分享和不存在的一样作为负缓存
+        shareCache_.put(shareCode, share, remaining, cacheVersion);
+        return share;
+    }
+
     bool handleShareAccess(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
-        std::string path = req.path();
-        std::smatch matches;
-        std::regex codeRegex("/share/([^/]+)");
-        LOG_INFO << "path = " << path;
-        
-        if (!std::regex_search(path, matches, codeRegex) || matches.size() < 2) {
-            sendError(resp, "无效的分享链接", HttpResponse::k400BadRequest, conn);
+        std::string shareCode = req.getPathParam("code");
+        if (shareCode.empty()) {
+            sendError(resp, "无效的分享链接", HttpResponse::k400BadRequest);
             LOG_WARN << "invalid share link";
             return true;
         }
 
-        std::string shareCode = matches[1];
         std::string acceptHeader = req.getHeader("Accept");
         
         // 检查用户是否已登录
@@ -1891,7 +2909,7 @@ private:
             
             // 检查分享码格式
             if (shareCode.empty() || shareCode.length() != 32) {
-                sendError(resp, "无效的分享码格式", HttpResponse::k400BadRequest, conn);
+                sendError(resp, "无效的分享码格式", HttpResponse::k400BadRequest);
                 return true;
             }
             
@@ -1899,37 +2917,24 @@ private:
             if (!std::all_of(shareCode.begin(), shareCode.end(), [](char c) {
                 return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
             })) {
-                sendError(resp, "分享码包含非法字符", HttpResponse::k400BadRequest, conn);
+                sendError(resp, "分享码包含非法字符", HttpResponse::k400BadRequest);
                 return true;
             }
 
             // 获取提取码(如果有)
             std::string extractCode = req.getQuery("code", "");
             
-            // 构建查询语句
-            std::string query = "SELECT fs.*, f.filename, f.original_filename, f.file_size, "
-                              "f.file_type, u.username as owner_username, f.user_id "
-                              "FROM file_shares fs "
-                              "JOIN files f ON fs.file_id = f.id "
-                              "JOIN users u ON f.user_id = u.id "
-                              "WHERE fs.share_code = '" + escapeString(shareCode) + "' "
-                              "AND (fs.expire_time IS NULL OR fs.expire_time > NOW()) "
-                              "AND (fs.share_type != 'protected' OR (fs.share_type = 'protected' AND fs.extract_code = '" + escapeString(extractCode) + "'))";
-            
-            LOG_INFO << "query = " << query;
-            MYSQL_RES* result = executeQueryWithResult(query);
-            
-            if (!result || mysql_num_rows(result) == 0) {
-                if (result) mysql_free_result(result);
-                sendError(resp, "分享链接已失效或不存在", HttpResponse::k404NotFound, conn);
+            // 查询分享信息
+            std::shared_ptr<const ShareRecord> share = findShare(shareCode);
+            if (!share) {
+                sendError(resp, "分享链接已失效或不存在", HttpResponse::k404NotFound);
                 return true;
             }
 
-            MYSQL_ROW row = mysql_fetch_row(result);
-            std::string shareType = row[4];  // fs.share_type
-            bool isOwner = (row[13] && std::stoi(row[13]) == userId);  // f.user_id == current_user_id
-            int sharedWithId = row[3] ? std::stoi(row[3]) : 0;  // fs.shared_with_id
-            std::string dbExtractCode = row[5] ? row[5] : "";  // fs.extract_code
+            const std::string& shareType = share->shareType;
+            bool isOwner = isAuthenticated && share->ownerId == userId;
+            int sharedWithId = share->sharedWithId;
+            const std::string& dbExtractCode = share->extractCode;
             
             // 检查访问权限
             bool hasPermission = false;
@@ -1953,11 +2958,10 @@ private:
             }
             
             if (!hasPermission) {
-                mysql_free_result(result);
                 if (shareType == "protected" && (extractCode.empty() || extractCode != dbExtractCode)) {
-                    sendError(resp, "需要正确的提取码", HttpResponse::k403Forbidden, conn);
+                    sendError(resp, "需要正确的提取码", HttpResponse::k403Forbidden);
                 } else {
-                    sendError(resp, "您没有权限访问此文件", HttpResponse::k403Forbidden, conn);
+                    sendError(resp, "您没有权限访问此文件", HttpResponse::k403Forbidden);
                 }
                 return true;
             }
@@ -1966,26 +2970,24 @@ private:
                 {"code", 0},
                 {"message", "success"},
                 {"file", {
-                    {"id", std::stoi(row[0])},              // fs.id
-                    {"fileId", std::stoi(row[1])},          // fs.file_id
-                    {"ownerId", std::stoi(row[2])},         // fs.owner_id
-                    {"sharedWithId", row[3] ? std::stoi(row[3]) : 0}, // fs.shared_with_id
-                    {"shareType", shareType},               // fs.share_type
-                    {"shareCode", shareCode},               // fs.share_code
-                    {"createdAt", row[6] ? row[6] : ""},   // fs.created_at
-                    {"expireTime", row[7] ? row[7] : ""},   // fs.expire_time
-                    {"filename", row[8] ? row[8] : ""},     // f.filename
-                    {"originalName", row[9] ? row[9] : ""}, // f.original_filename
-                    {"size", row[10] ? std::stoull(row[10]) : 0}, // f.file_size
-                    {"type", row[11] ? row[11] : "unknown"}, // f.file_type
-                    {"ownerUsername", row[12] ? row[12] : ""}, // u.username
+                    {"id", share->shareId},
+                    {"fileId", share->fileId},
+                    {"ownerId", share->ownerId},
+                    {"sharedWithId", share->sharedWithId},
+                    {"shareType", shareType},
+                    {"shareCode", shareCode},
+                    {"createdAt", share->createdAt},
+                    {"expireTime", share->expireTime},
+                    {"filename", share->filename},
+                    {"originalName", share->originalFilename},
+                    {"size", share->fileSize},
+                    {"type", share->fileType.empty() ? "unknown" : share->fileType},
+                    {"ownerUsername", share->ownerUsername},
                     {"isOwner", isOwner}
                 }},
-                {"downloadUrl", "/share/download/" + std::string(row[8] ? row[8] : "") + "?code=" + shareCode}
+                {"downloadUrl", "/share/download/" + share->filename + "?code=" + shareCode}
             };
 
-            mysql_free_result(result);
-
             resp->setStatusCode(HttpResponse::k200Ok);
             resp->setStatusMessage("OK");
             resp->setContentType("application/json");
@@ -1999,12 +3001,6 @@ private:
             return result;
         }
 
-        resp->addHeader("Connection", "close");
-        conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-            connection->shutdown();
-            return true;
-        });
-        
         return true;
     }
 
@@ -2012,7 +3008,7 @@ private:
     bool handleShareDownload(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
         std::string filename = req.getPathParam("filename");
         if (filename.empty()) {
-            sendError(resp, "Missing filename", HttpResponse::k400BadRequest, conn);
+            sendError(resp, "Missing filename", HttpResponse::k400BadRequest);
             return true;
         }
         
@@ -2021,7 +3017,7 @@ private:
         std::string extractCode = req.getQuery("extract_code", "");
         LOG_INFO << "shareCode = " << shareCode << ", extractCode = " << extractCode;
         if (shareCode.empty()) {
-            sendError(resp, "Missing share code", HttpResponse::k400BadRequest, conn);
+            sendError(resp, "Missing share code", HttpResponse::k400BadRequest);
             return true;
         }
         
@@ -2032,36 +3028,17 @@ private:
         bool isAuthenticated = validateSession(sessionId, userId, usernameFromSession);
         
         // 查询分享信息
-        std::string query = "SELECT f.id, f.filename, f.original_filename, f.user_id, "
-                          "fs.share_type, fs.shared_with_id, fs.extract_code, "
-                          "fs.created_at, fs.expire_time "
-                          "FROM files f "
-                          "JOIN file_shares fs ON f.id = fs.file_id "
-                          "WHERE f.filename = '" + escapeString(filename) + "' "
-                          "AND fs.share_code = '" + escapeString(shareCode) + "' "
-                          "AND (fs.expire_time IS NULL OR fs.expire_time > NOW())";
-        
-        LOG_INFO << "查询分享信息: " << query;
-        MYSQL_RES* result = executeQueryWithResult(query);
-        
-        if (!result || mysql_num_rows(result) == 0) {
-            if (result) mysql_free_result(result);
+        std::shared_ptr<const ShareRecord> share = findShare(shareCode);
+        if (!share || share->filename != filename) {
             LOG_ERROR << "分享不存在或已过期";
-            sendError(resp, "Share not found or expired", HttpResponse::k404NotFound, conn);
+            sendError(resp, "Share not found or expired", HttpResponse::k404NotFound);
             return true;
         }
-        
-        MYSQL_ROW row = mysql_fetch_row(result);
-        // int fileId = std::stoi(row[0]);
-        std::string serverFilename = row[1];
-        std::string originalFilename = row[2];
-        int fileOwnerId = std::stoi(row[3]);
-        std::string shareType = row[4];
-        int sharedWithId = row[5] ? std::stoi(row[5]) : 0;
-        std::string dbExtractCode = row[6] ? row[6] : "";
-        std::string createdAt = row[7] ? row[7] : "";
-        std::string expireTime = row[8] ? row[8] : "";
-        mysql_free_result(result);
+
+        const std::string& shareType = share->shareType;
+        int fileOwnerId = share->ownerId;
+        int sharedWithId = share->sharedWithId;
+        const std::string& dbExtractCode = share->extractCode;
         
         // 检查访问权限
         bool hasPermission = false;
@@ -2086,139 +3063,23 @@ private:
         
         if (!hasPermission) {
             if (shareType == "protected" && (extractCode.empty() || extractCode != dbExtractCode)) {
-                sendError(resp, "需要正确的提取码", HttpResponse::k403Forbidden, conn);
+                sendError(resp, "需要正确的提取码", HttpResponse::k403Forbidden);
             } else {
-                sendError(resp, "您没有权限访问此文件", HttpResponse::k403Forbidden, conn);
+                sendError(resp, "您没有权限访问此文件", HttpResponse::k403Forbidden);
             }
             return true;
         }
         
         // 开始下载文件
-        std::string filepath = uploadDir_ + "/" + serverFilename;
-        
-        try {
-            if (!fs::exists(filepath) || !fs::is_regular_file(filepath)) {
-                sendError(resp, "File not found", HttpResponse::k404NotFound, conn);
-                return true;
-            }
-            
-            // 获取文件大小
-            uintmax_t fileSize = fs::file_size(filepath);
-            
-            // 如果是 HEAD 请求，只返回文件信息
-            if (req.method() == HttpRequest::kHead) {
-                resp->setStatusCode(HttpResponse::k200Ok);
-                resp->setStatusMessage("OK");
-                resp->setContentType("application/octet-stream");
-                resp->addHeader("Content-Length", std::to_string(fileSize));
-                resp->addHeader("Accept-Ranges", "bytes");
-                resp->addHeader("Connection", "close");
-                conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-                    connection->shutdown();
-                    return true;
-                });
-                return true;
-            }
-            
-            // 解析Range头部
-            std::string rangeHeader = req.getHeader("Range");
-            uintmax_t startPos = 0;
-            uintmax_t endPos = fileSize - 1;
-            bool isRangeRequest = false;
-            
-            if (!rangeHeader.empty()) {
-                // 解析Range头部，格式为 "bytes=start-end"
-                std::regex rangeRegex("bytes=(\\d+)-(\\d*)");
-                std::smatch matches;
-                if (std::regex_search(rangeHeader, matches, rangeRegex)) {
-                    startPos = std::stoull(matches[1]);
-                    if (!matches[2].str().empty()) {
-                        endPos = std::stoull(matches[2]);
-                    }
-                    isRangeRequest = true;
-                    
-                    // 验证范围
-                    if (startPos >= fileSize) {
-                        sendError(resp, "Range Not Satisfiable", HttpResponse::k416RangeNotSatisfiable, conn);
-                        return true;
-                    }
-                    
-                    // 如果endPos未指定或超出文件大小，则使用文件大小-1
-                    if (endPos >= fileSize) {
-                        endPos = fileSize - 1;
-                    }
-                }
-            }
-            
-            // 获取 HttpContext
-            auto httpContext = std::static_pointer_cast<HttpContext>(conn->getContext());
-            if (!httpContext) {
-                LOG_ERROR << "HttpContext is null";
-                sendError(resp, "Internal Server Error", HttpResponse::k500InternalServerError, conn);
-                return true;
-            }
-            
-            // 尝试获取已存在的下载上下文
-            std::shared_ptr<FileDownContext> downContext = httpContext->getContext<FileDownContext>();
-            
-            if (!downContext) {
-                // 创建新的下载上下文
-                downContext = std::make_shared<FileDownContext>(filepath, originalFilename);
-                httpContext->setContext(downContext);
-                
-                // 设置初始响应头
-                if (isRangeRequest) {
-                    resp->setStatusCode(HttpResponse::k206PartialContent);
-                    resp->setStatusMessage("Partial Content");
-                    resp->addHeader("Content-Range", 
-                                  "bytes " + std::to_string(startPos) + "-" + 
-                                  std::to_string(endPos) + "/" + 
-                                  std::to_string(fileSize));
-                } else {
-                    resp->setStatusCode(HttpResponse::k200Ok);
-                    resp->setStatusMessage("OK");
-                }
-                
-                resp->setContentType("application/octet-stream");
-                resp->addHeader("Content-Disposition", 
-                              "attachment; filename=\"" + originalFilename + "\"");
-                resp->addHeader("Accept-Ranges", "bytes");
-                resp->addHeader("Connection", "keep-alive");
-                
-                // 设置文件指针到起始位置
-                downContext->seekTo(startPos);
-            }
-            
-            // 设置写完成回调，继续发送下一个数据块
-            conn->setWriteCompleteCallback([this, downContext](const TcpConnectionPtr& connection) {
-                // 读取下一个数据块
-                std::string chunk;
-                if (downContext->readNextChunk(chunk)) {
-                    // 直接发送数据块
-                    connection->send(chunk);
-                    return true;
-                } else {
-                    // 下载完成，关闭连接
-                    LOG_INFO << "Download complete, closing connection";
-                    connection->shutdown();
-                    return true;
-                }
-            });
-            
-            return true;
-        }
-        catch (const std::exception& e) {
-            LOG_ERROR << "Error during file download: " << e.what();
-            sendError(resp, "Download failed", HttpResponse::k500InternalServerError, conn);
-            return true;
-        }
+        return serveFile(conn, req, resp,
+                         openStoredFile(share->filename, share->contentHash, share->originalFilename));
     }
 
     // 获取分享信息
     bool handleShareInfo(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
         std::string shareCode = req.getPathParam("code");
         if (shareCode.empty()) {
-            sendError(resp, "Missing share code", HttpResponse::k400BadRequest, conn);
+            sendError(resp, "Missing share code", HttpResponse::k400BadRequest);
             return true;
         }
 
@@ -2227,106 +3088,60 @@ private:
         LOG_INFO << "shareCode = " << shareCode << ", extractCode = " << extractCode;
 
         // 查询分享信息
-        std::string query = "SELECT fs.*, f.filename, f.original_filename, f.file_size, "
-                          "f.file_type, u.username as owner_username, f.user_id "
-                          "FROM file_shares fs "
-                          "JOIN files f ON fs.file_id = f.id "
-                          "JOIN users u ON f.user_id = u.id "
-                          "WHERE fs.share_code = '" + escapeString(shareCode) + "' "
-                          "AND (fs.expire_time IS NULL OR fs.expire_time > NOW())";
-        
-        LOG_INFO << "查询分享信息: " << query;
-        MYSQL_RES* result = executeQueryWithResult(query);
-        
-        if (!result || mysql_num_rows(result) == 0) {
-            if (result) mysql_free_result(result);
+        std::shared_ptr<const ShareRecord> share = findShare(shareCode);
+        if (!share) {
             LOG_ERROR << "分享链接已失效或不存在, shareCode = " << shareCode;
-            sendError(resp, "分享链接已失效或不存在", HttpResponse::k404NotFound, conn);
+            sendError(resp, "分享链接已失效或不存在", HttpResponse::k404NotFound);
             return true;
         }
 
-        MYSQL_ROW row = mysql_fetch_row(result);
-        std::string shareType = row[4];  // fs.share_type
-        std::string dbExtractCode = row[8] ? row[8] : "";  // fs.extract_code
-        std::string serverFilename = row[9] ? row[9] : "";
-        std::string originalFilename = row[10] ? row[10] : "";
-        uintmax_t fileSize = row[11] ? std::stoull(row[11]) : 0;
-        std::string createdAt = row[7] ? row[7] : "";
-        std::string expireTime = row[6] ? row[6] : "";
+        const std::string& shareType = share->shareType;
+        const std::string& dbExtractCode = share->extractCode;
         
         // 如果是受保护的文件，需要验证提取码
         if (shareType == "protected") {
             if (extractCode.empty() || extractCode != dbExtractCode) {
-                mysql_free_result(result);
                 LOG_ERROR << "提取码错误或未提供, shareCode = " << shareCode;
-                sendError(resp, "需要正确的提取码", HttpResponse::k403Forbidden, conn);
+                sendError(resp, "需要正确的提取码", HttpResponse::k403Forbidden);
                 return true;
             }
         }
-        
-        mysql_free_result(result);
 
         json response = {
             {"code", 0},
             {"message", "success"},
             {"shareType", shareType},
             {"file", {
-                {"id", std::stoi(row[0])},
-                {"name", serverFilename},
-                {"originalName", originalFilename},
-                {"size", fileSize},
-                {"type", row[11] ? row[11] : "unknown"},
-                {"shareTime", createdAt},
-                {"expireTime", expireTime}
+                {"id", share->shareId},
+                {"name", share->filename},
+                {"originalName", share->originalFilename},
+                {"size", share->fileSize},
+                {"type", share->fileType.empty() ? "unknown" : share->fileType},
+                {"shareTime", share->createdAt},
+                {"expireTime", share->expireTime}
             }}
         };
 
         resp->setStatusCode(HttpResponse::k200Ok);
         resp->setStatusMessage("OK");
         resp->setContentType("application/json");
-        resp->addHeader("Connection", "close");
         resp->setBody(response.dump());
 
-        conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-            connection->shutdown();
-            return true;
-        });
-        
         return true;
     }
 
     // 处理 favicon.ico 请求
     bool handleFavicon(const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
-        // 获取当前文件目录
-        std::string currentDir = __FILE__;
-        std::string::size_type pos = currentDir.find_last_of("/");
-        std::string projectRoot = currentDir.substr(0, pos);
-        std::string faviconPath = projectRoot + "/favicon.ico";
-        
-        // 读取 favicon.ico 文件
-        std::ifstream file(faviconPath, std::ios::binary);
-        if (!file.is_open()) {
+        auto asset = staticAssets_.get(staticDir_ + "/favicon.ico", "image/x-icon", "public, max-age=86400");
+        if (!asset) {
             LOG_ERROR << "Failed to open favicon.ico";
             resp->setStatusCode(HttpResponse::k404NotFound);
             resp->setStatusMessage("Not Found");
             resp->setContentType("image/x-icon");
-            resp->addHeader("Connection", "close");
             resp->setBody("");
-        } else {
-            std::string iconData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-            file.close();
-            
-            resp->setStatusCode(HttpResponse::k200Ok);
-            resp->setStatusMessage("OK");
-            resp->setContentType("image/x-icon");
-            resp->addHeader("Connection", "close");
-            resp->setBody(iconData);
-        }
-        
-        conn->setWriteCompleteCallback([](const TcpConnectionPtr& connection) {
-            connection->shutdown();
             return true;
-        });
+        }
+        StaticAssetCache::serve(asset, req, resp);
         return true;
     }
 };
@@ -2334,7 +3149,8 @@ private:
 int main() {
     Logger::setLogLevel(Logger::INFO);
     EventLoop loop;
-    HttpServer server(&loop, InetAddress(8000), "http-upload-test");
+    // 每个IO线程各自监听8000端口（SO_REUSEPORT），由内核分配新连接
+    HttpServer server(&loop, InetAddress(8000), "http-upload-test", TcpServer::kReusePort);
     
     // 创建HTTP处理器
     auto handler = std::make_shared<HttpUploadHandler>(4);
@@ -2345,13 +3161,43 @@ int main() {
             handler->onConnection(conn);
         });
     
+    // 设置请求头回调，上传请求的请求体边接收边写盘
+    server.setHeadersCallback(
+        [handler](const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
+            return handler->onHeaders(conn, req, resp);
+        });
+
     // 设置HTTP回调
     server.setHttpCallback(
         [handler](const TcpConnectionPtr& conn, HttpRequest& req, HttpResponse* resp) {
             return handler->onRequest(conn, req, resp);
         });
+
+    // 注册路由
+    handler->registerRoutes(server);
+    // FILE_STORAGE=cdc 时新上传的文件按内容定义分块保存
+    const char* storage = ::getenv("FILE_STORAGE");
+    handler->setChunkedStorage(storage && ::strcmp(storage, "cdc") == 0);
+    // FILE_COMPRESSION=gzip 时新上传的文件压缩保存
+    const char* compression = ::getenv("FILE_COMPRESSION");
+    handler->setCompressedStorage(compression && ::strcmp(compression, "gzip") == 0);
+    // FILE_LIST_CACHE_MB 设置文件列表缓存的内存上限，0表示不缓存
+    if (const char* listCacheMb = ::getenv("FILE_LIST_CACHE_MB")) {
+        handler->setFileListCacheBytes(static_cast<size_t>(::strtoul(listCacheMb, nullptr, 10)) * 1024 * 1024);
+    }
+    
+    // HTTP_EPOLL=et 时连接使用边沿触发
+    const char* epollMode = ::getenv("HTTP_EPOLL");
+    server.setEdgeTriggered(epollMode && ::strcmp(epollMode, "et") == 0);
     
-    server.setThreadNum(0);
+    // 定时器在主loop上，会话过期时间的写回和上传清理交给handler的线程池
+    handler->startSessionFlush(&loop);
+    handler->startUploadSweep(&loop);
+    handler->startStaticWatch(&loop);
+
+    // 较大的JSON、HTML等响应按Accept-Encoding压缩
+    server.setCompressionMinSize(HttpUploadHandler::kCompressionMinSize);
+    server.setThreadNum(4);
     server.start();
     std::cout << "HTTP upload server is running on port 8000..." << std::endl;
     std::cout << "Please visit http://localhost:8000" << std::endl;
@@ -1,25 +1,28 @@
+#include "net/RouteTrie.h"
+#include "net/HttpRequest.h"
+#include "base/Logging.h"
+
 #include <iostream>
 #include <vector>
 #include <regex>
 #include <string>
 #include <chrono>
 #include <random>
-#include <memory>
-#include <map>
-#include <unordered_map>
-#include <functional>
 
-// 路由模式结构（当前实现方式）
+using namespace mymuduo;
+using namespace mymuduo::net;
+
+// 路由模式结构（原先基于正则表达式的实现方式）
 struct RoutePattern {
     std::regex pattern;
     std::vector<std::string> params;
-    std::string handler;
-    std::string method;
+    int handler;
+    HttpRequest::Method method;
 
-    RoutePattern(const std::string& pattern_str, 
+    RoutePattern(const std::string& pattern_str,
                 const std::vector<std::string>& param_names,
-                const std::string& h,
-                const std::string& m)
+                int h,
+                HttpRequest::Method m)
         : pattern(pattern_str)
         , params(param_names)
         , handler(h)
@@ -27,227 +30,182 @@ struct RoutePattern {
     {}
 };
 
-// Trie树实现
-class RouteTrie {
+// 性能测试类：对比正则表达式逐条匹配和net/RouteTrie
+class RouteBenchmark {
 private:
-    struct TrieNode {
-        std::map<std::string, std::shared_ptr<TrieNode>> children;
-        std::map<std::string, std::string> handlers;  // method -> handler
-        std::vector<std::string> paramNames;
-        bool isLeaf;
-        
-        TrieNode() : isLeaf(false) {}
-    };
-    
-    std::shared_ptr<TrieNode> root;
-    
-    std::vector<std::string> splitPath(const std::string& path) {
-        std::vector<std::string> segments;
+    std::vector<RoutePattern> regexRoutes_;
+    RouteTrie trieRoutes_;
+    std::vector<std::string> routePaths_;  // 注册的路由模式，用于生成能命中的请求
+    std::mt19937 gen_;
+
+    std::string randomSegment() {
+        static const char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+        std::uniform_int_distribution<> dis(0, sizeof(chars) - 2);
+        int len = dis(gen_) % 5 + 3;  // 3-7个字符
         std::string segment;
-        std::istringstream pathStream(path);
-        
-        while (std::getline(pathStream, segment, '/')) {
-            if (!segment.empty()) {
-                segments.push_back(segment);
-            }
+        for (int j = 0; j < len; ++j) {
+            segment += chars[dis(gen_)];
         }
-        return segments;
+        return segment;
     }
-    
-public:
-    RouteTrie() : root(std::make_shared<TrieNode>()) {}
-    
-    void addRoute(const std::string& path, const std::string& method, 
-                 const std::string& handler, const std::vector<std::string>& paramNames) {
-        auto current = root;
-        auto segments = splitPath(path);
-        
-        for (const auto& segment : segments) {
-            if (segment[0] == ':') {
-                // 参数节点
-                current->paramNames.push_back(segment.substr(1));
-                if (!current->children["*"]) {
-                    current->children["*"] = std::make_shared<TrieNode>();
-                }
-                current = current->children["*"];
-            } else {
-                // 静态节点
-                if (!current->children[segment]) {
-                    current->children[segment] = std::make_shared<TrieNode>();
-                }
-                current = current->children[segment];
-            }
-        }
-        
-        current->isLeaf = true;
-        current->handlers[method] = handler;
-    }
-    
-    struct RouteMatch {
-        std::string handler;
-        std::unordered_map<std::string, std::string> params;
-    };
-    
-    RouteMatch findRoute(const std::string& path, const std::string& method) {
-        auto current = root;
-        std::unordered_map<std::string, std::string> params;
-        auto segments = splitPath(path);
-        
-        for (const auto& segment : segments) {
-            if (current->children.find(segment) != current->children.end()) {
-                current = current->children[segment];
-            } else if (current->children.find("*") != current->children.end()) {
-                current = current->children["*"];
-                if (!current->paramNames.empty()) {
-                    params[current->paramNames.back()] = segment;
-                }
+
+    // 生成随机路由模式
+    std::string generateRandomPattern(int depth) {
+        std::uniform_int_distribution<> dis(0, 2);
+        std::string path;
+        for (int i = 0; i < depth; ++i) {
+            path += '/';
+            if (dis(gen_) == 0) {  // 约1/3的概率生成参数段
+                path += ":param" + std::to_string(i);
             } else {
-                return RouteMatch{"", {}};
+                path += randomSegment();
             }
         }
-        
-        if (current->isLeaf && 
-            current->handlers.find(method) != current->handlers.end()) {
-            return RouteMatch{current->handlers[method], params};
-        }
-        
-        return RouteMatch{"", {}};
+        return path;
     }
-};
 
-// 性能测试类
-class RouteBenchmark {
-private:
-    std::vector<RoutePattern> regexRoutes_;
-    RouteTrie trieRoutes_;
-    
-    // 生成随机路径
-    std::string generateRandomPath(int depth) {
-        static const char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789";
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(0, sizeof(chars) - 2);
-        
+    // 把路由模式中的参数段替换为随机值，得到能命中的请求路径
+    std::string instantiate(const std::string& pattern) {
         std::string path;
-        for (int i = 0; i < depth; ++i) {
-            if (i > 0) path += '/';
-            if (dis(gen) % 3 == 0) {  // 30%的概率生成参数路径
-                path += ":param" + std::to_string(i);
+        size_t pos = 0;
+        while (pos < pattern.size()) {
+            size_t end = pattern.find('/', pos + 1);
+            if (end == std::string::npos) end = pattern.size();
+            if (pattern[pos + 1] == ':') {
+                path += "/" + randomSegment();
             } else {
-                int len = dis(gen) % 5 + 3;  // 3-7个字符
-                for (int j = 0; j < len; ++j) {
-                    path += chars[dis(gen)];
-                }
+                path += pattern.substr(pos, end - pos);
             }
+            pos = end;
         }
         return path;
     }
-    
+
     // 生成测试数据
     void generateTestData(int numRoutes) {
-        std::vector<std::string> methods = {"GET", "POST", "PUT", "DELETE"};
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> methodDis(0, static_cast<int>(methods.size() - 1));
+        const HttpRequest::Method methods[] = {
+            HttpRequest::kGet, HttpRequest::kPost, HttpRequest::kPut, HttpRequest::kDelete
+        };
+        std::uniform_int_distribution<> methodDis(0, 3);
         std::uniform_int_distribution<> depthDis(1, 5);
-        
+
         for (int i = 0; i < numRoutes; ++i) {
-            std::string method = methods[methodDis(gen)];
-            int depth = depthDis(gen);
-            std::string path = generateRandomPath(depth);
-            std::string handler = "handler" + std::to_string(i);
-            
+            HttpRequest::Method method = methods[methodDis(gen_)];
+            std::string path = generateRandomPattern(depthDis(gen_));
+            routePaths_.push_back(path);
+
             // 添加正则路由
-            std::string pattern = "^" + path + "$";
+            std::string pattern = "^";
             std::vector<std::string> params;
             size_t pos = 0;
-            while ((pos = path.find(":param", pos)) != std::string::npos) {
-                size_t end = path.find('/', pos);
-                if (end == std::string::npos) end = path.length();
-                params.push_back(path.substr(pos + 6, end - pos - 6));
+            while (pos < path.size()) {
+                size_t end = path.find('/', pos + 1);
+                if (end == std::string::npos) end = path.size();
+                if (path[pos + 1] == ':') {
+                    params.push_back(path.substr(pos + 2, end - pos - 2));
+                    pattern += "/([^/]+)";
+                } else {
+                    pattern += path.substr(pos, end - pos);
+                }
                 pos = end;
             }
-            regexRoutes_.emplace_back(pattern, params, handler, method);
-            
+            pattern += "$";
+            regexRoutes_.emplace_back(pattern, params, i, method);
+
             // 添加Trie路由
-            trieRoutes_.addRoute(path, method, handler, params);
+            trieRoutes_.addRoute(method, path, i);
         }
     }
-    
+
 public:
+    RouteBenchmark() : gen_(20240601) {}
+
     void runBenchmark(int numRoutes, int numRequests) {
+        regexRoutes_.clear();
+        trieRoutes_.clear();
+        routePaths_.clear();
+
         std::cout << "生成 " << numRoutes << " 个路由..." << std::endl;
         generateTestData(numRoutes);
-        
+
+        // 一半请求命中已注册的路由，一半是随机路径
         std::cout << "\n生成 " << numRequests << " 个测试请求..." << std::endl;
-        std::vector<std::pair<std::string, std::string>> testRequests;
+        std::uniform_int_distribution<size_t> routeDis(0, routePaths_.size() - 1);
+        std::uniform_int_distribution<> depthDis(1, 5);
+        std::vector<HttpRequest> testRequests(static_cast<size_t>(numRequests));
+        const char get[] = "GET";
         for (int i = 0; i < numRequests; ++i) {
-            int depth = std::rand() % 5 + 1;
-            testRequests.emplace_back(generateRandomPath(depth), "GET");
+            std::string path = (i % 2 == 0) ? instantiate(routePaths_[routeDis(gen_)])
+                                            : instantiate(generateRandomPattern(depthDis(gen_)));
+            HttpRequest& req = testRequests[static_cast<size_t>(i)];
+            req.setMethod(get, get + 3);
+            req.setPath(path.data(), path.data() + path.size());
         }
-        
+
         // 测试正则匹配
         std::cout << "\n测试正则表达式匹配..." << std::endl;
         auto start = std::chrono::high_resolution_clock::now();
         int regexMatches = 0;
         for (const auto& request : testRequests) {
             for (const auto& route : regexRoutes_) {
-                if (route.method != request.second) continue;
+                if (route.method != request.method()) continue;
                 std::smatch matches;
-                if (std::regex_match(request.first, matches, route.pattern)) {
+                if (std::regex_match(request.path(), matches, route.pattern)) {
                     regexMatches++;
                     break;
                 }
             }
         }
         auto end = std::chrono::high_resolution_clock::now();
-        auto regexDuration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-        
+        auto regexDuration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+
         // 测试Trie匹配
         std::cout << "测试Trie树匹配..." << std::endl;
         start = std::chrono::high_resolution_clock::now();
         int trieMatches = 0;
-        for (const auto& request : testRequests) {
-            auto match = trieRoutes_.findRoute(request.first, request.second);
-            if (!match.handler.empty()) {
+        for (auto& request : testRequests) {
+            if (trieRoutes_.match(request) != RouteTrie::kNoRoute) {
                 trieMatches++;
             }
         }
         end = std::chrono::high_resolution_clock::now();
-        auto trieDuration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-        
+        auto trieDuration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+
         // 输出结果
         std::cout << "\n性能测试结果:" << std::endl;
         std::cout << "正则表达式匹配:" << std::endl;
         std::cout << "  总请求数: " << numRequests << std::endl;
         std::cout << "  匹配成功数: " << regexMatches << std::endl;
-        std::cout << "  耗时: " << regexDuration.count() << "ms" << std::endl;
-        std::cout << "  平均每个请求耗时: " << static_cast<double>(regexDuration.count()) /static_cast<double>(numRequests) << "ms" << std::endl;
-        
+        std::cout << "  耗时: " << static_cast<double>(regexDuration.count()) / 1000.0 << "ms" << std::endl;
+        std::cout << "  平均每个请求耗时: " << static_cast<double>(regexDuration.count()) / static_cast<double>(numRequests) << "us" << std::endl;
+
         std::cout << "\nTrie树匹配:" << std::endl;
         std::cout << "  总请求数: " << numRequests << std::endl;
         std::cout << "  匹配成功数: " << trieMatches << std::endl;
-        std::cout << "  耗时: " << trieDuration.count() << "ms" << std::endl;
-        std::cout << "  平均每个请求耗时: " << static_cast<double>(trieDuration.count()) / static_cast<double>(numRequests) << "ms" << std::endl;
-        
-        std::cout << "\n性能提升: " 
-                  << (static_cast<double>(regexDuration.count() - trieDuration.count()) / static_cast<double>(regexDuration.count())) * 100.0
-                  << "%" << std::endl;
+        std::cout << "  耗时: " << static_cast<double>(trieDuration.count()) / 1000.0 << "ms" << std::endl;
+        std::cout << "  平均每个请求耗时: " << static_cast<double>(trieDuration.count()) / static_cast<double>(numRequests) << "us" << std::endl;
+
+        if (regexDuration.count() > 0) {
+            std::cout << "\n性能提升: "
+                      << (static_cast<double>(regexDuration.count() - trieDuration.count()) / static_cast<double>(regexDuration.count())) * 100.0
+                      << "%" << std::endl;
+        }
     }
 };
 
 int main() {
+    Logger::setLogLevel(Logger::WARN);
     RouteBenchmark benchmark;
-    
+
     // 测试不同规模的路由和请求
     std::cout << "=== 小规模测试 (100路由, 1000请求) ===" << std::endl;
     benchmark.runBenchmark(100, 1000);
-    
+
     std::cout << "\n=== 中等规模测试 (1000路由, 10000请求) ===" << std::endl;
     benchmark.runBenchmark(1000, 10000);
-    
+
     std::cout << "\n=== 大规模测试 (10000路由, 100000请求) ===" << std::endl;
     benchmark.runBenchmark(10000, 100000);
-    
+
     return 0;
-}
\ No newline at end of file
+}
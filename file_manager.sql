@@ -38,10 +38,12 @@ CREATE TABLE IF NOT EXISTS files (
     file_size BIGINT UNSIGNED NOT NULL,
     file_type VARCHAR(50),
     user_id INT NOT NULL,
+    content_hash CHAR(64) NULL,
     created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
     updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP,
     INDEX idx_filename (filename),
     INDEX idx_user_id (user_id),
+    INDEX idx_content_hash (content_hash),
     FOREIGN KEY (user_id) REFERENCES users(id) ON DELETE CASCADE
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci;
 
@@ -1,6 +1,5 @@
 #include "Buffer.h"
 #include <errno.h>
-#include <sys/uio.h>
 #include <unistd.h>
 
 using namespace mymuduo;
@@ -8,37 +7,64 @@ using namespace mymuduo::net;
 
 const char Buffer::kCRLF[] = "\r\n";
 
+const size_t Buffer::kMinReadSize;
+const size_t Buffer::kMaxReadSize;
+
+char* Buffer::emptyStorage() {
+    static char storage[kCheapPrepend];
+    return storage;
+}
+
+void Buffer::reallocate(size_t len) {
+    size_t readable = readableBytes();
+    size_t size = kCheapPrepend + readable + std::max(len, initialSize_);
+    if (buffer_ != emptyStorage()) {
+        // 超过最大级别后块大小不再成倍增长，按容量翻倍避免持续追加时反复拷贝
+        size = std::max(size, capacity_ * 2);
+    }
+    size_t capacity;
+    char* block = BufferPool::allocate(size, &capacity);
+    std::copy(peek(), peek() + readable, block + kCheapPrepend);
+    release();
+    buffer_ = block;
+    capacity_ = capacity;
+    writerIndex_ = kCheapPrepend + readable;
+}
+
+void Buffer::release() {
+    if (buffer_ != emptyStorage()) {
+        BufferPool::deallocate(buffer_, capacity_);
+        buffer_ = emptyStorage();
+        capacity_ = kCheapPrepend;
+    }
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend;
+}
+
 /// @brief 从文件描述符读取数据
 /// @param fd 文件描述符
 /// @param savedErrno 保存错误码
 /// @return 读取的字节数
 ssize_t Buffer::readFd(int fd, int* savedErrno) {
-    // 栈上的额外缓冲区
-    char extrabuf[65536];
-    struct iovec vec[2];
+    // 可写空间不到readSize_的一半时先扩充，数据直接读入缓冲区，不再经过栈上的缓冲区拷贝一次
+    if (writableBytes() < readSize_ / 2) {
+        ensureWritableBytes(readSize_);
+    }
     const size_t writable = writableBytes();
-
-    // 第一块缓冲区是Buffer中的writable空间
-    vec[0].iov_base = begin() + writerIndex_;
-    vec[0].iov_len = writable;
-    // 第二块缓冲区是栈上的额外缓冲区
-    vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof extrabuf;
-
-    // 如果Buffer空间足够大，就不使用额外的缓冲区
-    const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
-    const ssize_t n = ::readv(fd, vec, iovcnt);
+    const ssize_t n = ::read(fd, beginWrite(), writable);
 
     if (n < 0) {
         *savedErrno = errno;
-    } else if (static_cast<size_t>(n) <= writable) {
-        // 数据完全写入Buffer中
-        writerIndex_ += n;
     } else {
-        // Buffer写满了，额外的数据写入了extrabuf，需要append
-        writerIndex_ = buffer_.size();
-        append(extrabuf, n - writable);
+        writerIndex_ += static_cast<size_t>(n);
+        // 读满说明内核中还有数据（如大文件上传），下次准备更大的空间；
+        // 读到的很少时逐步缩小，避免空闲时每次都分配大块
+        if (static_cast<size_t>(n) == writable) {
+            readSize_ = std::min(readSize_ * 2, kMaxReadSize);
+        } else if (static_cast<size_t>(n) < readSize_ / 4) {
+            readSize_ = std::max(readSize_ / 2, kMinReadSize);
+        }
     }
 
     return n;
-} 
\ No newline at end of file
+}
@@ -1,8 +1,9 @@
 #ifndef MYMUDUO_NET_BUFFER_H
 #define MYMUDUO_NET_BUFFER_H
 
+#include "BufferPool.h"
+
 #include <algorithm>
-#include <vector>
 #include <string>
 #include <assert.h>
 #include <cstring>
@@ -30,25 +31,55 @@ namespace net {
 /// - prependable区域用于在数据前添加额外信息（如消息长度）
 /// - readable区域存储可读数据
 /// - writable区域用于写入新数据
+///
+/// 存储空间是从BufferPool取得的按大小分级的内存块，第一次写入时才分配，
+/// 数据全部取走后归还，空闲的连接不占用缓冲区内存
 class Buffer {
 public:
     static const size_t kCheapPrepend = 8;     // 预留空间大小
-    static const size_t kInitialSize = 1024;   // 初始缓冲区大小
+    static const size_t kInitialSize = 1024;   // 第一次分配时至少可写的大小
+    static const size_t kMinReadSize = 4 * 1024;    // readFd每次至少准备的可写空间
+    static const size_t kMaxReadSize = 256 * 1024;  // readFd每次最多准备的可写空间
 
     explicit Buffer(size_t initialSize = kInitialSize)
-        : buffer_(kCheapPrepend + initialSize),
+        : buffer_(emptyStorage()),
+          capacity_(kCheapPrepend),
+          initialSize_(initialSize),
+          readSize_(kMinReadSize),
           readerIndex_(kCheapPrepend),
           writerIndex_(kCheapPrepend)
     {
         assert(readableBytes() == 0);
-        assert(writableBytes() == initialSize);
+        assert(writableBytes() == 0);
         assert(prependableBytes() == kCheapPrepend);
     }
 
-    // 默认拷贝构造和赋值是安全的
+    ~Buffer() { release(); }
+
+    // 拷贝只复制可读数据
+    Buffer(const Buffer& rhs)
+        : Buffer(rhs.initialSize_)
+    {
+        append(rhs.peek(), rhs.readableBytes());
+    }
+
+    Buffer(Buffer&& rhs) noexcept
+        : Buffer(rhs.initialSize_)
+    {
+        swap(rhs);
+    }
+
+    Buffer& operator=(Buffer rhs) noexcept {
+        swap(rhs);
+        return *this;
+    }
+
     // Buffer对象的swap是O(1)复杂度的
-    void swap(Buffer& rhs) {
-        buffer_.swap(rhs.buffer_);
+    void swap(Buffer& rhs) noexcept {
+        std::swap(buffer_, rhs.buffer_);
+        std::swap(capacity_, rhs.capacity_);
+        std::swap(initialSize_, rhs.initialSize_);
+        std::swap(readSize_, rhs.readSize_);
         std::swap(readerIndex_, rhs.readerIndex_);
         std::swap(writerIndex_, rhs.writerIndex_);
     }
@@ -57,7 +88,7 @@ public:
     size_t readableBytes() const { return writerIndex_ - readerIndex_; }
 
     /// @brief 可写字节数
-    size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+    size_t writableBytes() const { return capacity_ - writerIndex_; }
 
     /// @brief 可前置字节数
     size_t prependableBytes() const { return readerIndex_; }
@@ -110,10 +141,9 @@ public:
         retrieve(end - peek());
     }
 
-    /// @brief 读取所有数据
+    /// @brief 读取所有数据，存储空间归还给BufferPool
     void retrieveAll() {
-        readerIndex_ = kCheapPrepend;
-        writerIndex_ = kCheapPrepend;
+        release();
     }
 
     /// @brief 读取所有数据并转换为string
@@ -168,6 +198,9 @@ public:
     /// @brief 前置数据
     void prepend(const void* data, size_t len) {
         assert(len <= prependableBytes());
+        if (buffer_ == emptyStorage()) {
+            makeSpace(0);
+        }
         readerIndex_ -= len;
         const char* d = static_cast<const char*>(data);
         std::copy(d, d+len, begin()+readerIndex_);
@@ -175,25 +208,35 @@ public:
 
     /// @brief 收缩空间
     void shrink(size_t reserve) {
-        Buffer other;
+        Buffer other(0);
         other.ensureWritableBytes(readableBytes()+reserve);
         other.append(peek(), readableBytes());
         swap(other);
     }
 
-    /// @brief 缓冲区容量
-    size_t capacity() const { return buffer_.capacity(); }
+    /// @brief 缓冲区容量，没有分配存储空间时为0
+    size_t capacity() const { return buffer_ == emptyStorage() ? 0 : capacity_; }
 
-    /// @brief 从fd读取数据
+    /// @brief 从fd读取数据，直接读入可写空间，不经过额外的缓冲区
+    /// 可写空间的大小按最近几次读到的数据量自适应调整
     ssize_t readFd(int fd, int* savedErrno);
 
 private:
-    char* begin() { return &*buffer_.begin(); }
-    const char* begin() const { return &*buffer_.begin(); }
+    char* begin() { return buffer_; }
+    const char* begin() const { return buffer_; }
+
+    // 没有分配存储空间时buffer_指向的共享空块，只有kCheapPrepend个字节，不会被写入
+    static char* emptyStorage();
+
+    // 换成能容纳可读数据和len字节可写空间的块，可读数据移到kCheapPrepend处
+    void reallocate(size_t len);
+    // 归还存储空间，回到未分配状态
+    void release();
 
     void makeSpace(size_t len) {
-        if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
-            buffer_.resize(writerIndex_+len);
+        if (buffer_ == emptyStorage() ||
+            writableBytes() + prependableBytes() < len + kCheapPrepend) {
+            reallocate(len);
         } else {
             assert(kCheapPrepend < readerIndex_);
             size_t readable = readableBytes();
@@ -207,7 +250,10 @@ private:
     }
 
 private:
-    std::vector<char> buffer_;  // 缓冲区
+    char* buffer_;              // 缓冲区
+    size_t capacity_;           // buffer_的大小
+    size_t initialSize_;        // 第一次分配时至少可写的大小
+    size_t readSize_;           // readFd准备的可写空间，读满时加倍，读到的很少时减半
     size_t readerIndex_;        // 读位置
     size_t writerIndex_;        // 写位置
 
@@ -0,0 +1,89 @@
+#include "BufferPool.h"
+
+#include <stdlib.h>
+#include <new>
+
+using namespace mymuduo;
+using namespace mymuduo::net;
+
+namespace {
+
+const size_t kNumClasses = 6;
+const size_t kClassSizes[kNumClasses] = {
+    2 * 1024, 8 * 1024, 32 * 1024, 128 * 1024, 512 * 1024, 2 * 1024 * 1024
+};
+const size_t kPageSize = 4096;
+
+// 空闲块的前几个字节用作链表指针
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+// 线程退出时释放缓存的块
+struct ThreadCache {
+    FreeBlock* freeLists[kNumClasses] = {};
+    size_t cachedBytes = 0;
+    bool alive = true;  // 析构之后（线程退出时）归还的块直接释放
+
+    ~ThreadCache() {
+        for (FreeBlock*& head : freeLists) {
+            while (head) {
+                FreeBlock* next = head->next;
+                ::free(head);
+                head = next;
+            }
+        }
+        cachedBytes = 0;
+        alive = false;
+    }
+};
+
+thread_local ThreadCache t_cache;
+
+// 能容纳size字节的最小级别，超过最大级别时返回kNumClasses
+size_t classIndex(size_t size) {
+    size_t index = 0;
+    while (index < kNumClasses && kClassSizes[index] < size) {
+        ++index;
+    }
+    return index;
+}
+
+} // namespace
+
+char* BufferPool::allocate(size_t size, size_t* capacity) {
+    size_t index = classIndex(size);
+    if (index == kNumClasses) {
+        *capacity = (size + kPageSize - 1) / kPageSize * kPageSize;
+    } else {
+        *capacity = kClassSizes[index];
+        FreeBlock* block = t_cache.freeLists[index];
+        if (block) {
+            t_cache.freeLists[index] = block->next;
+            t_cache.cachedBytes -= *capacity;
+            return reinterpret_cast<char*>(block);
+        }
+    }
+    void* block = ::malloc(*capacity);
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    return static_cast<char*>(block);
+}
+
+void BufferPool::deallocate(char* block, size_t capacity) {
+    size_t index = classIndex(capacity);
+    if (index == kNumClasses || kClassSizes[index] != capacity || !t_cache.alive ||
+        t_cache.cachedBytes + capacity > kMaxCachedBytes) {
+        ::free(block);
+        return;
+    }
+    FreeBlock* freeBlock = reinterpret_cast<FreeBlock*>(block);
+    freeBlock->next = t_cache.freeLists[index];
+    t_cache.freeLists[index] = freeBlock;
+    t_cache.cachedBytes += capacity;
+}
+
+size_t BufferPool::cachedBytes() {
+    return t_cache.cachedBytes;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "base/noncopyable.h"
+
+#include <stddef.h>
+
+namespace mymuduo {
+namespace net {
+
+/// @brief Buffer使用的内存块池
+///
+/// 块按大小分级（2KB、8KB、32KB、128KB、512KB、2MB），每个线程（即每个EventLoop）
+/// 有自己的空闲链表，分配和归还都不加锁。每个线程缓存的空闲块总量有上限，超出时直接释放；
+/// 大于最大级别的块不缓存。块可以在一个线程分配、在另一个线程归还。
+class BufferPool : noncopyable {
+public:
+    static const size_t kMaxCachedBytes = 8 * 1024 * 1024;  // 每个线程缓存的空闲块上限
+
+    /// @brief 分配至少size字节的块，实际大小写入*capacity
+    static char* allocate(size_t size, size_t* capacity);
+    /// @brief 归还allocate得到的块，capacity为分配时返回的大小
+    static void deallocate(char* block, size_t capacity);
+
+    /// @brief 当前线程缓存的空闲字节数
+    static size_t cachedBytes();
+};
+
+}  // namespace net
+}  // namespace mymuduo
@@ -31,6 +31,8 @@ using ConnectionCallback = std::function<void(const TcpConnectionPtr&)>;
 using CloseCallback = std::function<void(const TcpConnectionPtr&)>;
 using WriteCompleteCallback = std::function<void(const TcpConnectionPtr&)>;
 using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
+// 向Buffer追加要发送的下一段数据，返回false表示这是最后一段（见TcpConnection::sendStream）
+using BodyProducer = std::function<bool(Buffer*)>;
 typedef std::function<void (const TcpConnectionPtr&,
                             Buffer*,
                             Timestamp)> MessageCallback;
@@ -20,6 +20,7 @@ Channel::Channel(EventLoop* loop, int fd)
       eventHandling_(false),
       addedToLoop_(false),
       logHup_(true),
+      edgeTriggered_(false),
       tied_(false) {
 }
 
@@ -69,6 +69,10 @@ public:
     bool isWriting() const { return events_ & kWriteEvent; }
     /// @brief 是否注册了读事件
     bool isReading() const { return events_ & kReadEvent; }
+    /// @brief 设置边沿触发（EPOLLET，PollPoller忽略），需在第一次注册事件之前调用
+    /// 边沿触发时每次事件之后必须一直读/写到EAGAIN，否则不会再收到通知
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    bool edgeTriggered() const { return edgeTriggered_; }
 
     /// @brief 获取所属的EventLoop
     EventLoop* ownerLoop() { return loop_; }
@@ -100,6 +104,7 @@ private:
     bool eventHandling_;           // 是否正在处理事件
     bool addedToLoop_;            // 是否已添加到EventLoop
     bool logHup_;                 // 是否记录POLLHUP事件
+    bool edgeTriggered_;          // 是否边沿触发
 
     ReadEventCallback readCallback_;    // 读事件回调
     EventCallback writeCallback_;       // 写事件回调
@@ -0,0 +1,175 @@
+#include "ContentEncoding.h"
+
+#include <stdlib.h>
+#include <strings.h>
+#include <zlib.h>
+#ifdef MYMUDUO_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace mymuduo {
+namespace net {
+
+namespace {
+
+std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = s.find_last_not_of(" \t");
+    return s.substr(begin, end - begin + 1);
+}
+
+// 取出Accept-Encoding中gzip和br的q值，没有列出的编码取"*"的q值，都没有时为-1
+void parseAcceptEncoding(const std::string& acceptEncoding, double* gzipQ, double* brotliQ) {
+    double starQ = -1;
+    *gzipQ = -1;
+    *brotliQ = -1;
+    size_t start = 0;
+    while (start <= acceptEncoding.size()) {
+        size_t comma = acceptEncoding.find(',', start);
+        if (comma == std::string::npos) {
+            comma = acceptEncoding.size();
+        }
+        std::string item = acceptEncoding.substr(start, comma - start);
+        start = comma + 1;
+
+        size_t semicolon = item.find(';');
+        std::string coding = trim(item.substr(0, semicolon));
+        double q = 1.0;
+        if (semicolon != std::string::npos) {
+            std::string param = trim(item.substr(semicolon + 1));
+            if (param.size() >= 2 && (param[0] == 'q' || param[0] == 'Q')) {
+                size_t eq = param.find('=');
+                if (eq != std::string::npos) {
+                    q = ::strtod(param.c_str() + eq + 1, nullptr);
+                }
+            }
+        }
+
+        if (::strcasecmp(coding.c_str(), "gzip") == 0 || ::strcasecmp(coding.c_str(), "x-gzip") == 0) {
+            *gzipQ = q;
+        } else if (::strcasecmp(coding.c_str(), "br") == 0) {
+            *brotliQ = q;
+        } else if (coding == "*") {
+            starQ = q;
+        }
+    }
+    if (*gzipQ < 0) {
+        *gzipQ = starQ;
+    }
+    if (*brotliQ < 0) {
+        *brotliQ = starQ;
+    }
+}
+
+bool gzipEncode(const std::string& input, std::string* output, bool best) {
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    // windowBits加16表示输出gzip格式
+    if (::deflateInit2(&stream, best ? Z_BEST_COMPRESSION : Z_DEFAULT_COMPRESSION,
+                       Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    output->resize(::deflateBound(&stream, static_cast<uLong>(input.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&(*output)[0]);
+    stream.avail_out = static_cast<uInt>(output->size());
+    int ret = ::deflate(&stream, Z_FINISH);
+    output->resize(stream.total_out);
+    ::deflateEnd(&stream);
+    return ret == Z_STREAM_END;
+}
+
+#ifdef MYMUDUO_HAVE_BROTLI
+bool brotliEncode(const std::string& input, std::string* output, bool best) {
+    size_t size = ::BrotliEncoderMaxCompressedSize(input.size());
+    if (size == 0) {
+        return false;
+    }
+    output->resize(size);
+    // 动态响应用中等级别，压缩速度与gzip相当
+    if (!::BrotliEncoderCompress(best ? BROTLI_MAX_QUALITY : 5, BROTLI_DEFAULT_WINDOW,
+                                 BROTLI_MODE_TEXT, input.size(),
+                                 reinterpret_cast<const uint8_t*>(input.data()),
+                                 &size, reinterpret_cast<uint8_t*>(&(*output)[0]))) {
+        return false;
+    }
+    output->resize(size);
+    return true;
+}
+#endif
+
+} // namespace
+
+ContentEncoding::Coding ContentEncoding::negotiate(const std::string& acceptEncoding) {
+    if (acceptEncoding.empty()) {
+        return kIdentity;
+    }
+    double gzipQ, brotliQ;
+    parseAcceptEncoding(acceptEncoding, &gzipQ, &brotliQ);
+    if (available(kBrotli) && brotliQ > 0 && brotliQ >= gzipQ) {
+        return kBrotli;
+    }
+    return gzipQ > 0 ? kGzip : kIdentity;
+}
+
+bool ContentEncoding::accepts(const std::string& acceptEncoding, Coding coding) {
+    if (coding == kIdentity) {
+        return true;
+    }
+    double gzipQ, brotliQ;
+    parseAcceptEncoding(acceptEncoding, &gzipQ, &brotliQ);
+    return (coding == kGzip ? gzipQ : brotliQ) > 0;
+}
+
+const char* ContentEncoding::name(Coding coding) {
+    switch (coding) {
+    case kGzip:
+        return "gzip";
+    case kBrotli:
+        return "br";
+    default:
+        return "identity";
+    }
+}
+
+bool ContentEncoding::available(Coding coding) {
+#ifdef MYMUDUO_HAVE_BROTLI
+    return true;
+#else
+    return coding != kBrotli;
+#endif
+}
+
+bool ContentEncoding::encode(Coding coding, const std::string& input, std::string* output, bool best) {
+    switch (coding) {
+    case kGzip:
+        return gzipEncode(input, output, best);
+#ifdef MYMUDUO_HAVE_BROTLI
+    case kBrotli:
+        return brotliEncode(input, output, best);
+#endif
+    case kIdentity:
+        *output = input;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ContentEncoding::compressibleType(const std::string& contentType) {
+    std::string type = contentType.substr(0, contentType.find(';'));
+    return ::strncasecmp(type.c_str(), "text/", 5) == 0 ||
+           ::strcasecmp(type.c_str(), "application/json") == 0 ||
+           ::strcasecmp(type.c_str(), "application/javascript") == 0 ||
+           ::strcasecmp(type.c_str(), "application/xml") == 0 ||
+           ::strcasecmp(type.c_str(), "image/svg+xml") == 0;
+}
+
+} // namespace net
+} // namespace mymuduo
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+namespace mymuduo {
+namespace net {
+
+// HTTP响应体的内容编码（Content-Encoding）
+// gzip总是可用；编译时找到brotli库时（MYMUDUO_HAVE_BROTLI）也支持br
+class ContentEncoding {
+public:
+    enum Coding { kIdentity, kGzip, kBrotli };
+
+    // 按请求的Accept-Encoding选择编码：q值最高者优先，相同时br优先于gzip，
+    // q=0表示不接受；没有可用的编码时返回kIdentity
+    static Coding negotiate(const std::string& acceptEncoding);
+    // Accept-Encoding是否接受coding
+    static bool accepts(const std::string& acceptEncoding, Coding coding);
+
+    // 用于Content-Encoding头部的名字
+    static const char* name(Coding coding);
+    static bool available(Coding coding);
+
+    // 压缩整段数据，best为true时使用最高压缩级别（用于只压缩一次的静态资源）
+    static bool encode(Coding coding, const std::string& input, std::string* output, bool best = false);
+
+    // 值得压缩的Content-Type：文本、JSON、JavaScript、XML和SVG
+    static bool compressibleType(const std::string& contentType);
+};
+
+} // namespace net
+} // namespace mymuduo
@@ -48,12 +48,27 @@ bool HttpContext::processRequestLine(const char* begin, const char* end)
   return succeed;
 }
 
+// 已解析的请求行和头部加上还没解析的pending字节达到上限时返回false。
+// 没有上限的话，一直不发空行的客户端会让输入缓冲区无限增长
+bool HttpContext::checkHeaderSize(size_t pending) {
+    if (headerBytes_ + pending >= maxHeaderSize_) {
+        LOG_ERROR << "Request headers exceed " << maxHeaderSize_ << " bytes";
+        headersTooLarge_ = true;
+        return false;
+    }
+    return true;
+}
+
 bool HttpContext::processHeaders(Buffer* buf) {
     bool ok = true;
     bool hasMore = true;
     while (hasMore) {
         const char* crlf = buf->findCRLF();
         if (crlf) {
+            if (!checkHeaderSize(static_cast<size_t>(crlf + 2 - buf->peek()))) {
+                return false;
+            }
+            headerBytes_ += static_cast<size_t>(crlf + 2 - buf->peek());
             const char* colon = std::find(buf->peek(), crlf, ':');
             if (colon != crlf) {
                 request_.addHeader(buf->peek(), colon, crlf);
@@ -86,23 +101,43 @@ bool HttpContext::processHeaders(Buffer* buf) {
                 hasMore = false;
             }
         } else {
+            ok = checkHeaderSize(buf->readableBytes());
             hasMore = false;
         }
     }
     return ok;
 }
 
-bool HttpContext::processBody(Buffer* buf) {
+// 把一段请求体交给流式回调，或者追加到HttpRequest::body_
+bool HttpContext::deliverBody(const char* data, size_t len) {
+    if (bodyCallback_) {
+        // 流式处理：数据直接从Buffer交给回调，不再拷贝到body_
+        if (!bodyCallback_(data, len)) {
+            return false;
+        }
+    } else {
+        if (maxBodySize_ > 0 && bodyReceived_ + len > maxBodySize_) {
+            LOG_ERROR << "Request body exceeds " << maxBodySize_ << " bytes";
+            return false;
+        }
+        request_.appendToBody(data, len);
+    }
+    bodyReceived_ += len;
+    return true;
+}
+
+bool HttpContext::processBody(Buffer* buf, bool* error) {
     if (isChunked_) {
-        // TODO: 处理 chunked 传输
-        return false;
+        return processChunkedBody(buf, error);
     } else {
         size_t readable = buf->readableBytes();
         LOG_DEBUG << "processBody readable: " << readable;
         size_t toRead = std::min(readable, remainingLength());
         if (toRead > 0) {
-            request_.appendToBody(buf->peek(), toRead);
-            bodyReceived_ += toRead;
+            if (!deliverBody(buf->peek(), toRead)) {
+                *error = true;
+                return false;
+            }
             buf->retrieve(toRead);
         }
         LOG_DEBUG << "bodyReceived_: " << bodyReceived_ << ", contentLength_: " << contentLength_;
@@ -110,6 +145,110 @@ bool HttpContext::processBody(Buffer* buf) {
     }
 }
 
+namespace {
+
+// chunk大小行（含扩展）和trailer行的长度上限，超过则认为请求非法
+const size_t kMaxChunkLineLength = 4096;
+
+// 解析chunk大小行 "1a2b[;ext]"，不分配内存
+bool parseChunkSize(const char* begin, const char* end, size_t* size) {
+    size_t value = 0;
+    const char* p = begin;
+    for (; p < end; ++p) {
+        int digit;
+        if (*p >= '0' && *p <= '9') {
+            digit = *p - '0';
+        } else if (*p >= 'a' && *p <= 'f') {
+            digit = *p - 'a' + 10;
+        } else if (*p >= 'A' && *p <= 'F') {
+            digit = *p - 'A' + 10;
+        } else {
+            break;
+        }
+        if (value > (static_cast<size_t>(-1) >> 4)) {
+            return false;  // 溢出
+        }
+        value = (value << 4) | static_cast<size_t>(digit);
+    }
+    if (p == begin) {
+        return false;
+    }
+    // 其后只允许空白和chunk扩展
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    if (p != end && *p != ';') {
+        return false;
+    }
+    *size = value;
+    return true;
+}
+
+} // namespace
+
+// 增量解码chunked请求体：数据部分原地交给deliverBody，
+// 大小行或CRLF没有完整到达时留在缓冲区，等下一次数据到达再继续
+bool HttpContext::processChunkedBody(Buffer* buf, bool* error) {
+    while (buf->readableBytes() > 0) {
+        if (chunkState_ == kChunkSize) {
+            const char* crlf = buf->findCRLF();
+            if (!crlf) {
+                if (buf->readableBytes() > kMaxChunkLineLength) {
+                    *error = true;
+                }
+                return false;
+            }
+            size_t size = 0;
+            if (!parseChunkSize(buf->peek(), crlf, &size)) {
+                LOG_ERROR << "invalid chunk size line";
+                *error = true;
+                return false;
+            }
+            buf->retrieveUntil(crlf + 2);
+            chunkRemaining_ = size;
+            chunkState_ = size == 0 ? kChunkTrailer : kChunkData;
+        } else if (chunkState_ == kChunkData) {
+            size_t toRead = std::min(buf->readableBytes(), chunkRemaining_);
+            if (!deliverBody(buf->peek(), toRead)) {
+                *error = true;
+                return false;
+            }
+            buf->retrieve(toRead);
+            chunkRemaining_ -= toRead;
+            if (chunkRemaining_ == 0) {
+                chunkState_ = kChunkDataEnd;
+            }
+        } else if (chunkState_ == kChunkDataEnd) {
+            if (buf->readableBytes() < 2) {
+                return false;
+            }
+            if (buf->peek()[0] != '\r' || buf->peek()[1] != '\n') {
+                LOG_ERROR << "missing CRLF after chunk data";
+                *error = true;
+                return false;
+            }
+            buf->retrieve(2);
+            chunkState_ = kChunkSize;
+        } else {  // kChunkTrailer
+            const char* crlf = buf->findCRLF();
+            if (!crlf) {
+                if (buf->readableBytes() > kMaxChunkLineLength) {
+                    *error = true;
+                }
+                return false;
+            }
+            bool lastLine = crlf == buf->peek();
+            // trailer字段不影响请求的处理，直接丢弃
+            buf->retrieveUntil(crlf + 2);
+            if (lastLine) {
+                LOG_DEBUG << "chunked body complete, bodyReceived_: " << bodyReceived_;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 // return false for error, true for success (got all or need more data)
 HttpContext::ParseResult HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime) {
     bool ok = true;
@@ -123,9 +262,11 @@ HttpContext::ParseResult HttpContext::parseRequest(Buffer* buf, Timestamp receiv
         if (state_ == kExpectRequestLine) {
             const char* crlf = buf->findCRLF();
             if (crlf) {
-                ok = processRequestLine(buf->peek(), crlf);
+                size_t lineBytes = static_cast<size_t>(crlf + 2 - buf->peek());
+                ok = checkHeaderSize(lineBytes) && processRequestLine(buf->peek(), crlf);
                 if (ok) {
                     request_.setReceiveTime(receiveTime);
+                    headerBytes_ = lineBytes;
                     buf->retrieveUntil(crlf + 2);
                     state_ = kExpectHeaders;
                 } else {
@@ -133,6 +274,9 @@ HttpContext::ParseResult HttpContext::parseRequest(Buffer* buf, Timestamp receiv
                     hasMore = false;
                 }
             } else {
+                if (!checkHeaderSize(buf->readableBytes())) {
+                    result = kError;
+                }
                 hasMore = false;
             }
         } else if (state_ == kExpectHeaders) {
@@ -145,14 +289,14 @@ HttpContext::ParseResult HttpContext::parseRequest(Buffer* buf, Timestamp receiv
                         result = kGotRequest;
                         hasMore = false;
                     } else {
-                        // 有请求体，继续处理
+                        // 有请求体，先返回让调用者有机会设置请求体回调，
+                        // 缓冲区中剩余的数据在下一次parseRequest时处理
                         result = kHeadersComplete;
-                        if (buf->readableBytes() > 0) {
-                            // 如果缓冲区还有数据，继续处理body
-                            continue;
-                        }
                         hasMore = false;
                     }
+                } else {
+                    // 头部还没收完（没有空行），等待更多数据
+                    hasMore = false;
                 }
             } else {
                 result = kError;
@@ -160,12 +304,12 @@ HttpContext::ParseResult HttpContext::parseRequest(Buffer* buf, Timestamp receiv
             }
         } else if (state_ == kExpectBody) {
             // 处理请求体
-            if (processBody(buf)) {
+            bool error = false;
+            if (processBody(buf, &error)) {
                 state_ = kGotAll;
                 result = kGotRequest;
-            } else if (bodyReceived_ < contentLength_) {
-                // 还需要更多数据
-                result = kHeadersComplete;
+            } else if (error) {
+                result = kError;
             }
             hasMore = false;
         }
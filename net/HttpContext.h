@@ -5,6 +5,7 @@
 #include "base/Logging.h"
 #include "base/copyable.h"
 #include "base/Timestamp.h"
+#include <functional>
 #include <memory>
 #include <unordered_map>
 
@@ -26,18 +27,43 @@ class HttpContext : public mymuduo::copyable
   {
     kError = -1,           // 解析出错
     kNeedMore = 0,         // 需要更多数据
-    kHeadersComplete = 1,  // 头部解析完成
+    kHeadersComplete = 1,  // 头部解析完成，请求体尚未读取（每个请求只返回一次）
     kGotRequest = 2        // 整个请求解析完成
   };
 
+  // chunked请求体的解码状态
+  enum ChunkState
+  {
+    kChunkSize,      // 等待chunk大小行
+    kChunkData,      // chunk数据
+    kChunkDataEnd,   // chunk数据之后的CRLF
+    kChunkTrailer,   // 最后一个chunk之后的trailer，以空行结束
+  };
+
+  // 请求行加全部头部行的默认长度上限
+  static const size_t kDefaultMaxHeaderSize = 64 * 1024;
+
   HttpContext()
     : state_(kExpectRequestLine),
       contentLength_(0),
       bodyReceived_(0),
-      isChunked_(false)
+      isChunked_(false),
+      chunkState_(kChunkSize),
+      chunkRemaining_(0),
+      headerBytes_(0),
+      headersTooLarge_(false),
+      maxHeaderSize_(kDefaultMaxHeaderSize),
+      maxBodySize_(0),
+      outputFull_(false),
+      headersPending_(false),
+      bodyPaused_(false)
   {
   }
 
+  // 请求体回调：设置后请求体不再追加到HttpRequest::body_，而是原地交给回调，
+  // 用于上传等大请求体的流式处理。返回false表示处理失败，本次解析返回kError
+  using BodyCallback = std::function<bool (const char* data, size_t len)>;
+
   ~HttpContext()
   {
     LOG_INFO << "HttpContext destroyed";
@@ -64,6 +90,22 @@ class HttpContext : public mymuduo::copyable
   bool isChunked() const
   { return isChunked_; }
 
+  // 没有流式回调的请求体整个保存在HttpRequest::body_中，超过上限的请求被拒绝，0表示不限制；不随reset清除。
+  // chunked请求体事先不知道长度，超过上限时解析返回kError
+  void setMaxBodySize(size_t bytes)
+  { maxBodySize_ = bytes; }
+
+  // 请求行加头部达到maxHeaderSize字节仍没有结束时解析返回kError，此时headersTooLarge()为true。上限不随reset清除
+  void setMaxHeaderSize(size_t bytes)
+  { maxHeaderSize_ = bytes; }
+
+  bool headersTooLarge() const
+  { return headersTooLarge_; }
+
+  // 头部解析完成后调用：Content-Length超过上限，且请求体没有交给流式回调
+  bool bodyTooLarge() const
+  { return maxBodySize_ > 0 && !bodyCallback_ && contentLength_ > maxBodySize_; }
+
   void reset()
   {
     state_ = kExpectRequestLine;
@@ -72,7 +114,14 @@ class HttpContext : public mymuduo::copyable
     contentLength_ = 0;
     bodyReceived_ = 0;
     isChunked_ = false;
+    chunkState_ = kChunkSize;
+    chunkRemaining_ = 0;
+    headerBytes_ = 0;
+    headersTooLarge_ = false;
     customContext_.reset();
+    bodyCallback_ = BodyCallback();
+    headersPending_ = false;
+    bodyPaused_ = false;
   }
 
   const HttpRequest& request() const
@@ -83,6 +132,24 @@ class HttpContext : public mymuduo::copyable
 
   HttpRequestParseState state() const { return state_; }
 
+  // 连接上最近一次收到数据或发完响应的时间，用于关闭空闲的keep-alive连接，不随reset清除
+  void setLastActive(Timestamp when) { lastActive_ = when; }
+  Timestamp lastActive() const { return lastActive_; }
+
+  // 连接的输出队列超过高水位、等待发出期间为true，此时不再读取新的请求，不随reset清除
+  void setOutputFull(bool full) { outputFull_ = full; }
+  bool outputFull() const { return outputFull_; }
+
+  // HeadersCallback推迟了决定（例如到线程池中查询数据库）、等待HttpServer::resumeHeaders期间为true，
+  // 此时请求体和后续数据都留在输入缓冲区中
+  void setHeadersPending(bool pending) { headersPending_ = pending; }
+  bool headersPending() const { return headersPending_; }
+
+  // 请求体回调的消费者积压过多（例如写盘队列超过上限）时设为true，HttpServer暂停读取，
+  // 消费者赶上之后调用HttpServer::resumeBody恢复
+  void setBodyPaused(bool paused) { bodyPaused_ = paused; }
+  bool bodyPaused() const { return bodyPaused_; }
+
   template<typename T>
   std::shared_ptr<T> getContext() const {
     return std::static_pointer_cast<T>(customContext_);
@@ -92,17 +159,34 @@ class HttpContext : public mymuduo::copyable
     customContext_ = context;
   }
 
+  void setBodyCallback(const BodyCallback& cb)
+  { bodyCallback_ = cb; }
+
  private:
   bool processRequestLine(const char* begin, const char* end);
   bool processHeaders(Buffer* buf);
-  bool processBody(Buffer* buf);
+  bool processBody(Buffer* buf, bool* error);
+  bool processChunkedBody(Buffer* buf, bool* error);
+  bool deliverBody(const char* data, size_t len);
+  bool checkHeaderSize(size_t pending);
 
   HttpRequestParseState state_ = HttpRequestParseState::kExpectRequestLine;
   HttpRequest request_;
   size_t contentLength_;  // 用于存储 Content-Length 的值
   size_t bodyReceived_;   // 已接收的 body 长度
   bool isChunked_;        // 是否为 chunked 传输
+  ChunkState chunkState_; // chunked 解码状态
+  size_t chunkRemaining_; // 当前 chunk 还没收到的数据长度
+  size_t headerBytes_;    // 已经解析的请求行和头部行的字节数
+  bool headersTooLarge_;  // 请求行加头部是否超过上限
+  size_t maxHeaderSize_;  // 请求行加头部的长度上限
   std::shared_ptr<void> customContext_;  // 自定义上下文存储
+  BodyCallback bodyCallback_;            // 流式请求体回调
+  Timestamp lastActive_;                 // 最近活跃时间
+  size_t maxBodySize_;                   // 保存在body_中的请求体上限，0表示不限制
+  bool outputFull_;                      // 输出队列是否超过高水位
+  bool headersPending_;                  // 是否在等待HeadersCallback的异步决定
+  bool bodyPaused_;                      // 请求体的消费者是否要求暂停读取
 };
 
 } // namespace net
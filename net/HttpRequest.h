@@ -4,6 +4,7 @@
 #include <string>
 #include <assert.h>
 #include <unordered_map>
+#include <vector>
 #include "base/copyable.h"
 #include "base/Timestamp.h"
 #include "base/Logging.h"
@@ -21,9 +22,13 @@ class HttpRequest : public mymuduo::copyable
     kUnknown, kHttp10, kHttp11
   };
 
+  // 单个请求最多的路径参数个数
+  static const size_t kMaxPathParams = 8;
+
   HttpRequest()
     : method_(kInvalid),
-      version_(kUnknown)
+      version_(kUnknown),
+      numPathParams_(0)
   {
   }
 
@@ -163,6 +168,8 @@ class HttpRequest : public mymuduo::copyable
     body_.swap(that.body_);
     receiveTime_.swap(that.receiveTime_);
     headers_.swap(that.headers_);
+    std::swap(pathParams_, that.pathParams_);
+    std::swap(numPathParams_, that.numPathParams_);
   }
 
   // 获取查询参数
@@ -200,16 +207,30 @@ class HttpRequest : public mymuduo::copyable
   
   // 获取路径参数
   std::string getPathParam(const std::string& name) const {
-    auto it = pathParams_.find(name);
-    if (it != pathParams_.end()) {
-      return it->second;
+    for (size_t i = 0; i < numPathParams_; ++i) {
+      if (*pathParams_[i].name == name) {
+        return path_.substr(pathParams_[i].offset, pathParams_[i].len);
+      }
     }
     return "";
   }
-  
-  // 设置路径参数
-  void setPathParams(const std::unordered_map<std::string, std::string>& params) {
-    pathParams_ = params;
+
+  // 设置路径参数（由RouteTrie在匹配时调用）
+  // name指向路由表中的字符串，值只记录在path_中的位置，匹配过程不分配内存
+  void clearPathParams()
+  { numPathParams_ = 0; }
+
+  bool addPathParam(const std::string* name, size_t offset, size_t len)
+  {
+    if (numPathParams_ >= kMaxPathParams)
+    {
+      return false;
+    }
+    pathParams_[numPathParams_].name = name;
+    pathParams_[numPathParams_].offset = offset;
+    pathParams_[numPathParams_].len = len;
+    ++numPathParams_;
+    return true;
   }
   
   // URL解码函数（简化版）
@@ -246,8 +267,15 @@ class HttpRequest : public mymuduo::copyable
   string body_;
   Timestamp receiveTime_;
   std::map<string, string> headers_;
-  // 添加路径参数存储
-  std::unordered_map<std::string, std::string> pathParams_;
+  // 路径参数
+  struct PathParam
+  {
+    const std::string* name;
+    size_t offset;
+    size_t len;
+  };
+  PathParam pathParams_[kMaxPathParams];
+  size_t numPathParams_;
 };
 
 
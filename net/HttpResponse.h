@@ -3,39 +3,56 @@
 #include <map>
 #include <string>
 #include "Buffer.h"
+#include "Callbacks.h"
+#include "ContentEncoding.h"
 #include <functional>
+#include <memory>
+#include <vector>
+#include <sys/types.h>
+#include <unistd.h>
 
 namespace mymuduo {
 namespace net {
 
 class HttpResponse {
 public:
-    // 定义响应回调函数类型
-    using ResponseCallback = std::function<void(const HttpResponse&)>;
+    // 文件响应体中的一段：fd有效时直接发送，否则在轮到它时打开path
+    struct FileSegment {
+        int fd;
+        std::string path;
+        off_t offset;
+        size_t length;
+    };
 
     enum HttpStatusCode {
         kUnknown = 0,
         k200Ok = 200,
         k206PartialContent = 206,
         k301MovedPermanently = 301,
+        k304NotModified = 304,
         k400BadRequest = 400,
         k401Unauthorized = 401,
         k403Forbidden = 403,
         k404NotFound = 404,
+        k409Conflict = 409,
         k416RangeNotSatisfiable = 416, //客户端请求的资源范围无效或无法满足
         k500InternalServerError = 500,
     };
 
     explicit HttpResponse(bool close)
         : statusCode_(kUnknown),
-          closeConnection_(close),
-          async_(false)
+          closeConnection_(close)
     {
     }
     ~HttpResponse() {
+        clearFileBody();
         LOG_INFO << "HttpResponse::~HttpResponse()";
     }
 
+    // 持有文件描述符，禁止拷贝
+    HttpResponse(const HttpResponse&) = delete;
+    HttpResponse& operator=(const HttpResponse&) = delete;
+
     void setStatusCode(HttpStatusCode code) { statusCode_ = code; }
     void setStatusMessage(const std::string& message) { statusMessage_ = message; }
     void setCloseConnection(bool on) { closeConnection_ = on; }
@@ -43,17 +60,82 @@ public:
 
     void setContentType(const std::string& contentType) { addHeader("Content-Type", contentType); }
     void addHeader(const std::string& key, const std::string& value) { headers_[key] = value; }
-    void setBody(const std::string& body) { body_ = body; }
+    void setBody(std::string body) {
+        body_ = std::move(body);
+        sharedBody_.reset();
+    }
+    // 使用共享的响应体（例如缓存中的静态资源），发送时不拷贝
+    void setBody(std::shared_ptr<const std::string> body) {
+        body_.clear();
+        sharedBody_ = std::move(body);
+    }
+    size_t bodySize() const { return sharedBody_ ? sharedBody_->size() : body_.size(); }
+    // 取走内存中的响应体，交给TcpConnection::send排队发送；没有响应体时返回空指针
+    std::shared_ptr<const std::string> releaseBody() {
+        std::shared_ptr<const std::string> body;
+        if (sharedBody_) {
+            body.swap(sharedBody_);
+        } else if (!body_.empty()) {
+            body = std::make_shared<const std::string>(std::move(body_));
+            body_.clear();
+        }
+        return body;
+    }
 
-    // 设置为异步响应
-    void setAsync(bool async) { async_ = async; }
-    bool isAsync() const { return async_; }
+    // 设置文件响应体：头部发送后由TcpConnection::sendFile零拷贝发送文件区间
+    // fd的所有权转移给HttpResponse，未发送时在析构中关闭
+    void setFileBody(int fd, off_t offset, size_t len) {
+        clearFileBody();
+        fileSegments_.push_back(FileSegment{fd, std::string(), offset, len});
+    }
+    // 在文件响应体末尾追加path中的一段，文件在发送到这一段时才打开
+    void addFileSegment(const std::string& path, off_t offset, size_t len) {
+        fileSegments_.push_back(FileSegment{-1, path, offset, len});
+    }
+    // 设置流式响应体：头部发送后由TcpConnection::sendStream逐段生成并发送，
+    // 处理函数需要自己设置Content-Length
+    void setBodyStream(const BodyProducer& producer) { bodyStream_ = producer; }
+    bool hasBodyStream() const { return static_cast<bool>(bodyStream_); }
+    BodyProducer releaseBodyStream() {
+        BodyProducer producer;
+        producer.swap(bodyStream_);
+        return producer;
+    }
 
-    // 设置响应回调
-    void setResponseCallback(const ResponseCallback& cb) { responseCallback_ = cb; }
-    const ResponseCallback& getResponseCallback() const { return responseCallback_; }
+    bool hasFileBody() const { return !fileSegments_.empty(); }
+    // 取走文件响应体，其中的文件描述符之后由调用者负责关闭
+    std::vector<FileSegment> releaseFileBody() {
+        std::vector<FileSegment> segments;
+        segments.swap(fileSegments_);
+        return segments;
+    }
 
-    void appendToBuffer(Buffer* output) const {
+    // 按请求的Accept-Encoding压缩内存中的响应体，返回是否压缩
+    // 响应体小于minSize、类型不值得压缩、已经编码或处理函数自己设置了Content-Length时不处理
+    bool encodeBody(const std::string& acceptEncoding, size_t minSize) {
+        if (sharedBody_ || body_.size() < minSize || hasFileBody() || hasBodyStream() ||
+            headers_.count("Content-Encoding") || headers_.count("Content-Length")) {
+            return false;
+        }
+        auto type = headers_.find("Content-Type");
+        if (type == headers_.end() || !ContentEncoding::compressibleType(type->second)) {
+            return false;
+        }
+        // 同一个URL的响应随Accept-Encoding变化，缓存需要区分
+        addHeader("Vary", "Accept-Encoding");
+        ContentEncoding::Coding coding = ContentEncoding::negotiate(acceptEncoding);
+        std::string encoded;
+        if (coding == ContentEncoding::kIdentity ||
+            !ContentEncoding::encode(coding, body_, &encoded) || encoded.size() >= body_.size()) {
+            return false;
+        }
+        body_.swap(encoded);
+        addHeader("Content-Encoding", ContentEncoding::name(coding));
+        return true;
+    }
+
+    // 状态行和头部，响应体由调用者另外发送
+    void appendHeadersToBuffer(Buffer* output) const {
         char buf[32];
         snprintf(buf, sizeof(buf), "HTTP/1.1 %d ", statusCode_);
         output->append(buf);
@@ -66,6 +148,13 @@ public:
             output->append("Connection: Keep-Alive\r\n");
         }
 
+        // 保持连接时客户端靠Content-Length确定响应的边界；
+        // 文件响应体、流式响应体和HEAD响应由处理函数自己设置；304响应没有响应体
+        if (statusCode_ != k304NotModified && !hasFileBody() && !hasBodyStream() && headers_.find("Content-Length") == headers_.end()) {
+            snprintf(buf, sizeof(buf), "Content-Length: %zu\r\n", bodySize());
+            output->append(buf);
+        }
+
         for (const auto& header : headers_) {
             output->append(header.first);
             output->append(": ");
@@ -74,17 +163,35 @@ public:
         }
 
         output->append("\r\n");
-        output->append(body_);
+    }
+
+    void appendToBuffer(Buffer* output) const {
+        appendHeadersToBuffer(output);
+        if (sharedBody_) {
+            output->append(*sharedBody_);
+        } else {
+            output->append(body_);
+        }
     }
 
 private:
+    void clearFileBody() {
+        for (const FileSegment& segment : fileSegments_) {
+            if (segment.fd >= 0) {
+                ::close(segment.fd);
+            }
+        }
+        fileSegments_.clear();
+    }
+
     std::map<std::string, std::string> headers_;
     HttpStatusCode statusCode_;
     std::string statusMessage_;
     bool closeConnection_;
     std::string body_;
-    bool async_;                    // 是否为异步响应
-    ResponseCallback responseCallback_;  // 响应回调函数
+    std::shared_ptr<const std::string> sharedBody_;  // 非空时代替body_
+    std::vector<FileSegment> fileSegments_;  // 文件响应体，按顺序在头部之后发送
+    BodyProducer bodyStream_;                // 流式响应体，在文件响应体之后发送
 }; // class HttpResponse
 
 } // namespace net
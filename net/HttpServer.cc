@@ -1,6 +1,12 @@
 #include "HttpServer.h"
+#include "EventLoop.h"
+#include "TimerId.h"
+#include "base/CountDownLatch.h"
 #include "base/Logging.h"
 
+#include <algorithm>
+#include <strings.h>
+
 using namespace mymuduo;
 using namespace mymuduo::net;
 
@@ -21,21 +27,170 @@ bool defaultHttpCallback(const TcpConnectionPtr&, const HttpRequest&, HttpRespon
 
 HttpServer::HttpServer(EventLoop* loop,
                      const InetAddress& listenAddr,
-                     const std::string& name)
-    : server_(loop, listenAddr, name),
+                     const std::string& name,
+                     TcpServer::Option option)
+    : server_(loop, listenAddr, name, option),
+      listenAddr_(listenAddr),
+      option_(option),
+      numThreads_(0),
+      edgeTriggered_(false),
+      idleTimeout_(kDefaultIdleTimeout),
+      compressionMinSize_(0),
+      maxBufferedInput_(kDefaultMaxBufferedInput),
+      outputHighWaterMark_(kDefaultOutputHighWaterMark),
+      maxBodySize_(kDefaultMaxBodySize),
+      maxHeaderSize_(HttpContext::kDefaultMaxHeaderSize),
       httpCallback_(detail::defaultHttpCallback)
 {
-    server_.setConnectionCallback(
+}
+
+HttpServer::~HttpServer() {
+    // reactor上的TcpServer（及其Acceptor、连接）必须在各自的loop线程中销毁，
+    // 并且要在reactorPool_退出这些loop之前完成
+    if (!reactorServers_.empty()) {
+        CountDownLatch latch(static_cast<int>(reactorServers_.size()));
+        for (auto& server : reactorServers_) {
+            TcpServer* raw = server.release();
+            raw->getLoop()->runInLoop([raw, &latch]() {
+                delete raw;
+                latch.countDown();
+            });
+        }
+        latch.wait();
+    }
+}
+
+void HttpServer::setupServer(TcpServer* server) {
+    server->setEdgeTriggered(edgeTriggered_);
+    server->setConnectionCallback(
         std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
-    server_.setMessageCallback(
+    server->setMessageCallback(
         std::bind(&HttpServer::onMessage, this, std::placeholders::_1,
                  std::placeholders::_2, std::placeholders::_3));
+    server->setWriteCompleteCallback(
+        std::bind(&HttpServer::onWriteComplete, this, std::placeholders::_1));
+}
+
+void HttpServer::start() {
+    setupServer(&server_);
+    if (option_ == TcpServer::kReusePort) {
+        // loop上的server_只负责自己accept到的连接
+        server_.setThreadInitCallback(threadInitCallback_);
+        startReactors();
+    } else {
+        server_.setThreadNum(numThreads_);
+        server_.setThreadInitCallback(threadInitCallback_);
+    }
+    server_.start();
+}
+
+void HttpServer::startReactors() {
+    if (numThreads_ <= 0) {
+        return;
+    }
+    EventLoop* baseLoop = server_.getLoop();
+    reactorPool_.reset(new EventLoopThreadPool(baseLoop, server_.name() + "-reactor"));
+    reactorPool_->setThreadNum(numThreads_);
+    reactorPool_->start(threadInitCallback_);
+
+    int index = 0;
+    for (EventLoop* ioLoop : reactorPool_->getAllLoops()) {
+        // 每个reactor绑定一个新的SO_REUSEPORT监听socket，不再有单一的accept线程
+        std::unique_ptr<TcpServer> server(new TcpServer(
+            ioLoop, listenAddr_, server_.name() + "#" + std::to_string(++index),
+            TcpServer::kReusePort));
+        setupServer(server.get());
+        // TcpServer::start需要在所属loop的线程中调用
+        TcpServer* raw = server.get();
+        ioLoop->runInLoop([raw]() { raw->start(); });
+        reactorServers_.push_back(std::move(server));
+    }
+    LOG_INFO << "HttpServer [" << server_.name() << "] started "
+             << reactorServers_.size() << " SO_REUSEPORT reactors";
+}
+
+void HttpServer::addRoute(HttpRequest::Method method, const std::string& pattern,
+                          const HttpCallback& cb) {
+    router_.addRoute(method, pattern, static_cast<int>(routeHandlers_.size()));
+    routeHandlers_.push_back(cb);
 }
 
 void HttpServer::onConnection(const TcpConnectionPtr& conn) {
     if (conn->connected()) {
         auto context = std::make_shared<HttpContext>();
+        context->setLastActive(Timestamp::now());
+        context->setMaxBodySize(maxBodySize_);
+        // 没有收完的头部留在输入缓冲区中，达到maxBufferedInput之前必须先报错，否则暂停读取后再也等不到空行
+        context->setMaxHeaderSize(std::min(maxHeaderSize_, maxBufferedInput_));
         conn->setContext(context);
+        if (idleTimeout_ > 0) {
+            scheduleIdleCheck(conn, idleTimeout_);
+        }
+    }
+    if (connectionCallback_) {
+        connectionCallback_(conn);
+    }
+}
+
+void HttpServer::onWriteComplete(const TcpConnectionPtr& conn) {
+    // 大文件发送期间不算空闲，从发送完成时重新计时
+    auto context = std::static_pointer_cast<HttpContext>(conn->getContext());
+    if (context) {
+        context->setLastActive(Timestamp::now());
+        if (context->outputFull()) {
+            context->setOutputFull(false);
+            // 暂停期间留在输入缓冲区中的请求现在才解析
+            Buffer* input = conn->inputBuffer();
+            if (input->readableBytes() > 0) {
+                onMessage(conn, input, Timestamp::now());
+            }
+            updateReading(conn, context.get());
+        }
+    }
+}
+
+// 输入积压或输出队列超过高水位时暂停读取。积压只检查缓冲区大小而不看解析状态：
+// 正在解析时缓冲区会被消耗掉，剩下的不完整头部或chunk大小行都有各自的上限
+void HttpServer::updateReading(const TcpConnectionPtr& conn, HttpContext* context) {
+    bool inputBacklog = conn->inputBuffer()->readableBytes() >= maxBufferedInput_;
+    if (inputBacklog || context->outputFull() || context->bodyPaused()) {
+        if (conn->isReading()) {
+            conn->stopRead();
+        }
+    } else if (!conn->isReading()) {
+        conn->startRead();
+    }
+}
+
+void HttpServer::scheduleIdleCheck(const TcpConnectionPtr& conn, double delay) {
+    std::weak_ptr<TcpConnection> weakConn(conn);
+    conn->getLoop()->runAfter(delay, std::bind(&HttpServer::onIdleCheck, this, weakConn));
+}
+
+// 每个连接同时只有一个空闲检查定时器，收到数据时只更新lastActive，不重设定时器
+void HttpServer::onIdleCheck(const std::weak_ptr<TcpConnection>& weakConn) {
+    TcpConnectionPtr conn = weakConn.lock();
+    if (!conn || !conn->connected()) {
+        return;
+    }
+    auto context = std::static_pointer_cast<HttpContext>(conn->getContext());
+    if (!context) {
+        return;
+    }
+
+    // 请求还在异步处理中，或者响应还没发完，都不算空闲
+    if (context->gotAll() || context->headersPending() || conn->hasPendingWrite()) {
+        scheduleIdleCheck(conn, idleTimeout_);
+        return;
+    }
+
+    double idle = timeDifference(Timestamp::now(), context->lastActive());
+    if (idle >= idleTimeout_) {
+        LOG_INFO << "HttpServer closing idle connection " << conn->name()
+                 << " after " << idle << "s";
+        conn->forceClose();
+    } else {
+        scheduleIdleCheck(conn, idleTimeout_ - idle);
     }
 }
 
@@ -48,72 +203,210 @@ void HttpServer::onMessage(const TcpConnectionPtr& conn,
         LOG_INFO << "context is null";
         return;
     }
+    context->setLastActive(receiveTime);
 
-    HttpContext::ParseResult result = context->parseRequest(buf, receiveTime);
-    LOG_INFO << "result = " << result;
-    if (result == HttpContext::kError) {  // 解析出错
-        conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-        conn->shutdown();
-        return;
-    }
+    // 一次读到的数据里可能有多个流水线请求，按顺序逐个处理
+    while (buf->readableBytes() > 0) {
+        if (!conn->connected()) {
+            // 已经决定关闭连接（请求出错、被拒绝或Connection: close），丢弃对端继续发来的数据
+            buf->retrieveAll();
+            return;
+        }
+
+        if (context->gotAll() || context->headersPending()) {
+            // 上一个请求还在异步处理中，新数据留在缓冲区，由sendResponse或resumeHeaders处理完后再解析；
+            // 积压太多时暂停读取
+            updateReading(conn, context.get());
+            return;
+        }
+
+        if (conn->pendingOutputBytes() >= outputHighWaterMark_) {
+            // 客户端接收得慢（例如流水线发来大量请求却不读取响应），响应发出之前不再解析新的请求
+            LOG_INFO << "HttpServer pausing " << conn->name() << ", "
+                     << conn->pendingOutputBytes() << " bytes waiting to be sent";
+            context->setOutputFull(true);
+            updateReading(conn, context.get());
+            return;
+        }
+
+        HttpContext::ParseResult result = context->parseRequest(buf, receiveTime);
+        LOG_DEBUG << "result = " << result;
 
-    if (result == HttpContext::kHeadersComplete) {  // 头部解析完成
-        // 如果是大文件上传，在这里就可以开始处理了
-        if (context->expectBody()) {
-            HttpRequest& req = context->request();  // 改为非const引用
-            // 检查是否是文件上传请求
-            if (req.path() == "/upload" && req.method() == HttpRequest::kPost) {
-                // 检查body数据大小
-                size_t bufSize = req.body().size();  //这个才是对的
-                // LOG_INFO << "bufSize = " << bufSize;
-                if (bufSize >= 1024 * 1024) {  // 如果数据超过1MB
-                    // LOG_INFO << "Buffer size exceeds 1MB, processing chunk";
-                    HttpResponse response(false);  // 不关闭连接
-                    bool syncProcessed = httpCallback_(conn, req, &response);
-                    if (!syncProcessed) {
-                        // 异步处理，不重置 context
-                        LOG_INFO << "Async upload chunk processing";
-                        return;
-                    } else {
-                        LOG_INFO << "Sync upload chunk processed";
-                    }
-                }
+        if (result == HttpContext::kHeadersComplete) {  // 头部解析完成，请求体尚未读取
+            HttpResponse response(true);
+            HeadersResult headers = kHeadersAccept;
+            if (headersCallback_) {
+                headers = headersCallback_(conn, context->request(), &response);
             }
+            if (!acceptHeaders(conn, context.get(), headers, response)) {
+                return;
+            }
+            // 继续解析缓冲区中已经到达的请求体
+            result = context->parseRequest(buf, receiveTime);
         }
-    } else if (result == HttpContext::kGotRequest) {  // 整个请求解析完成
-        bool syncProcessed = onRequest(conn, context->request());
-        if (syncProcessed) {
-            LOG_INFO << "context->reset()";
-            context->reset();
+
+        if (result == HttpContext::kError) {  // 解析出错
+            if (context->headersTooLarge()) {
+                conn->send("HTTP/1.1 431 Request Header Fields Too Large\r\n"
+                           "Content-Length: 0\r\nConnection: close\r\n\r\n");
+                conn->shutdown();
+                return;
+            }
+            conn->send("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            conn->shutdown();
+            return;
         }
-    } else {
-        LOG_INFO << "need more data";
+
+        if (result != HttpContext::kGotRequest) {
+            LOG_DEBUG << "need more data";
+            updateReading(conn, context.get());
+            return;
+        }
+
+        // 整个请求解析完成；异步处理时由sendResponse发送响应后再继续
+        if (!onRequest(conn, context->request())) {
+            return;
+        }
+        // reset只清理请求状态，缓冲区中剩余的字节属于下一个请求
+        context->reset();
+    }
+}
+
+bool HttpServer::acceptHeaders(const TcpConnectionPtr& conn, HttpContext* context,
+                               HeadersResult result, const HttpResponse& resp) {
+    if (result == kHeadersPending) {
+        context->setHeadersPending(true);
+        updateReading(conn, context);
+        return false;
+    }
+    if (result == kHeadersReject) {
+        // 请求体没有读取，连接上的后续数据无法再按请求边界解析，只能关闭
+        Buffer out;
+        resp.appendToBuffer(&out);
+        conn->send(&out);
+        conn->shutdown();
+        return false;
     }
-    LOG_DEBUG << "onMessage end";
+    if (context->bodyTooLarge()) {
+        conn->send("HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        conn->shutdown();
+        return false;
+    }
+    return true;
+}
+
+void HttpServer::resumeHeaders(const TcpConnectionPtr& conn, const HeadersCallback& cb) {
+    conn->getLoop()->runInLoop(
+        std::bind(&HttpServer::resumeHeadersInLoop, this, conn, cb));
+}
+
+void HttpServer::resumeHeadersInLoop(const TcpConnectionPtr& conn, const HeadersCallback& cb) {
+    conn->getLoop()->assertInLoopThread();
+    auto context = std::static_pointer_cast<HttpContext>(conn->getContext());
+    if (!conn->connected() || !context || !context->headersPending()) {
+        return;
+    }
+    context->setHeadersPending(false);
+    HttpResponse response(true);
+    if (!acceptHeaders(conn, context.get(), cb(conn, context->request(), &response), response)) {
+        return;
+    }
+    // 等待期间到达的请求体现在才开始解析
+    Buffer* input = conn->inputBuffer();
+    if (input->readableBytes() > 0) {
+        onMessage(conn, input, Timestamp::now());
+    }
+    updateReading(conn, context.get());
+}
+
+void HttpServer::resumeBody(const TcpConnectionPtr& conn) {
+    conn->getLoop()->runInLoop(std::bind(&HttpServer::resumeBodyInLoop, this, conn));
+}
+
+void HttpServer::resumeBodyInLoop(const TcpConnectionPtr& conn) {
+    conn->getLoop()->assertInLoopThread();
+    auto context = std::static_pointer_cast<HttpContext>(conn->getContext());
+    if (!conn->connected() || !context || !context->bodyPaused()) {
+        return;
+    }
+    context->setBodyPaused(false);
+    updateReading(conn, context.get());
 }
 
 bool HttpServer::onRequest(const TcpConnectionPtr& conn, HttpRequest& req) {
     // LOG_DEBUG << "onRequest start";
+    // HTTP/1.1默认保持连接，HTTP/1.0需要显式的Connection: Keep-Alive
     const std::string& connection = req.getHeader("Connection");
-    bool close = connection == "close" ||
-        (req.getVersion() == HttpRequest::kHttp10 && connection != "Keep-Alive");
+    bool close = ::strcasecmp(connection.c_str(), "close") == 0 ||
+        (req.getVersion() == HttpRequest::kHttp10 &&
+         ::strcasecmp(connection.c_str(), "Keep-Alive") != 0);
     HttpResponse response(close);
 
-    // 调用用户的回调函数处理请求
-    bool syncProcessed = httpCallback_(conn, req, &response);
+    // 先按路由表分发，没有匹配的路由时调用用户的回调函数
+    int route = router_.match(req);
+    const HttpCallback& callback = route == RouteTrie::kNoRoute ? httpCallback_ : routeHandlers_[static_cast<size_t>(route)];
+    bool syncProcessed = callback(conn, req, &response);
 
-    // 如果是同步处理完成，或者不是异步响应，直接发送响应
+    // 同步处理完成时直接发送响应，异步处理的请求由sendResponse完成
     if (syncProcessed) {
-        Buffer buf;
-        response.appendToBuffer(&buf);
-        conn->send(&buf);
-        if (response.closeConnection()) {
-            conn->shutdown();
-        }
+        writeResponse(conn, &response);
         LOG_INFO << "Sync request completed";
     } else {
         LOG_INFO << "Async request, waiting for response";
     }
     
     return syncProcessed;
+}
+
+void HttpServer::writeResponse(const TcpConnectionPtr& conn, HttpResponse* resp) {
+    if (compressionMinSize_ > 0) {
+        // 请求在响应发送之后才被reset，此时仍可读取它的头部
+        auto context = std::static_pointer_cast<HttpContext>(conn->getContext());
+        if (context) {
+            resp->encodeBody(context->request().getHeader("Accept-Encoding"), compressionMinSize_);
+        }
+    }
+    // 头部和响应体作为两段排入输出队列，用一次writev发出，响应体不再拷贝
+    Buffer buf;
+    resp->appendHeadersToBuffer(&buf);
+    conn->send({std::make_shared<const std::string>(buf.retrieveAllAsString()), resp->releaseBody()});
+    for (const HttpResponse::FileSegment& segment : resp->releaseFileBody()) {
+        if (segment.fd >= 0) {
+            conn->sendFile(segment.fd, segment.offset, segment.length);
+        } else {
+            conn->sendFile(segment.path, segment.offset, segment.length);
+        }
+    }
+    if (resp->hasBodyStream()) {
+        conn->sendStream(resp->releaseBodyStream());
+    }
+    if (resp->closeConnection()) {
+        conn->shutdown();
+    }
+}
+
+void HttpServer::sendResponse(const TcpConnectionPtr& conn, const std::shared_ptr<HttpResponse>& resp) {
+    conn->getLoop()->runInLoop(
+        std::bind(&HttpServer::sendResponseInLoop, this, conn, resp));
+}
+
+void HttpServer::sendResponseInLoop(const TcpConnectionPtr& conn, const std::shared_ptr<HttpResponse>& resp) {
+    conn->getLoop()->assertInLoopThread();
+    if (!conn->connected()) {
+        // 处理期间连接已经断开，resp析构时关闭其中的文件描述符
+        LOG_INFO << "Async response dropped, connection " << conn->name() << " is gone";
+        return;
+    }
+    writeResponse(conn, resp.get());
+
+    auto context = std::static_pointer_cast<HttpContext>(conn->getContext());
+    if (context) {
+        context->reset();
+        // 异步处理期间到达的数据（例如流水线中的下一个请求）现在才开始解析
+        Buffer* input = conn->inputBuffer();
+        if (input->readableBytes() > 0) {
+            onMessage(conn, input, Timestamp::now());
+        }
+        updateReading(conn, context.get());
+    }
 } 
\ No newline at end of file
@@ -1,37 +1,137 @@
 #pragma once
 
 #include "TcpServer.h"
+#include "EventLoopThreadPool.h"
 #include "HttpContext.h"
 #include "HttpRequest.h"
 #include "HttpResponse.h"
+#include "RouteTrie.h"
 
 #include <functional>
+#include <memory>
+#include <vector>
 
 namespace mymuduo {
 namespace net {
 
 class HttpServer {
 public:
+    // 返回true表示同步处理完成，resp随即发送；返回false表示请求仍在处理中
+    // （例如交给了ThreadPool），处理完成后调用sendResponse发送响应
     using HttpCallback = std::function<bool (const TcpConnectionPtr&, HttpRequest&, HttpResponse*)>;
+    // HeadersCallback的结果
+    enum HeadersResult {
+        kHeadersAccept,   // 继续读取请求体
+        kHeadersReject,   // 拒绝该请求，resp会被发送并关闭连接
+        kHeadersPending,  // 稍后决定（例如需要查询数据库），决定后调用resumeHeaders
+    };
+    // 请求头解析完成、请求体尚未读取时调用，可以通过HttpContext::setBodyCallback
+    // 以流式方式接管请求体
+    using HeadersCallback = std::function<HeadersResult (const TcpConnectionPtr&, HttpRequest&, HttpResponse*)>;
 
+    // option为kReusePort时，setThreadNum(n)启动n个独立的reactor，每个reactor
+    // 有自己的SO_REUSEPORT监听socket，由内核把新连接分散到各个线程，
+    // 连接在哪个线程accept就在哪个线程处理；loop本身也监听同一端口。
+    // 默认的kNoReusePort模式下由loop统一accept，再轮询分发给IO线程
     HttpServer(EventLoop* loop,
               const InetAddress& listenAddr,
-              const std::string& name);
+              const std::string& name,
+              TcpServer::Option option = TcpServer::kNoReusePort);
+    ~HttpServer();
 
     void setHttpCallback(const HttpCallback& cb) { httpCallback_ = cb; }
-    void setConnectionCallback(const ConnectionCallback& cb) { server_.setConnectionCallback(cb); }
-    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
-    void start() { server_.start(); }
+    void setHeadersCallback(const HeadersCallback& cb) { headersCallback_ = cb; }
+
+    // 注册路由，pattern中以':'开头的段是路径参数，如 /download/:filename，
+    // 处理函数中用HttpRequest::getPathParam取值。没有匹配的路由时调用HttpCallback。
+    // 必须在start()之前调用
+    void addRoute(HttpRequest::Method method, const std::string& pattern, const HttpCallback& cb);
+    // 在HttpServer为连接创建好HttpContext之后调用
+    void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
+    // 连接保持（keep-alive）时的空闲超时（秒），超时没有新请求的连接被关闭，0表示不关闭。
+    // 必须在start()之前调用
+    void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+    // 不小于minSize字节的文本、JSON等响应体按请求的Accept-Encoding压缩（gzip，可用时br），
+    // 0表示不压缩（默认）。已经设置Content-Encoding的响应（例如预先压缩的静态资源）不受影响
+    void setCompressionMinSize(size_t minSize) { compressionMinSize_ = minSize; }
+    // 流量控制，必须在start()之前调用：
+    // 输入缓冲区中积压的数据超过maxBufferedInput时暂停读取（例如请求异步处理期间流水线发来的后续数据），
+    // 积压的数据被解析后恢复。请求头的上限不会超过maxBufferedInput，因此不会在头部收完之前暂停；
+    // 待发送的响应数据超过outputHighWaterMark时暂停解析和读取新的请求，全部发出后恢复。
+    // 暂停期间数据留在内核中，TCP窗口关闭后对端停止发送
+    void setMaxBufferedInput(size_t bytes) { maxBufferedInput_ = bytes; }
+    void setOutputHighWaterMark(size_t bytes) { outputHighWaterMark_ = bytes; }
+    // 没有被HeadersCallback以流式方式接管的请求体的大小上限，超过时返回413并关闭连接，0表示不限制
+    void setMaxBodySize(size_t bytes) { maxBodySize_ = bytes; }
+    // 请求行加全部头部行的大小上限，超过时返回431并关闭连接
+    void setMaxHeaderSize(size_t bytes) { maxHeaderSize_ = bytes; }
+    void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    // 连接使用边沿触发（EPOLLET），每次可读事件读到EAGAIN为止，默认水平触发。必须在start()之前调用
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    // 每个IO线程（reuseport模式下即每个reactor）启动时调用，
+    // 用于创建数据库连接、缓存等线程私有的状态
+    void setThreadInitCallback(const TcpServer::ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+    void start();
+
+    // 完成一个异步处理的请求，可以在任意线程中调用。响应通过runInLoop
+    // 回到连接所属的loop发送，然后继续解析该连接上已经到达的下一个请求。
+    // 在此之前连接上新到达的数据只留在输入缓冲区中，不会被解析
+    void sendResponse(const TcpConnectionPtr& conn, const std::shared_ptr<HttpResponse>& resp);
+
+    // 继续一个HeadersCallback返回kHeadersPending的请求，可以在任意线程中调用。
+    // cb在连接所属的loop中代替HeadersCallback重新做决定，然后继续读取请求体。
+    // 在此之前连接上到达的请求体只留在输入缓冲区中，不会被解析
+    void resumeHeaders(const TcpConnectionPtr& conn, const HeadersCallback& cb);
+
+    // 请求体的消费者通过HttpContext::setBodyPaused暂停读取后，赶上时调用，可以在任意线程中调用
+    void resumeBody(const TcpConnectionPtr& conn);
 
 private:
+    static constexpr double kDefaultIdleTimeout = 60.0;
+    static const size_t kDefaultMaxBufferedInput = 1024 * 1024;
+    static const size_t kDefaultOutputHighWaterMark = 4 * 1024 * 1024;
+    static const size_t kDefaultMaxBodySize = 16 * 1024 * 1024;
+
     void onConnection(const TcpConnectionPtr& conn);
+    void onWriteComplete(const TcpConnectionPtr& conn);
+    // 按输入积压和输出队列的情况暂停或恢复读取
+    void updateReading(const TcpConnectionPtr& conn, HttpContext* context);
+    void scheduleIdleCheck(const TcpConnectionPtr& conn, double delay);
+    void onIdleCheck(const std::weak_ptr<TcpConnection>& weakConn);
     void onMessage(const TcpConnectionPtr& conn,
                   Buffer* buf,
                   Timestamp receiveTime);
+    // 按HeadersCallback的结果处理请求头，返回true表示继续解析请求体
+    bool acceptHeaders(const TcpConnectionPtr& conn, HttpContext* context,
+                       HeadersResult result, const HttpResponse& resp);
+    void resumeHeadersInLoop(const TcpConnectionPtr& conn, const HeadersCallback& cb);
+    void resumeBodyInLoop(const TcpConnectionPtr& conn);
     bool onRequest(const TcpConnectionPtr&, HttpRequest&);
+    void writeResponse(const TcpConnectionPtr& conn, HttpResponse* resp);
+    void sendResponseInLoop(const TcpConnectionPtr& conn, const std::shared_ptr<HttpResponse>& resp);
+    void setupServer(TcpServer* server);
+    void startReactors();
 
     TcpServer server_;
+    const InetAddress listenAddr_;
+    const TcpServer::Option option_;
+    int numThreads_;
+    bool edgeTriggered_;
+    double idleTimeout_;
+    size_t compressionMinSize_;
+    size_t maxBufferedInput_;
+    size_t outputHighWaterMark_;
+    size_t maxBodySize_;
+    size_t maxHeaderSize_;
+    ConnectionCallback connectionCallback_;
+    TcpServer::ThreadInitCallback threadInitCallback_;
+    // reuseport模式下的reactor线程，每个线程上运行一个只有自己监听socket的TcpServer
+    std::unique_ptr<EventLoopThreadPool> reactorPool_;
+    std::vector<std::unique_ptr<TcpServer>> reactorServers_;
     HttpCallback httpCallback_;
+    HeadersCallback headersCallback_;
+    RouteTrie router_;
+    std::vector<HttpCallback> routeHandlers_;  // 下标即RouteTrie中的handlerId
 }; // class HttpServer
 
 } // namespace net
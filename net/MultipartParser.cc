@@ -0,0 +1,237 @@
+#include "MultipartParser.h"
+#include "base/Logging.h"
+
+#include <algorithm>
+#include <functional>
+#include <string.h>
+#include <strings.h>
+
+using namespace mymuduo;
+using namespace mymuduo::net;
+
+namespace {
+
+const char kCRLF[] = "\r\n";
+const char kHeaderEnd[] = "\r\n\r\n";
+
+// 去掉首尾空白
+std::string trim(const char* begin, const char* end) {
+    while (begin < end && isspace(static_cast<unsigned char>(*begin))) {
+        ++begin;
+    }
+    while (end > begin && isspace(static_cast<unsigned char>(*(end - 1)))) {
+        --end;
+    }
+    return std::string(begin, end);
+}
+
+// 在形如 form-data; name="file"; filename="a.txt" 的头部值中取出参数
+std::string headerParam(const std::string& value, const char* key) {
+    size_t keyLen = strlen(key);
+    size_t pos = 0;
+    while ((pos = value.find(';', pos)) != std::string::npos) {
+        ++pos;
+        while (pos < value.size() && isspace(static_cast<unsigned char>(value[pos]))) {
+            ++pos;
+        }
+        if (value.size() - pos > keyLen &&
+            strncasecmp(value.c_str() + pos, key, keyLen) == 0 &&
+            value[pos + keyLen] == '=') {
+            pos += keyLen + 1;
+            if (pos < value.size() && value[pos] == '"') {
+                size_t close = value.find('"', pos + 1);
+                if (close == std::string::npos) {
+                    return std::string();
+                }
+                return value.substr(pos + 1, close - pos - 1);
+            }
+            size_t semi = value.find(';', pos);
+            return trim(value.c_str() + pos,
+                        semi == std::string::npos ? value.c_str() + value.size()
+                                                  : value.c_str() + semi);
+        }
+    }
+    return std::string();
+}
+
+} // namespace
+
+MultipartParser::MultipartParser(const std::string& boundary)
+    : delimiter_("\r\n--" + boundary),
+      state_(kPreamble),
+      // 第一个边界前面没有CRLF，预置一个，这样所有边界都可以用同一个分隔符匹配
+      tail_(kCRLF),
+      searcher_(delimiter_.begin(), delimiter_.end()),
+      delimiterEnd_(0)
+{
+    if (boundary.empty()) {
+        LOG_ERROR << "MultipartParser: empty boundary";
+        state_ = kError;
+    }
+}
+
+bool MultipartParser::feed(const char* data, size_t len) {
+    while (len > 0 && state_ != kError) {
+        if (!tail_.empty()) {
+            // 上次留下的尾部可能和本次开头拼成一个边界，
+            // 只拼接一个边界长度的数据单独处理，其余数据仍然原地解析
+            size_t n = std::min(len, delimiter_.size());
+            std::string joined;
+            joined.reserve(tail_.size() + n);
+            joined.append(tail_);
+            joined.append(data, n);
+            tail_.clear();
+            consume(joined.data(), joined.size());
+            data += n;
+            len -= n;
+        } else {
+            consume(data, len);
+            len = 0;
+        }
+    }
+    return state_ != kError;
+}
+
+void MultipartParser::consume(const char* data, size_t len) {
+    const char* p = data;
+    const char* end = data + len;
+    while (p < end && state_ != kError && state_ != kEpilogue) {
+        switch (state_) {
+        case kPreamble:
+        case kBody: {
+            const char* delim = std::search(p, end, searcher_);
+            if (delim != end) {
+                if (state_ == kBody) {
+                    emitData(p, static_cast<size_t>(delim - p));
+                    if (partEndCallback_) {
+                        partEndCallback_();
+                    }
+                }
+                p = delim + delimiter_.size();
+                delimiterEnd_ = 0;
+                state_ = kDelimiterEnd;
+            } else {
+                // 末尾可能是半个边界，留到下次再判断
+                size_t keep = partialDelimiterSuffix(p, end);
+                if (state_ == kBody) {
+                    emitData(p, static_cast<size_t>(end - p) - keep);
+                }
+                tail_.assign(end - keep, keep);
+                p = end;
+            }
+            break;
+        }
+        case kDelimiterEnd:
+            p = consumeDelimiterEnd(p, end);
+            break;
+        case kHeaders:
+            p = consumeHeaders(p, end);
+            break;
+        default:
+            p = end;
+            break;
+        }
+    }
+}
+
+const char* MultipartParser::consumeDelimiterEnd(const char* p, const char* end) {
+    while (p < end && state_ == kDelimiterEnd) {
+        char c = *p++;
+        if (delimiterEnd_ == 0) {
+            if (c == ' ' || c == '\t') {
+                continue;  // 边界后允许有空白
+            }
+            if (c == '-' || c == '\r') {
+                delimiterEnd_ = c;
+            } else {
+                state_ = kError;
+            }
+        } else if (delimiterEnd_ == '-' && c == '-') {
+            state_ = kEpilogue;
+        } else if (delimiterEnd_ == '\r' && c == '\n') {
+            // 预置CRLF，使没有任何头部的part也能用"\r\n\r\n"判断头部结束
+            headerBuf_.assign(kCRLF);
+            state_ = kHeaders;
+        } else {
+            state_ = kError;
+        }
+    }
+    if (state_ == kError) {
+        LOG_ERROR << "MultipartParser: malformed boundary";
+    }
+    return p;
+}
+
+const char* MultipartParser::consumeHeaders(const char* p, const char* end) {
+    // 头部很小，拷贝进headerBuf_查找空行；拷贝量受kMaxHeaderSize限制
+    size_t oldSize = headerBuf_.size();
+    size_t n = std::min(static_cast<size_t>(end - p), kMaxHeaderSize + 4 - oldSize);
+    headerBuf_.append(p, n);
+
+    size_t searchFrom = oldSize >= 3 ? oldSize - 3 : 0;
+    size_t pos = headerBuf_.find(kHeaderEnd, searchFrom);
+    if (pos == std::string::npos) {
+        if (headerBuf_.size() > kMaxHeaderSize) {
+            LOG_ERROR << "MultipartParser: part headers too large";
+            state_ = kError;
+        }
+        return p + n;
+    }
+
+    Part part;
+    if (!parseHeaders(headerBuf_.data() + 2, headerBuf_.data() + pos, &part)) {
+        state_ = kError;
+        return end;
+    }
+    const char* next = p + (pos + 4 - oldSize);
+    headerBuf_.clear();
+    state_ = kBody;
+    if (partBeginCallback_) {
+        partBeginCallback_(part);
+    }
+    return next;
+}
+
+bool MultipartParser::parseHeaders(const char* begin, const char* end, Part* part) const {
+    while (begin < end) {
+        const char* crlf = std::search(begin, end, kCRLF, kCRLF + 2);
+        const char* colon = std::find(begin, crlf, ':');
+        if (colon == crlf) {
+            LOG_ERROR << "MultipartParser: malformed part header";
+            return false;
+        }
+        std::string field = trim(begin, colon);
+        std::string value = trim(colon + 1, crlf);
+        if (strcasecmp(field.c_str(), "Content-Disposition") == 0) {
+            part->name = headerParam(value, "name");
+            part->filename = headerParam(value, "filename");
+        } else if (strcasecmp(field.c_str(), "Content-Type") == 0) {
+            part->contentType = value;
+        }
+        begin = crlf == end ? end : crlf + 2;
+    }
+    return true;
+}
+
+size_t MultipartParser::partialDelimiterSuffix(const char* begin, const char* end) const {
+    size_t maxKeep = std::min(static_cast<size_t>(end - begin), delimiter_.size() - 1);
+    for (size_t keep = maxKeep; keep > 0; --keep) {
+        if (memcmp(end - keep, delimiter_.data(), keep) == 0) {
+            return keep;
+        }
+    }
+    return 0;
+}
+
+void MultipartParser::emitData(const char* data, size_t len) {
+    if (len > 0 && partDataCallback_) {
+        partDataCallback_(data, len);
+    }
+}
+
+std::string MultipartParser::boundaryFromContentType(const std::string& contentType) {
+    if (strncasecmp(contentType.c_str(), "multipart/", 10) != 0) {
+        return std::string();
+    }
+    return headerParam(contentType, "boundary");
+}
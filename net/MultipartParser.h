@@ -0,0 +1,83 @@
+#pragma once
+
+#include "base/noncopyable.h"
+
+#include <functional>
+#include <string>
+
+namespace mymuduo {
+namespace net {
+
+/// @brief multipart/form-data 增量解析器
+///
+/// 请求体可以按任意大小分段喂给feed()，边界跨越两次调用时也能正确识别。
+/// 数据回调直接指向调用者传入的内存（通常就是Buffer的可读区），
+/// 只有可能是边界前缀的少量尾部字节（不超过边界长度）会被暂存，
+/// 因此解析器占用的内存与请求体大小无关。
+///
+/// 状态转换：
+///   kPreamble -> kDelimiterEnd -> kHeaders -> kBody -> kDelimiterEnd -> ... -> kEpilogue
+class MultipartParser : noncopyable {
+public:
+    /// 一个part的头部信息
+    struct Part {
+        std::string name;          // Content-Disposition中的name
+        std::string filename;      // Content-Disposition中的filename，普通字段为空
+        std::string contentType;   // part的Content-Type
+    };
+
+    using PartBeginCallback = std::function<void(const Part&)>;
+    using PartDataCallback = std::function<void(const char* data, size_t len)>;
+    using PartEndCallback = std::function<void()>;
+
+    /// @param boundary Content-Type中的boundary参数（不含前导"--"）
+    explicit MultipartParser(const std::string& boundary);
+
+    void setPartBeginCallback(const PartBeginCallback& cb) { partBeginCallback_ = cb; }
+    void setPartDataCallback(const PartDataCallback& cb) { partDataCallback_ = cb; }
+    void setPartEndCallback(const PartEndCallback& cb) { partEndCallback_ = cb; }
+
+    /// @brief 喂入一段请求体数据，总是消费全部数据
+    /// @return false表示格式错误
+    bool feed(const char* data, size_t len);
+
+    /// @brief 是否已经遇到结束边界
+    bool finished() const { return state_ == kEpilogue; }
+    bool hasError() const { return state_ == kError; }
+
+    /// @brief 从Content-Type头中取出boundary参数，没有则返回空串
+    static std::string boundaryFromContentType(const std::string& contentType);
+
+private:
+    enum State {
+        kPreamble,       // 第一个边界之前的内容，丢弃
+        kDelimiterEnd,   // 边界之后，等待"\r\n"或结束标记"--"
+        kHeaders,        // part头部
+        kBody,           // part数据
+        kEpilogue,       // 结束边界之后的内容，丢弃
+        kError,
+    };
+
+    static const size_t kMaxHeaderSize = 8 * 1024;
+
+    void consume(const char* data, size_t len);
+    const char* consumeDelimiterEnd(const char* p, const char* end);
+    const char* consumeHeaders(const char* p, const char* end);
+    size_t partialDelimiterSuffix(const char* begin, const char* end) const;
+    bool parseHeaders(const char* begin, const char* end, Part* part) const;
+    void emitData(const char* data, size_t len);
+
+    const std::string delimiter_;   // "\r\n--" + boundary
+    State state_;
+    std::string tail_;              // 可能是边界前缀的尾部字节
+    std::string headerBuf_;         // 当前part的头部
+    const std::boyer_moore_horspool_searcher<std::string::const_iterator> searcher_;
+    char delimiterEnd_;             // kDelimiterEnd状态下已读到的第一个字符
+
+    PartBeginCallback partBeginCallback_;
+    PartDataCallback partDataCallback_;
+    PartEndCallback partEndCallback_;
+};
+
+} // namespace net
+} // namespace mymuduo
@@ -1,132 +1,164 @@
 // net/RouteTrie.cc
 #include "RouteTrie.h"
-#include <sstream>
 #include "base/Logging.h"
 
+#include <algorithm>
+
 namespace mymuduo {
 namespace net {
 
-std::vector<std::string> RouteTrie::splitPath(const std::string& path) {
-    std::vector<std::string> segments;
-    std::string segment;
-    std::istringstream pathStream(path);
-    
-    while (std::getline(pathStream, segment, '/')) {
-        if (!segment.empty()) {
-            segments.push_back(segment);
-        }
+RouteTrie::Node::Node()
+    : paramChild(-1)
+{
+    std::fill(routes, routes + kNumMethods, -1);
+}
+
+RouteTrie::RouteTrie()
+    : nodes_(1)
+{
+}
+
+void RouteTrie::clear() {
+    nodes_.assign(1, Node());
+    routes_.clear();
+}
+
+int RouteTrie::findStaticChild(const Node& node, std::string_view segment) const {
+    auto it = std::lower_bound(node.children.begin(), node.children.end(), segment,
+                               [this](int child, std::string_view s) {
+                                   return std::string_view(nodes_[child].segment) < s;
+                               });
+    if (it != node.children.end() && nodes_[*it].segment == segment) {
+        return *it;
     }
-    return segments;
+    return -1;
 }
 
-void RouteTrie::addRoute(const std::string& path, const std::string& method, 
-                        const std::string& handler, const std::vector<std::string>& paramNames) {
-    auto current = root_;
-    auto segments = splitPath(path);
-    
-    for (const auto& segment : segments) {
+int RouteTrie::addStaticChild(int parent, std::string_view segment) {
+    int child = findStaticChild(nodes_[parent], segment);
+    if (child >= 0) {
+        return child;
+    }
+    child = static_cast<int>(nodes_.size());
+    nodes_.emplace_back();
+    nodes_[child].segment.assign(segment.data(), segment.size());
+
+    std::vector<int>& children = nodes_[parent].children;
+    auto it = std::lower_bound(children.begin(), children.end(), segment,
+                               [this](int c, std::string_view s) {
+                                   return std::string_view(nodes_[c].segment) < s;
+                               });
+    children.insert(it, child);
+    return child;
+}
+
+void RouteTrie::addRoute(HttpRequest::Method method, const std::string& pattern, int handlerId) {
+    Route route;
+    route.handlerId = handlerId;
+
+    int current = 0;
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        if (pattern[pos] == '/') {
+            ++pos;
+            continue;
+        }
+        size_t end = pattern.find('/', pos);
+        if (end == std::string::npos) {
+            end = pattern.size();
+        }
+        std::string_view segment(pattern.data() + pos, end - pos);
         if (segment[0] == ':') {
             // 参数节点
-            current->paramNames.push_back(segment.substr(1));
-            if (!current->children["*"]) {
-                current->children["*"] = std::make_shared<TrieNode>();
+            route.paramNames.emplace_back(segment.data() + 1, segment.size() - 1);
+            if (nodes_[current].paramChild < 0) {
+                int child = static_cast<int>(nodes_.size());
+                nodes_.emplace_back();
+                nodes_[current].paramChild = child;
             }
-            current = current->children["*"];
+            current = nodes_[current].paramChild;
         } else {
             // 静态节点
-            if (!current->children[segment]) {
-                current->children[segment] = std::make_shared<TrieNode>();
-            }
-            current = current->children[segment];
+            current = addStaticChild(current, segment);
         }
+        pos = end;
     }
-    
-    current->isLeaf = true;
-    current->handlers[method] = handler;
-    LOG_INFO << "Added route: " << path << " with method: " << method;
-}
 
-RouteMatch RouteTrie::findRoute(const std::string& path, const std::string& method) {
-    LOG_INFO << "Finding route for path: " << path << ", method: " << method;
-    
-    // 分离路径和查询参数
-    size_t queryPos = path.find('?');
-    std::string basePath = (queryPos != std::string::npos) ? path.substr(0, queryPos) : path;
-    
-    auto current = root_;
-    std::unordered_map<std::string, std::string> params;
-    auto segments = splitPath(basePath);
-    
-    // 存储所有可能的匹配结果
-    std::vector<std::pair<std::shared_ptr<TrieNode>, std::unordered_map<std::string, std::string>>> matches;
-    
-    // 递归查找所有可能的匹配
-    findMatches(current, segments, 0, params, matches);
-    
-    // 选择最佳匹配
-    if (!matches.empty()) {
-        // 优先选择静态路由匹配
-        for (const auto& match : matches) {
-            if (match.first->isLeaf && match.first->handlers.find(method) != match.first->handlers.end()) {
-                LOG_INFO << "Found matching route with handler: " << match.first->handlers[method];
-                return RouteMatch{match.first->handlers[method], match.second};
-            }
-        }
+    if (route.paramNames.size() > HttpRequest::kMaxPathParams) {
+        LOG_ERROR << "Too many path parameters in route: " << pattern;
+        return;
+    }
+
+    int& slot = nodes_[current].routes[method];
+    if (slot >= 0) {
+        routes_[slot] = std::move(route);
+    } else {
+        slot = static_cast<int>(routes_.size());
+        routes_.push_back(std::move(route));
     }
-    
-    LOG_INFO << "No matching route found";
-    return RouteMatch{"", {}};
+    LOG_INFO << "Added route: " << pattern << " with method: " << method;
 }
 
-void RouteTrie::findMatches(std::shared_ptr<TrieNode> node, 
-                          const std::vector<std::string>& segments,
-                          size_t currentIndex,
-                          std::unordered_map<std::string, std::string> currentParams,
-                          std::vector<std::pair<std::shared_ptr<TrieNode>, 
-                          std::unordered_map<std::string, std::string>>>& matches) {
-    if (currentIndex >= segments.size()) {
-        if (node->isLeaf) {
-            matches.push_back({node, currentParams});
+int RouteTrie::matchNode(int nodeIndex, const std::string& path, size_t pos,
+                         HttpRequest::Method method, ParamSlot* params,
+                         size_t numParams, size_t* totalParams) const {
+    // 跳过'/'（包括重复的'/'）
+    while (pos < path.size() && path[pos] == '/') {
+        ++pos;
+    }
+
+    const Node& node = nodes_[nodeIndex];
+    if (pos >= path.size()) {
+        int route = node.routes[method];
+        if (route >= 0) {
+            *totalParams = numParams;
         }
-        return;
+        return route;
     }
-    
-    const std::string& currentSegment = segments[currentIndex];
-    
-    // 1. 尝试精确匹配
-    if (node->children.find(currentSegment) != node->children.end()) {
-        findMatches(node->children[currentSegment], segments, currentIndex + 1, 
-                   currentParams, matches);
+
+    size_t end = path.find('/', pos);
+    if (end == std::string::npos) {
+        end = path.size();
     }
-    
-    // 2. 尝试参数匹配
-    if (node->children.find("*") != node->children.end()) {
-        auto paramNode = node->children["*"];
-        if (!paramNode->paramNames.empty()) {
-            std::unordered_map<std::string, std::string> newParams = currentParams;
-            newParams[paramNode->paramNames.back()] = currentSegment;
-            findMatches(paramNode, segments, currentIndex + 1, newParams, matches);
+
+    // 1. 静态段优先
+    int child = findStaticChild(node, std::string_view(path.data() + pos, end - pos));
+    if (child >= 0) {
+        int route = matchNode(child, path, end, method, params, numParams, totalParams);
+        if (route >= 0) {
+            return route;
         }
     }
-    
-    // 3. 尝试通配符匹配
-    if (node->children.find("**") != node->children.end()) {
-        auto wildcardNode = node->children["**"];
-        // 通配符可以匹配任意数量的段
-        for (size_t i = currentIndex; i <= segments.size(); ++i) {
-            std::string wildcardValue;
-            for (size_t j = currentIndex; j < i; ++j) {
-                if (!wildcardValue.empty()) wildcardValue += "/";
-                wildcardValue += segments[j];
-            }
-            if (!wildcardValue.empty()) {
-                std::unordered_map<std::string, std::string> newParams = currentParams;
-                newParams["*"] = wildcardValue;
-                findMatches(wildcardNode, segments, i, newParams, matches);
-            }
-        }
+
+    // 2. 回溯尝试参数段
+    if (node.paramChild >= 0 && numParams < HttpRequest::kMaxPathParams) {
+        params[numParams].offset = pos;
+        params[numParams].len = end - pos;
+        return matchNode(node.paramChild, path, end, method, params, numParams + 1, totalParams);
+    }
+    return -1;
+}
+
+int RouteTrie::match(HttpRequest& req) const {
+    HttpRequest::Method method = req.method();
+    if (method <= HttpRequest::kInvalid || method >= kNumMethods) {
+        return kNoRoute;
+    }
+
+    ParamSlot params[HttpRequest::kMaxPathParams];
+    size_t numParams = 0;
+    int route = matchNode(0, req.path(), 0, method, params, 0, &numParams);
+    if (route < 0) {
+        return kNoRoute;
+    }
+
+    const Route& r = routes_[route];
+    req.clearPathParams();
+    for (size_t i = 0; i < numParams; ++i) {
+        req.addPathParam(&r.paramNames[i], params[i].offset, params[i].len);
     }
+    return r.handlerId;
 }
 
 } // namespace net
-} // namespace mymuduo
\ No newline at end of file
+} // namespace mymuduo
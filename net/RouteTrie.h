@@ -1,61 +1,68 @@
 // net/RouteTrie.h
 #pragma once
 
+#include "HttpRequest.h"
+#include "base/copyable.h"
+
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
-#include <memory>
-#include <unordered_map>
-#include "base/copyable.h"
 
 namespace mymuduo {
 namespace net {
 
-// 路由匹配结果
-struct RouteMatch {
-    std::string handler;
-    std::unordered_map<std::string, std::string> params;
-};
-
-// Trie树节点
-class TrieNode {
-public:
-    std::map<std::string, std::shared_ptr<TrieNode>> children;
-    std::map<std::string, std::string> handlers;  // method -> handler
-    std::vector<std::string> paramNames;
-    bool isLeaf;
-    
-    TrieNode() : isLeaf(false) {}
-};
-
-// Trie树路由实现
+// Trie树路由
+//
+// 路由模式按'/'分段，以':'开头的段是路径参数，例如 /download/:filename。
+// 所有节点存放在同一个vector中，用下标互相引用；
+// 匹配时静态段优先，失败再回溯尝试参数段，整个过程不分配内存，
+// 参数值只以偏移量的形式记录到HttpRequest中。
 class RouteTrie : public mymuduo::copyable {
 public:
-    RouteTrie() : root_(std::make_shared<TrieNode>()) {}
-    
-    // 添加路由
-    void addRoute(const std::string& path, const std::string& method, 
-                 const std::string& handler, const std::vector<std::string>& paramNames = {});
-    
-    // 查找路由
-    RouteMatch findRoute(const std::string& path, const std::string& method);
-    
+    static const int kNoRoute = -1;
+
+    RouteTrie();
+
+    // 添加路由，handlerId由调用者解释
+    // 同一方法和模式重复添加时，后添加的覆盖先添加的
+    void addRoute(HttpRequest::Method method, const std::string& pattern, int handlerId);
+
+    // 按请求的方法和路径查找路由，成功时把路径参数写入req并返回handlerId
+    int match(HttpRequest& req) const;
+
     // 清空路由
-    void clear() { root_ = std::make_shared<TrieNode>(); }
+    void clear();
 
 private:
-    // 分割路径
-    std::vector<std::string> splitPath(const std::string& path);
-    
-    std::shared_ptr<TrieNode> root_;
-    
-    void findMatches(std::shared_ptr<TrieNode> node,
-                    const std::vector<std::string>& segments,
-                    size_t currentIndex,
-                    std::unordered_map<std::string, std::string> currentParams,
-                    std::vector<std::pair<std::shared_ptr<TrieNode>,
-                    std::unordered_map<std::string, std::string>>>& matches);
+    static const int kNumMethods = HttpRequest::kDelete + 1;
+
+    struct Node {
+        std::string segment;            // 静态段内容，参数节点为空
+        std::vector<int> children;      // 静态子节点下标，按segment排序
+        int paramChild;                 // 参数子节点下标，没有为-1
+        int routes[kNumMethods];        // 各方法对应的路由下标，没有为-1
+
+        Node();
+    };
+
+    struct Route {
+        int handlerId;
+        std::vector<std::string> paramNames;
+    };
+
+    struct ParamSlot {
+        size_t offset;
+        size_t len;
+    };
+
+    int findStaticChild(const Node& node, std::string_view segment) const;
+    int addStaticChild(int parent, std::string_view segment);
+    int matchNode(int nodeIndex, const std::string& path, size_t pos, HttpRequest::Method method,
+                  ParamSlot* params, size_t numParams, size_t* totalParams) const;
+
+    std::vector<Node> nodes_;     // nodes_[0]为根节点
+    std::vector<Route> routes_;
 };
 
 } // namespace net
-} // namespace mymuduo
\ No newline at end of file
+} // namespace mymuduo
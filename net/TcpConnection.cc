@@ -7,6 +7,9 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <fcntl.h>
 #include <string.h>
 #include <netinet/tcp.h>
 #include <strings.h>
@@ -14,6 +17,14 @@
 using namespace mymuduo;
 using namespace mymuduo::net;
 
+namespace {
+
+const int kMaxIovecs = 64;                // 一次writev最多发送的内存块数
+const size_t kCoalesceBytes = 64 * 1024;  // 拷贝发送的小块数据追加到不超过该大小的队尾块中
+const size_t kEdgeReadBudget = 1024 * 1024;  // 边沿触发时每次可读事件最多读取的字节数
+
+} // namespace
+
 TcpConnection::TcpConnection(EventLoop* loop,
                            const string& nameArg,
                            int sockfd,
@@ -23,11 +34,14 @@ TcpConnection::TcpConnection(EventLoop* loop,
     , name_(nameArg)
     , state_(kConnecting)
     , reading_(true)
+    , edgeTriggered_(false)
+    , readQueued_(false)
     , socket_(new Socket(sockfd))
     , channel_(new Channel(loop, sockfd))
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64*1024*1024)  // 64MB
+    , outputBytes_(0)
 {
     // 设置通道的回调函数
     channel_->setReadCallback(
@@ -45,6 +59,11 @@ TcpConnection::TcpConnection(EventLoop* loop,
 }
 
 TcpConnection::~TcpConnection() {
+    for (const OutputChunk& chunk : outputQueue_) {
+        if (chunk.kind == OutputChunk::kFile && chunk.fd >= 0) {
+            ::close(chunk.fd);
+        }
+    }
     LOG_INFO << "TcpConnection::dtor[" << name_ << "] at " << this 
              << " fd=" << channel_->fd() 
              << " state=" << static_cast<int>(state_);
@@ -86,6 +105,56 @@ void TcpConnection::send(Buffer* buf) {
     }
 }
 
+void TcpConnection::send(const std::shared_ptr<const string>& message) {
+    send(std::vector<std::shared_ptr<const string>>{message});
+}
+
+void TcpConnection::send(const std::vector<std::shared_ptr<const string>>& messages) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendSharedInLoop(messages);
+        } else {
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendSharedInLoop, shared_from_this(), messages));
+        }
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t len) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendFileInLoop(fd, string(), offset, len);
+        } else {
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fd, string(), offset, len));
+        }
+    } else {
+        ::close(fd);
+    }
+}
+
+void TcpConnection::sendFile(const string& path, off_t offset, size_t len) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendFileInLoop(-1, path, offset, len);
+        } else {
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), -1, path, offset, len));
+        }
+    }
+}
+
+void TcpConnection::sendStream(const BodyProducer& producer) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendStreamInLoop(producer);
+        } else {
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendStreamInLoop, shared_from_this(), producer));
+        }
+    }
+}
+
 void TcpConnection::sendInLoop(const StringPiece& message) {
     sendInLoop(message.data(), message.size());
 }
@@ -94,7 +163,6 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
     loop_->assertInLoopThread();
     ssize_t nwrote = 0;
     size_t remaining = len;
-    bool faultError = false;
 
     // 如果连接已经关闭，就不再发送数据
     if (state_ == kDisconnected) {
@@ -103,8 +171,8 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
     }
     LOG_DEBUG << "sendInLoop: data length = " << len;
 
-    // 如果输出缓冲区为空，尝试直接发送数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
+    // 如果输出队列为空，尝试直接发送数据
+    if (!channel_->isWriting() && outputQueue_.empty()) {
         nwrote = ::write(channel_->fd(), data, len);
         if (nwrote >= 0) {
             remaining = len - nwrote;
@@ -117,30 +185,241 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
             if (errno != EWOULDBLOCK && errno != EAGAIN) {
                 LOG_ERROR << "TcpConnection::sendInLoop error: " << strerror(errno);
                 if (errno == EPIPE || errno == ECONNRESET) {
-                    faultError = true;
+                    return;
                 }
             }
         }
     }
 
-    // 如果还有数据未发送完，添加到输出缓冲区，并开启写事件监听
-    if (!faultError && remaining > 0) {
-        size_t oldLen = outputBuffer_.readableBytes();
-        LOG_DEBUG << "sendInLoop: append " << remaining << " bytes to output buffer, oldLen = " << oldLen;
-        if (oldLen + remaining >= highWaterMark_
-            && oldLen < highWaterMark_
-            && highWaterMarkCallback_) {
-            loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+    // 还有数据未发送完，拷贝到输出队列末尾，并开启写事件监听
+    if (remaining > 0) {
+        const char* rest = static_cast<const char*>(data) + nwrote;
+        if (!outputQueue_.empty() && outputQueue_.back().kind == OutputChunk::kMemory &&
+            !outputQueue_.back().shared && outputQueue_.back().buffer.readableBytes() < kCoalesceBytes) {
+            // 连续的小块数据合并在一起，避免队列中有大量很小的块
+            outputQueue_.back().buffer.append(rest, remaining);
+            size_t oldLen = outputBytes_;
+            outputBytes_ += remaining;
+            if (outputBytes_ >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
+                loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), outputBytes_));
+            }
+        } else {
+            OutputChunk chunk(OutputChunk::kMemory);
+            chunk.buffer.append(rest, remaining);
+            enqueueMemory(std::move(chunk));
+        }
+        startWriting();
+    }
+}
+
+void TcpConnection::sendSharedInLoop(const std::vector<std::shared_ptr<const string>>& messages) {
+    loop_->assertInLoopThread();
+    if (state_ == kDisconnected) {
+        LOG_ERROR << "disconnected, give up writing";
+        return;
+    }
+    bool queued = false;
+    for (const std::shared_ptr<const string>& message : messages) {
+        if (message && !message->empty()) {
+            OutputChunk chunk(OutputChunk::kMemory);
+            chunk.shared = message;
+            enqueueMemory(std::move(chunk));
+            queued = true;
+        }
+    }
+    if (queued) {
+        startWriting();
+    }
+}
+
+void TcpConnection::enqueueMemory(OutputChunk&& chunk) {
+    size_t oldLen = outputBytes_;
+    outputBytes_ += chunk.size();
+    if (outputBytes_ >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
+        loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), outputBytes_));
+    }
+    outputQueue_.push_back(std::move(chunk));
+}
+
+// 开启写事件监听并立即尝试发送
+void TcpConnection::startWriting() {
+    if (!channel_->isWriting()) {
+        channel_->enableWriting();
+    }
+    handleWrite();
+}
+
+void TcpConnection::sendFileInLoop(int fd, const string& path, off_t offset, size_t len) {
+    loop_->assertInLoopThread();
+    if (state_ == kDisconnected || len == 0) {
+        if (state_ == kDisconnected) {
+            LOG_ERROR << "disconnected, give up sending file";
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return;
+    }
+    LOG_DEBUG << "sendFileInLoop: fd = " << fd << ", path = " << path
+              << ", offset = " << offset << ", len = " << len;
+
+    OutputChunk chunk(OutputChunk::kFile);
+    chunk.fd = fd;
+    chunk.path = path;
+    chunk.offset = offset;
+    chunk.remaining = len;
+    outputQueue_.push_back(std::move(chunk));
+    startWriting();
+}
+
+void TcpConnection::sendStreamInLoop(const BodyProducer& producer) {
+    loop_->assertInLoopThread();
+    if (state_ == kDisconnected) {
+        LOG_ERROR << "disconnected, give up sending stream";
+        return;
+    }
+    OutputChunk chunk(OutputChunk::kStream);
+    chunk.producer = producer;
+    outputQueue_.push_back(std::move(chunk));
+    startWriting();
+}
+
+// 尽量发送输出队列，返回true表示已经发空；
+// 返回false表示socket暂时写不下，需要等待下一次可写，或者出错（此时连接已关闭）
+bool TcpConnection::drainOutput() {
+    while (!outputQueue_.empty()) {
+        bool more;
+        switch (outputQueue_.front().kind) {
+        case OutputChunk::kMemory:
+            more = writeMemoryChunks();
+            break;
+        case OutputChunk::kFile:
+            more = writeFileChunk();
+            break;
+        default:
+            more = produceStreamChunk();
+            break;
+        }
+        if (!more) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 把队首连续的内存块用一次writev发出，全部发完时返回true
+bool TcpConnection::writeMemoryChunks() {
+    struct iovec vec[kMaxIovecs];
+    int count = 0;
+    size_t total = 0;
+    for (auto it = outputQueue_.begin();
+         it != outputQueue_.end() && it->kind == OutputChunk::kMemory && count < kMaxIovecs; ++it) {
+        vec[count].iov_base = const_cast<char*>(it->data());
+        vec[count].iov_len = it->size();
+        total += it->size();
+        ++count;
+    }
+
+    ssize_t n = ::writev(channel_->fd(), vec, count);
+    if (n < 0) {
+        if (errno != EWOULDBLOCK && errno != EAGAIN) {
+            LOG_ERROR << "TcpConnection::writeMemoryChunks error: " << strerror(errno);
+            if (errno == EPIPE || errno == ECONNRESET) {
+                handleClose();
+            }
+        }
+        return false;
+    }
+    LOG_DEBUG << "writeMemoryChunks: wrote " << n << " of " << total << " bytes in " << count << " chunks";
+
+    size_t written = static_cast<size_t>(n);
+    outputBytes_ -= written;
+    while (written > 0) {
+        OutputChunk& chunk = outputQueue_.front();
+        if (written < chunk.size()) {
+            chunk.consume(written);
+            break;
         }
-        outputBuffer_.append(static_cast<const char*>(data) + nwrote, remaining);
-        if (!channel_->isWriting()) {
-            LOG_DEBUG << "sendInLoop: enable writing";
-            channel_->enableWriting();
+        written -= chunk.size();
+        outputQueue_.pop_front();
+    }
+    return static_cast<size_t>(n) == total;
+}
+
+// 用sendfile发送队首的文件区间，发完时返回true
+bool TcpConnection::writeFileChunk() {
+    OutputChunk& chunk = outputQueue_.front();
+    if (chunk.fd < 0) {
+        chunk.fd = ::open(chunk.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (chunk.fd < 0) {
+            LOG_ERROR << "TcpConnection::writeFileChunk failed to open " << chunk.path
+                      << ": " << strerror(errno);
+            handleClose();
+            return false;
         }
-        // 立即尝试再次发送
-        handleWrite();
     }
+    ssize_t n = ::sendfile(channel_->fd(), chunk.fd, &chunk.offset, chunk.remaining);
+    if (n > 0) {
+        chunk.remaining -= static_cast<size_t>(n);
+        LOG_DEBUG << "writeFileChunk: sent " << n << " bytes, remaining " << chunk.remaining;
+        if (chunk.remaining == 0) {
+            ::close(chunk.fd);
+            outputQueue_.pop_front();
+            return true;
+        }
+        return false;
+    } else if (n == 0) {
+        // 文件比预期的短（例如被截断），响应已经无法完整发出
+        LOG_ERROR << "TcpConnection::writeFileChunk unexpected EOF, fd = " << chunk.fd;
+        handleClose();
+        return false;
+    } else {
+        if (errno != EWOULDBLOCK && errno != EAGAIN) {
+            LOG_ERROR << "TcpConnection::writeFileChunk error: " << strerror(errno);
+            if (errno == EPIPE || errno == ECONNRESET) {
+                handleClose();
+            }
+        }
+        return false;
+    }
+}
+
+// 队首是流式数据：由producer生成下一段，作为内存块排在它前面
+bool TcpConnection::produceStreamChunk() {
+    OutputChunk piece(OutputChunk::kMemory);
+    bool more = outputQueue_.front().producer(&piece.buffer);
+    size_t n = piece.buffer.readableBytes();
+    if (!more) {
+        if (n == 0) {
+            // 数据没能生成完，响应已经无法完整发出
+            LOG_ERROR << "TcpConnection::produceStreamChunk stream producer failed";
+            handleClose();
+            return false;
+        }
+        outputQueue_.pop_front();
+    }
+    if (n > 0) {
+        outputBytes_ += n;
+        outputQueue_.push_front(std::move(piece));
+    }
+    return true;
+}
+
+bool TcpConnection::hasPendingWrite() const {
+    loop_->assertInLoopThread();
+    // 输出缓冲区或文件区间非空时一定在关注可写事件
+    return channel_->isWriting();
+}
+
+size_t TcpConnection::pendingOutputBytes() const {
+    loop_->assertInLoopThread();
+    size_t bytes = outputBytes_;
+    for (const OutputChunk& chunk : outputQueue_) {
+        if (chunk.kind == OutputChunk::kFile) {
+            bytes += chunk.remaining;
+        }
+    }
+    return bytes;
 }
 
 void TcpConnection::shutdown() {
@@ -171,6 +450,36 @@ void TcpConnection::forceCloseInLoop() {
     }
 }
 
+void TcpConnection::startRead() {
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop() {
+    loop_->assertInLoopThread();
+    // 连接关闭后Channel已经不再关注任何事件，不能再修改
+    if (!reading_ && (state_ == kConnected || state_ == kDisconnecting)) {
+        channel_->enableReading();
+        reading_ = true;
+    }
+}
+
+void TcpConnection::stopRead() {
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopReadInLoop() {
+    loop_->assertInLoopThread();
+    if (reading_ && (state_ == kConnected || state_ == kDisconnecting)) {
+        channel_->disableReading();
+        reading_ = false;
+    }
+}
+
+void TcpConnection::setEdgeTriggered(bool on) {
+    edgeTriggered_ = on;
+    channel_->setEdgeTriggered(on);
+}
+
 void TcpConnection::connectEstablished() {
     loop_->assertInLoopThread();
     assert(state_ == kConnecting);
@@ -193,51 +502,66 @@ void TcpConnection::connectDestroyed() {
 
 void TcpConnection::handleRead(Timestamp receiveTime) {
     loop_->assertInLoopThread();
-    int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-    if (n > 0) {
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
-    } else if (n == 0) {
-        handleClose();
-    } else {
-        errno = savedErrno;
-        LOG_ERROR << "TcpConnection::handleRead";
-        handleError();
+    // 水平触发时每次事件读一次，没读完的下一轮poll还会通知；
+    // 边沿触发时一直读到EAGAIN，读满kEdgeReadBudget后排到本轮其他事件之后继续
+    if (readQueued_) {
+        return;  // 已经排队的continueRead会接着读，不再重复排队
     }
-}
-
-void TcpConnection::handleWrite() {
-    loop_->assertInLoopThread();
-    if (channel_->isWriting()) {
-        LOG_DEBUG << "handleWrite: try to write " << outputBuffer_.readableBytes() << " bytes";
-        ssize_t n = ::write(channel_->fd(), outputBuffer_.peek(), outputBuffer_.readableBytes());
+    size_t total = 0;
+    while (true) {
+        int savedErrno = 0;
+        ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
         if (n > 0) {
-            LOG_DEBUG << "handleWrite: wrote " << n << " bytes";
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0) {
-                LOG_DEBUG << "handleWrite: output buffer empty, disable writing";
-                channel_->disableWriting();
-                if (writeCompleteCallback_) {
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-                }
-                if (state_ == kDisconnecting) {
-                    shutdownInLoop();
-                }
-            } else {
-                LOG_DEBUG << "handleWrite: still have " << outputBuffer_.readableBytes() << " bytes to write";
-                // 继续尝试写入
-                loop_->queueInLoop(std::bind(&TcpConnection::handleWrite, shared_from_this()));
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            // 回调中可能暂停了读取或者关闭了连接
+            if (!edgeTriggered_ || !reading_ || state_ == kDisconnected) {
+                return;
             }
+            total += static_cast<size_t>(n);
+            if (total >= kEdgeReadBudget) {
+                readQueued_ = true;
+                loop_->queueInLoop(std::bind(&TcpConnection::continueRead, shared_from_this()));
+                return;
+            }
+        } else if (n == 0) {
+            handleClose();
+            return;
         } else {
-            if (errno != EWOULDBLOCK && errno != EAGAIN) {
-                LOG_ERROR << "TcpConnection::handleWrite error: " << strerror(errno);
-                if (errno == EPIPE || errno == ECONNRESET) {
-                    handleClose();
-                }
+            if (edgeTriggered_ && (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)) {
+                return;
             }
+            errno = savedErrno;
+            LOG_ERROR << "TcpConnection::handleRead";
+            handleError();
+            return;
         }
-    } else {
+    }
+}
+
+void TcpConnection::continueRead() {
+    readQueued_ = false;
+    // 排队期间可能暂停了读取（恢复时重新注册事件会再次通知）或者关闭了连接
+    if (reading_ && state_ != kDisconnected) {
+        handleRead(Timestamp::now());
+    }
+}
+
+void TcpConnection::handleWrite() {
+    loop_->assertInLoopThread();
+    if (!channel_->isWriting()) {
         LOG_ERROR << "Connection fd = " << channel_->fd() << " is down, no more writing";
+        return;
+    }
+    if (!drainOutput()) {
+        return;
+    }
+    LOG_DEBUG << "handleWrite: output drained, disable writing";
+    channel_->disableWriting();
+    if (writeCompleteCallback_) {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    }
+    if (state_ == kDisconnecting) {
+        shutdownInLoop();
     }
 }
 
@@ -11,6 +11,9 @@
 #include <memory>
 #include <string>
 #include <atomic>
+#include <deque>
+#include <vector>
+#include <sys/types.h>
 
 /*
 TcpConnection 类管理着每个网络连接的状态，提供发送数据、检查连接状态和关闭连接的功能。
@@ -100,6 +103,13 @@ public:
         closeCallback_ = cb;
     }
 
+    /**
+     * @brief 使用边沿触发（EPOLLET），需在connectEstablished之前调用
+     * 每次可读事件一直读到EAGAIN，但最多读取一定的字节数，剩下的排到本轮其他连接的事件之后再读，
+     * 一个大上传不会占住整个loop
+     */
+    void setEdgeTriggered(bool on);
+
     /**
      * @brief 连接建立
      * 当TCP连接完成时由TcpServer调用
@@ -120,6 +130,44 @@ public:
     void send(const StringPiece& message);
     void send(Buffer* message);
 
+    /**
+     * @brief 发送共享的数据，不拷贝
+     * 排队期间持有message的引用计数，调用者不能再修改它
+     */
+    void send(const std::shared_ptr<const string>& message);
+
+    /**
+     * @brief 依次发送多段共享的数据，不拼接
+     * 各段一起进入输出队列，用一次writev(2)发出（例如响应头和较大的响应体）
+     */
+    void send(const std::vector<std::shared_ptr<const string>>& messages);
+
+    /**
+     * @brief 通过sendfile(2)零拷贝发送文件的一段区间
+     * @param fd 已打开的文件描述符，所有权转移给TcpConnection，发送完成或连接销毁时关闭
+     * @param offset 文件起始偏移（用于Range请求）
+     * @param len 要发送的字节数
+     *
+     * 文件内容排在此前send的数据之后发送，之后再send的数据会排在文件之后，
+     * 全部发送完成后才会触发WriteCompleteCallback。
+     */
+    void sendFile(int fd, off_t offset, size_t len);
+
+    /**
+     * @brief 同sendFile(fd, ...)，但文件在排到队首、真正开始发送时才打开
+     * 一次排队大量文件（例如由很多分块拼接成的响应体）时不会同时占用大量描述符；
+     * 打开失败时响应已经无法完整发出，连接被关闭
+     */
+    void sendFile(const string& path, off_t offset, size_t len);
+
+    /**
+     * @brief 发送由producer逐段生成的数据（例如边解压边发送的文件）
+     * 排在此前send的数据和文件之后，输出缓冲区发空时才调用producer生成下一段，
+     * 内存占用不随数据总量增长；producer每次至少追加一个字节，追加最后一段时返回false；
+     * 返回false且没有追加数据表示出错，此时响应已经无法完整发出，连接被关闭
+     */
+    void sendStream(const BodyProducer& producer);
+
     /**
      * @brief 关闭连接
      * 会调用shutdown(SHUT_WR)半关闭写端
@@ -132,35 +180,94 @@ public:
     void forceClose();
 
     /**
-     * @brief 获取输入缓冲区
+     * @brief 开始/停止读取数据，用于流量控制
+     * 停止期间对端发来的数据留在内核的接收缓冲区中，缓冲区满后TCP窗口关闭，对端随之停止发送
      */
-    Buffer* inputBuffer() { return &inputBuffer_; }
-    
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+
     /**
-     * @brief 获取输出缓冲区
+     * @brief 是否还有数据或文件在等待发送，需在IO线程中调用
      */
-    Buffer* outputBuffer() { return &outputBuffer_; }
+    bool hasPendingWrite() const;
 
+    /**
+     * @brief 等待发送的字节数（内存数据和文件区间，不含还没有生成的流数据），需在IO线程中调用
+     */
+    size_t pendingOutputBytes() const;
+
+    /**
+     * @brief 获取输入缓冲区
+     */
+    Buffer* inputBuffer() { return &inputBuffer_; }
+    
     // 修改context相关方法
     void setContext(const std::shared_ptr<void>& context) { context_ = context; }
     const std::shared_ptr<void>& getContext() const { return context_; }
 
 private:
     enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
+
+    /// 输出队列中的一段：内存数据、sendfile发送的文件区间，或者由producer生成的数据
+    struct OutputChunk {
+        enum Kind { kMemory, kFile, kStream };
+
+        Kind kind;
+        // kMemory：shared非空时发送shared中pos之后的数据，否则发送buffer中的数据
+        std::shared_ptr<const string> shared;
+        size_t pos;
+        Buffer buffer;
+        // kFile
+        int fd;            // 文件描述符（由TcpConnection负责关闭），-1表示还没有打开path
+        string path;       // 延迟打开的文件路径
+        off_t offset;      // 下一次发送的文件偏移
+        size_t remaining;  // 剩余字节数
+        // kStream
+        BodyProducer producer;
+
+        explicit OutputChunk(Kind k)
+            : kind(k), pos(0), buffer(0), fd(-1), offset(0), remaining(0) {}
+
+        const char* data() const { return shared ? shared->data() + pos : buffer.peek(); }
+        size_t size() const { return shared ? shared->size() - pos : buffer.readableBytes(); }
+        void consume(size_t n) {
+            if (shared) {
+                pos += n;
+            } else {
+                buffer.retrieve(n);
+            }
+        }
+    };
+
     void setState(StateE s) { state_ = s; }
     void handleRead(Timestamp receiveTime);
+    void continueRead();
     void handleWrite();
     void handleClose();
     void handleError();
     void sendInLoop(const StringPiece& message);
     void sendInLoop(const void* message, size_t len);
+    void sendFileInLoop(int fd, const string& path, off_t offset, size_t len);
+    void sendStreamInLoop(const BodyProducer& producer);
+    void sendSharedInLoop(const std::vector<std::shared_ptr<const string>>& messages);
+    void enqueueMemory(OutputChunk&& chunk);
+    void startWriting();
+    bool drainOutput();
+    bool writeMemoryChunks();
+    bool writeFileChunk();
+    bool produceStreamChunk();
     void shutdownInLoop();
     void forceCloseInLoop();
+    void startReadInLoop();
+    void stopReadInLoop();
 
     EventLoop* loop_;          // 所属的事件循环
     const string name_;        // 连接名字
     std::atomic<StateE> state_;  // 连接状态
     bool reading_;            // 是否正在读取数据
+    bool edgeTriggered_;      // 是否边沿触发
+    bool readQueued_;         // 边沿触发时是否已排队continueRead
 
     std::unique_ptr<Socket> socket_;  // Socket对象
     std::unique_ptr<Channel> channel_;  // Channel对象
@@ -175,7 +282,8 @@ private:
     size_t highWaterMark_;                     // 高水位标记
 
     Buffer inputBuffer_;   // 输入缓冲区
-    Buffer outputBuffer_;  // 输出缓冲区
+    std::deque<OutputChunk> outputQueue_;  // 待发送的数据，按顺序发送
+    size_t outputBytes_;                   // 输出队列中内存数据的字节数（不含文件）
 
     // 修改context成员变量类型
     std::shared_ptr<void> context_;
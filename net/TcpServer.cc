@@ -35,6 +35,7 @@ TcpServer::TcpServer(EventLoop* loop,
     , threadInitCallback_()
     , started_(0)
     , nextConnId_(1)
+    , edgeTriggered_(false)
     , connections_()
 {
     // 当有新用户连接时会执行TcpServer::newConnection回调
@@ -106,6 +107,7 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setEdgeTriggered(edgeTriggered_);
 
     // 设置了如何关闭连接的回调
     conn->setCloseCallback(
@@ -64,6 +64,9 @@ public:
     // 设置线程数量
     void setThreadNum(int numThreads);
 
+    // 新连接使用边沿触发（EPOLLET），默认水平触发，需在start之前调用
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
     // 启动服务器
     void start();
 
@@ -101,6 +104,7 @@ private:
     
     std::atomic_bool started_;                 // 服务器是否已启动
     int nextConnId_;                           // 下一个连接ID
+    bool edgeTriggered_;                       // 新连接是否边沿触发
     ConnectionMap connections_;                 // 连接表
 };
 
@@ -0,0 +1,183 @@
+#include "application/ChunkStore.h"
+#include "base/Logging.h"
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace mymuduo;
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+std::string randomData(size_t len, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::string data(len, '\0');
+    for (char& c : data) {
+        c = static_cast<char>(gen() & 0xff);
+    }
+    return data;
+}
+
+// 把data按pieces中的长度依次喂给分块器，返回切出的分块
+std::vector<std::string> chunkData(const std::string& data, const std::vector<size_t>& pieces) {
+    std::vector<std::string> chunks;
+    CdcChunker chunker([&chunks](const char* p, size_t len) {
+        chunks.emplace_back(p, len);
+        return true;
+    });
+    size_t pos = 0;
+    for (size_t piece : pieces) {
+        if (pos >= data.size()) {
+            break;
+        }
+        size_t n = std::min(piece, data.size() - pos);
+        CHECK(chunker.update(data.data() + pos, n));
+        pos += n;
+    }
+    if (pos < data.size()) {
+        CHECK(chunker.update(data.data() + pos, data.size() - pos));
+    }
+    CHECK(chunker.finish());
+    return chunks;
+}
+
+std::string join(const std::vector<std::string>& chunks) {
+    std::string joined;
+    for (const std::string& chunk : chunks) {
+        joined += chunk;
+    }
+    return joined;
+}
+
+// 分块拼接后与原数据相同，大小在限制范围内，切分点与数据分几次到达无关
+void testChunkBoundaries() {
+    std::string data = randomData(12 * 1024 * 1024 + 12345, 1);
+    std::vector<std::string> whole = chunkData(data, {data.size()});
+    CHECK(join(whole) == data);
+    CHECK(whole.size() > 2);
+    for (size_t i = 0; i < whole.size(); ++i) {
+        CHECK(whole[i].size() <= CdcChunker::kMaxSize);
+        if (i + 1 < whole.size()) {
+            CHECK(whole[i].size() >= CdcChunker::kMinSize);
+        }
+    }
+
+    std::mt19937 gen(2);
+    std::vector<size_t> pieces;
+    for (size_t total = 0; total < data.size();) {
+        size_t piece = gen() % (256 * 1024) + 1;
+        pieces.push_back(piece);
+        total += piece;
+    }
+    CHECK(chunkData(data, pieces) == whole);
+}
+
+// 文件开头插入数据后，之后的分块仍与旧版本相同
+void testInsertKeepsLaterChunks() {
+    std::string data = randomData(16 * 1024 * 1024, 3);
+    std::string edited = data;
+    edited.insert(1000, randomData(777, 4));
+
+    std::vector<std::string> before = chunkData(data, {data.size()});
+    std::vector<std::string> after = chunkData(edited, {edited.size()});
+    CHECK(join(after) == edited);
+
+    std::set<std::string> old(before.begin(), before.end());
+    size_t shared = 0;
+    for (const std::string& chunk : after) {
+        shared += old.count(chunk);
+    }
+    CHECK(shared + 2 >= before.size());
+}
+
+int removeEntry(const char* path, const struct stat*, int, struct FTW*) {
+    return ::remove(path);
+}
+
+// 分块存入ChunkStore、写清单、读清单后按清单拼接得到原文件；相同内容的分块只保存一份
+void testStoreRoundTrip() {
+    char root[] = "/tmp/CdcChunker_test.XXXXXX";
+    if (!::mkdtemp(root)) {
+        CHECK(false);
+        return;
+    }
+    {
+        ChunkStore store(root);
+        std::string data = randomData(6 * 1024 * 1024, 5);
+        std::string fileHash = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+
+        ChunkList list(&store);
+        CdcChunker chunker([&list](const char* p, size_t len) { return list.add(p, len); });
+        CHECK(chunker.update(data.data(), data.size()));
+        CHECK(chunker.finish());
+        CHECK(list.totalSize() == data.size());
+        CHECK(store.writeManifest(fileHash, list.totalSize(), list.chunks()));
+        list.commit();
+
+        uint64_t fileSize = 0;
+        std::vector<ChunkStore::Chunk> chunks;
+        CHECK(store.readManifest(fileHash, &fileSize, &chunks));
+        CHECK(fileSize == data.size());
+        std::string restored;
+        for (const ChunkStore::Chunk& chunk : chunks) {
+            CHECK(store.hasChunk(chunk.hash));
+            std::ifstream in(store.chunkPath(chunk.hash), std::ios::binary);
+            std::ostringstream content;
+            content << in.rdbuf();
+            CHECK(content.str().size() == chunk.size);
+            restored += content.str();
+        }
+        CHECK(restored == data);
+
+        // 同样的数据再上传一次，分块只增加引用；不提交时析构释放引用，分块仍由清单持有
+        {
+            ChunkList again(&store);
+            CdcChunker rechunker([&again](const char* p, size_t len) { return again.add(p, len); });
+            CHECK(rechunker.update(data.data(), data.size()));
+            CHECK(rechunker.finish());
+            CHECK(again.chunks().size() == chunks.size());
+        }
+        for (const ChunkStore::Chunk& chunk : chunks) {
+            CHECK(store.hasChunk(chunk.hash));
+        }
+
+        // 删除清单后分块没有引用，被删除
+        store.removeManifest(fileHash);
+        for (const ChunkStore::Chunk& chunk : chunks) {
+            CHECK(!store.hasChunk(chunk.hash));
+        }
+    }
+    ::nftw(root, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+} // namespace
+
+int main() {
+    Logger::setLogLevel(Logger::WARN);
+    testChunkBoundaries();
+    testInsertKeepsLaterChunks();
+    testStoreRoundTrip();
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("All tests passed\n");
+    return 0;
+}
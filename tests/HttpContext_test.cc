@@ -0,0 +1,185 @@
+#include "net/HttpContext.h"
+#include "net/Buffer.h"
+#include "base/Timestamp.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace mymuduo;
+using namespace mymuduo::net;
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+// 头部分两次到达：第一次没有结束的空行，应返回kNeedMore而不是一直循环
+void testHeadersInTwoParts() {
+    HttpContext context;
+    Buffer buf;
+    buf.append("GET / HTTP/1.1\r\nHost: x\r\n");
+    CHECK(context.parseRequest(&buf, Timestamp::now()) == HttpContext::kNeedMore);
+    CHECK(!context.headersComplete());
+
+    buf.append("Accept: */*\r\n\r\n");
+    CHECK(context.parseRequest(&buf, Timestamp::now()) == HttpContext::kGotRequest);
+    CHECK(context.gotAll());
+    CHECK(context.request().path() == "/");
+    CHECK(context.request().getHeader("Host") == "x");
+    CHECK(context.request().getHeader("Accept") == "*/*");
+    CHECK(buf.readableBytes() == 0);
+}
+
+// keep-alive连接上第二个请求的头部被截断：第一个请求解析完成，第二个等待更多数据
+void testPipelinedRequestCutInHeaders() {
+    HttpContext context;
+    Buffer buf;
+    buf.append("GET /a HTTP/1.1\r\nHost: x\r\n\r\nGET /b HTTP/1.1\r\nHost: x\r\n");
+    CHECK(context.parseRequest(&buf, Timestamp::now()) == HttpContext::kGotRequest);
+    CHECK(context.request().path() == "/a");
+
+    context.reset();
+    CHECK(context.parseRequest(&buf, Timestamp::now()) == HttpContext::kNeedMore);
+    buf.append("\r\n");
+    CHECK(context.parseRequest(&buf, Timestamp::now()) == HttpContext::kGotRequest);
+    CHECK(context.request().path() == "/b");
+}
+
+// 一直不发空行的头部在达到上限时报错，而不是无限缓存
+void testHeadersTooLarge() {
+    HttpContext context;
+    context.setMaxHeaderSize(64);
+    Buffer buf;
+    buf.append("GET / HTTP/1.1\r\nHost: x\r\n");
+    CHECK(context.parseRequest(&buf, Timestamp::now()) == HttpContext::kNeedMore);
+    buf.append(std::string(40, 'a'));
+    CHECK(context.parseRequest(&buf, Timestamp::now()) == HttpContext::kError);
+    CHECK(context.headersTooLarge());
+
+    // 请求行本身没有结束
+    HttpContext lineContext;
+    lineContext.setMaxHeaderSize(64);
+    Buffer lineBuf;
+    lineBuf.append("GET /" + std::string(100, 'a'));
+    CHECK(lineContext.parseRequest(&lineBuf, Timestamp::now()) == HttpContext::kError);
+    CHECK(lineContext.headersTooLarge());
+}
+
+// 上限按每个请求计算，reset之后重新计数
+void testHeaderSizePerRequest() {
+    HttpContext context;
+    context.setMaxHeaderSize(64);
+    Buffer buf;
+    std::string request = "GET / HTTP/1.1\r\nHost: xxxxxxxxxxxxxxxxxxxx\r\n\r\n";
+    for (int i = 0; i < 3; ++i) {
+        buf.append(request);
+    }
+    for (int i = 0; i < 3; ++i) {
+        CHECK(context.parseRequest(&buf, Timestamp::now()) == HttpContext::kGotRequest);
+        CHECK(!context.headersTooLarge());
+        context.reset();
+    }
+    CHECK(buf.readableBytes() == 0);
+}
+
+const char kChunkedHeaders[] = "POST /up HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+
+// 解析chunked请求：头部之后的数据分多次到达，每次到达后调用一次parseRequest
+HttpContext::ParseResult parseChunked(HttpContext* context, const std::vector<std::string>& pieces) {
+    Buffer buf;
+    buf.append(kChunkedHeaders);
+    HttpContext::ParseResult result = context->parseRequest(&buf, Timestamp::now());
+    if (result != HttpContext::kHeadersComplete) {
+        return result;
+    }
+    for (const std::string& piece : pieces) {
+        buf.append(piece);
+        result = context->parseRequest(&buf, Timestamp::now());
+        if (result != HttpContext::kNeedMore) {
+            break;
+        }
+    }
+    return result;
+}
+
+// chunk大小行在十六进制数字中间被切开
+void testChunkSizeSplitMidHex() {
+    HttpContext context;
+    std::string data(0x1a, 'z');
+    CHECK(parseChunked(&context, {"1", "a\r", "\n" + data + "\r\n0\r\n\r\n"}) == HttpContext::kGotRequest);
+    CHECK(context.request().body() == data);
+
+    // 每次一个字节
+    HttpContext byteContext;
+    std::string body = "10\r\n0123456789abcdef\r\n3\r\nxyz\r\n0\r\n\r\n";
+    std::vector<std::string> bytes;
+    for (char c : body) {
+        bytes.push_back(std::string(1, c));
+    }
+    CHECK(parseChunked(&byteContext, bytes) == HttpContext::kGotRequest);
+    CHECK(byteContext.request().body() == "0123456789abcdefxyz");
+}
+
+// chunk扩展被忽略，trailer字段被丢弃，之后的流水线请求留在缓冲区中
+void testChunkExtensionAndTrailer() {
+    HttpContext context;
+    Buffer buf;
+    buf.append(kChunkedHeaders);
+    buf.append("5;name=value\r\nhello\r\n6 ; x=\"y\"\r\n world\r\n0;last\r\n"
+               "X-Checksum: abc\r\nX-Other: 1\r\n\r\n"
+               "GET /next HTTP/1.1\r\n\r\n");
+    CHECK(context.parseRequest(&buf, Timestamp::now()) == HttpContext::kHeadersComplete);
+    CHECK(context.parseRequest(&buf, Timestamp::now()) == HttpContext::kGotRequest);
+    CHECK(context.request().body() == "hello world");
+    CHECK(context.request().getHeader("X-Checksum").empty());
+
+    context.reset();
+    CHECK(context.parseRequest(&buf, Timestamp::now()) == HttpContext::kGotRequest);
+    CHECK(context.request().path() == "/next");
+}
+
+// 没有CRLF的chunk大小行或trailer行超过上限，以及非法的chunk大小
+void testBadChunkLines() {
+    HttpContext longLine;
+    CHECK(parseChunked(&longLine, {"1;" + std::string(5000, 'e')}) == HttpContext::kError);
+
+    HttpContext longTrailer;
+    CHECK(parseChunked(&longTrailer, {"0\r\nX: " + std::string(5000, 't')}) == HttpContext::kError);
+
+    HttpContext notHex;
+    CHECK(parseChunked(&notHex, {"zz\r\n"}) == HttpContext::kError);
+
+    HttpContext overflow;
+    CHECK(parseChunked(&overflow, {"1" + std::string(16, '0') + "\r\n"}) == HttpContext::kError);
+
+    HttpContext missingCrlf;
+    CHECK(parseChunked(&missingCrlf, {"3\r\nabcXY"}) == HttpContext::kError);
+}
+
+} // namespace
+
+int main() {
+    Logger::setLogLevel(Logger::WARN);
+    testHeadersInTwoParts();
+    testPipelinedRequestCutInHeaders();
+    testHeadersTooLarge();
+    testHeaderSizePerRequest();
+    testChunkSizeSplitMidHex();
+    testChunkExtensionAndTrailer();
+    testBadChunkLines();
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "net/MultipartParser.h"
+#include "base/Logging.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace mymuduo;
+using namespace mymuduo::net;
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+const char kBoundary[] = "----WebKitFormBoundary7MA4YWxk";
+
+// 解析结果：每个part的头部信息和数据
+struct Collected {
+    std::vector<MultipartParser::Part> parts;
+    std::vector<std::string> bodies;
+    int ended = 0;
+};
+
+void attach(MultipartParser* parser, Collected* out) {
+    parser->setPartBeginCallback([out](const MultipartParser::Part& part) {
+        out->parts.push_back(part);
+        out->bodies.emplace_back();
+    });
+    parser->setPartDataCallback([out](const char* data, size_t len) {
+        out->bodies.back().append(data, len);
+    });
+    parser->setPartEndCallback([out]() { ++out->ended; });
+}
+
+std::string makeBody(const std::string& fileData) {
+    std::string boundary = kBoundary;
+    return "--" + boundary + "\r\n"
+           "Content-Disposition: form-data; name=\"note\"\r\n"
+           "\r\n"
+           "hello\r\n"
+           "--" + boundary + "\r\n"
+           "Content-Disposition: form-data; name=\"file\"; filename=\"a.txt\"\r\n"
+           "Content-Type: text/plain\r\n"
+           "\r\n" +
+           fileData + "\r\n"
+           "--" + boundary + "--\r\n";
+}
+
+void checkParsed(const Collected& got, const std::string& fileData) {
+    CHECK(got.parts.size() == 2);
+    CHECK(got.ended == 2);
+    if (got.parts.size() != 2) {
+        return;
+    }
+    CHECK(got.parts[0].name == "note");
+    CHECK(got.parts[0].filename.empty());
+    CHECK(got.bodies[0] == "hello");
+    CHECK(got.parts[1].name == "file");
+    CHECK(got.parts[1].filename == "a.txt");
+    CHECK(got.parts[1].contentType == "text/plain");
+    CHECK(got.bodies[1] == fileData);
+}
+
+// 请求体在每一个位置切成两段，边界、头部和CRLF被切开时结果都不变
+void testSplitAtEveryOffset() {
+    std::string fileData = "line one\r\nline two\r\n";
+    std::string body = makeBody(fileData);
+    for (size_t split = 0; split <= body.size(); ++split) {
+        MultipartParser parser(kBoundary);
+        Collected got;
+        attach(&parser, &got);
+        CHECK(parser.feed(body.data(), split));
+        CHECK(parser.feed(body.data() + split, body.size() - split));
+        CHECK(parser.finished());
+        checkParsed(got, fileData);
+    }
+}
+
+// 每次只喂一个字节
+void testByteAtATime() {
+    std::string fileData(1000, 'x');
+    std::string body = makeBody(fileData);
+    MultipartParser parser(kBoundary);
+    Collected got;
+    attach(&parser, &got);
+    for (char c : body) {
+        CHECK(parser.feed(&c, 1));
+    }
+    CHECK(parser.finished());
+    checkParsed(got, fileData);
+}
+
+// 数据中出现边界的前缀（CRLF、"--"、边界的前几个字符）时仍属于数据，
+// 包括这样的前缀恰好落在两次feed之间的情况
+void testDelimiterPrefixInData() {
+    std::string boundary = kBoundary;
+    std::string fileData = "a\r\n-b\r\n--c\r\n--" + boundary.substr(0, 10) + "d\r\n--" +
+                           boundary.substr(0, boundary.size() - 1) + "\r\n-";
+    std::string body = makeBody(fileData);
+    for (size_t split = 0; split <= body.size(); ++split) {
+        MultipartParser parser(kBoundary);
+        Collected got;
+        attach(&parser, &got);
+        CHECK(parser.feed(body.data(), split));
+        CHECK(parser.feed(body.data() + split, body.size() - split));
+        CHECK(parser.finished());
+        checkParsed(got, fileData);
+    }
+}
+
+// 边界后面既不是CRLF也不是"--"时格式错误
+void testMalformedDelimiter() {
+    std::string body = std::string("--") + kBoundary + "X\r\n";
+    MultipartParser parser(kBoundary);
+    CHECK(!parser.feed(body.data(), body.size()));
+    CHECK(parser.hasError());
+}
+
+void testBoundaryFromContentType() {
+    CHECK(MultipartParser::boundaryFromContentType(
+              "multipart/form-data; boundary=abc") == "abc");
+    CHECK(MultipartParser::boundaryFromContentType(
+              "multipart/form-data; boundary=\"a b\"") == "a b");
+    CHECK(MultipartParser::boundaryFromContentType("text/plain").empty());
+}
+
+} // namespace
+
+int main() {
+    Logger::setLogLevel(Logger::FATAL);
+    testSplitAtEveryOffset();
+    testByteAtATime();
+    testDelimiterPrefixInData();
+    testMalformedDelimiter();
+    testBoundaryFromContentType();
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("All tests passed\n");
+    return 0;
+}
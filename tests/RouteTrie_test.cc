@@ -0,0 +1,150 @@
+#include "net/RouteTrie.h"
+#include "net/HttpRequest.h"
+#include "base/Logging.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace mymuduo;
+using namespace mymuduo::net;
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+enum Handler {
+    kUploadStatus,
+    kUploadChunk,
+    kUploadInit,
+    kUploadInitStatus,
+    kFiles,
+    kFilesSearch,
+    kDownload,
+    kStaticABC,
+    kParamAXD,
+    kParamAXE,
+};
+
+RouteTrie makeRoutes() {
+    RouteTrie routes;
+    routes.addRoute(HttpRequest::kGet, "/upload/:uploadId", kUploadStatus);
+    routes.addRoute(HttpRequest::kPut, "/upload/:uploadId/chunks/:index", kUploadChunk);
+    routes.addRoute(HttpRequest::kPost, "/upload/init", kUploadInit);
+    routes.addRoute(HttpRequest::kGet, "/upload/init/status", kUploadInitStatus);
+    routes.addRoute(HttpRequest::kGet, "/files", kFiles);
+    routes.addRoute(HttpRequest::kGet, "/files/search", kFilesSearch);
+    routes.addRoute(HttpRequest::kGet, "/download/:filename", kDownload);
+    routes.addRoute(HttpRequest::kGet, "/a/b/c", kStaticABC);
+    routes.addRoute(HttpRequest::kGet, "/a/:x/d", kParamAXD);
+    routes.addRoute(HttpRequest::kGet, "/a/:y/e", kParamAXE);
+    return routes;
+}
+
+// 匹配一个请求，req保存匹配到的路径参数
+int match(const RouteTrie& routes, const std::string& method, const std::string& path,
+          HttpRequest* req) {
+    CHECK(req->setMethod(method.data(), method.data() + method.size()));
+    req->setPath(path.data(), path.data() + path.size());
+    return routes.match(*req);
+}
+
+// 静态段优先
+void testStaticFirst() {
+    RouteTrie routes = makeRoutes();
+    HttpRequest files;
+    CHECK(match(routes, "GET", "/files/search", &files) == kFilesSearch);
+    HttpRequest init;
+    CHECK(match(routes, "POST", "/upload/init", &init) == kUploadInit);
+    CHECK(init.getPathParam("uploadId").empty());
+    HttpRequest abc;
+    CHECK(match(routes, "GET", "/a/b/c", &abc) == kStaticABC);
+    CHECK(abc.getPathParam("x").empty());
+}
+
+// 静态段存在但后面匹配不上（或没有该方法的路由）时，回溯到参数段
+void testBacktrackToParam() {
+    RouteTrie routes = makeRoutes();
+
+    // /upload/init只有POST，GET回溯到/upload/:uploadId
+    HttpRequest init;
+    CHECK(match(routes, "GET", "/upload/init", &init) == kUploadStatus);
+    CHECK(init.getPathParam("uploadId") == "init");
+
+    // /a/b下只有c，/a/b/d回溯到/a/:x/d
+    HttpRequest abd;
+    CHECK(match(routes, "GET", "/a/b/d", &abd) == kParamAXD);
+    CHECK(abd.getPathParam("x") == "b");
+
+    // 同一个参数节点下不同的后续段，参数名按路由各自记录
+    HttpRequest abe;
+    CHECK(match(routes, "GET", "/a/b/e", &abe) == kParamAXE);
+    CHECK(abe.getPathParam("y") == "b");
+    CHECK(abe.getPathParam("x").empty());
+
+    // 从/upload/init/status的静态分支回溯到参数分支
+    HttpRequest chunk;
+    CHECK(match(routes, "PUT", "/upload/init/chunks/12", &chunk) == kUploadChunk);
+    CHECK(chunk.getPathParam("uploadId") == "init");
+    CHECK(chunk.getPathParam("index") == "12");
+}
+
+void testPathParams() {
+    RouteTrie routes = makeRoutes();
+    HttpRequest chunk;
+    CHECK(match(routes, "PUT", "/upload/u-1234/chunks/7", &chunk) == kUploadChunk);
+    CHECK(chunk.getPathParam("uploadId") == "u-1234");
+    CHECK(chunk.getPathParam("index") == "7");
+    CHECK(chunk.getPathParam("missing").empty());
+
+    HttpRequest download;
+    CHECK(match(routes, "GET", "/download/report%202024.pdf", &download) == kDownload);
+    CHECK(download.getPathParam("filename") == "report%202024.pdf");
+}
+
+void testNoRoute() {
+    RouteTrie routes = makeRoutes();
+    HttpRequest wrongMethod;
+    CHECK(match(routes, "DELETE", "/files", &wrongMethod) == RouteTrie::kNoRoute);
+    HttpRequest unknown;
+    CHECK(match(routes, "GET", "/nope", &unknown) == RouteTrie::kNoRoute);
+    HttpRequest tooShort;
+    CHECK(match(routes, "PUT", "/upload/u-1/chunks", &tooShort) == RouteTrie::kNoRoute);
+    HttpRequest tooLong;
+    CHECK(match(routes, "GET", "/download/a/b", &tooLong) == RouteTrie::kNoRoute);
+    HttpRequest emptyParam;
+    CHECK(match(routes, "GET", "/download/", &emptyParam) == RouteTrie::kNoRoute);
+}
+
+// 同一方法和模式重复添加时后添加的覆盖先添加的
+void testOverride() {
+    RouteTrie routes = makeRoutes();
+    routes.addRoute(HttpRequest::kGet, "/files", 100);
+    HttpRequest files;
+    CHECK(match(routes, "GET", "/files", &files) == 100);
+}
+
+} // namespace
+
+int main() {
+    Logger::setLogLevel(Logger::WARN);
+    testStaticFirst();
+    testBacktrackToParam();
+    testPathParams();
+    testNoRoute();
+    testOverride();
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("All tests passed\n");
+    return 0;
+}
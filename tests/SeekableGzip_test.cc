@@ -0,0 +1,185 @@
+#include "application/SeekableGzip.h"
+#include "base/Logging.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace mymuduo;
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+// 容易压缩的文本
+std::string textData(size_t len) {
+    std::string data;
+    for (size_t line = 0; data.size() < len; ++line) {
+        data += "line " + std::to_string(line) + ": the quick brown fox jumps over the lazy dog\n";
+    }
+    data.resize(len);
+    return data;
+}
+
+std::string randomData(size_t len, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::string data(len, '\0');
+    for (char& c : data) {
+        c = static_cast<char>(gen() & 0xff);
+    }
+    return data;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+// 用SeekableGzipWriter分多次写入path，写出帧索引
+bool writeFile(const std::string& path, const std::string& data, bool* compressed) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = true;
+    {
+        SeekableGzipWriter writer(fd, true);
+        std::mt19937 gen(7);
+        for (size_t pos = 0; pos < data.size() && ok;) {
+            size_t n = std::min(data.size() - pos, static_cast<size_t>(gen() % 300000 + 1));
+            ok = writer.write(data.data() + pos, n);
+            pos += n;
+        }
+        ok = ok && writer.finish();
+        *compressed = writer.compressed();
+        CHECK(writer.rawBytes() == data.size());
+        if (ok && writer.compressed()) {
+            ok = writer.writeIndex(path + ".idx");
+        }
+    }
+    ::close(fd);
+    return ok;
+}
+
+// 按标准gzip流整个解压
+std::string gunzip(const std::string& compressed) {
+    z_stream stream = z_stream();
+    CHECK(inflateInit2(&stream, 16 + MAX_WBITS) == Z_OK);
+    std::string out;
+    char buf[65536];
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    int ret = Z_OK;
+    while (ret == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef*>(buf);
+        stream.avail_out = sizeof buf;
+        ret = inflate(&stream, Z_NO_FLUSH);
+        out.append(buf, sizeof buf - stream.avail_out);
+    }
+    CHECK(ret == Z_STREAM_END);
+    inflateEnd(&stream);
+    return out;
+}
+
+std::string readRange(SeekableGzipReader* reader, uint64_t offset, uint64_t len) {
+    std::string out;
+    if (!reader->seek(offset, len)) {
+        CHECK(false);
+        return out;
+    }
+    char buf[10000];
+    ssize_t n;
+    while ((n = reader->read(buf, sizeof buf)) > 0) {
+        out.append(buf, static_cast<size_t>(n));
+    }
+    CHECK(n == 0);
+    CHECK(reader->remaining() == 0);
+    return out;
+}
+
+// 压缩后的文件是标准gzip流，并且可以从任意偏移读出原始数据，包括跨越帧边界的区间
+void testCompressedRoundTrip(const std::string& dir) {
+    const size_t frame = SeekableGzipWriter::kFrameSize;
+    std::string data = textData(3 * frame + 12345);
+    std::string path = dir + "/text.gz";
+    bool compressed = false;
+    CHECK(writeFile(path, data, &compressed));
+    CHECK(compressed);
+
+    std::string stored = readFile(path);
+    CHECK(stored.size() < data.size() / 2);
+    CHECK(gunzip(stored) == data);
+
+    uint64_t rawSize = 0;
+    CHECK(SeekableGzipReader::readRawSize(path + ".idx", &rawSize));
+    CHECK(rawSize == data.size());
+
+    SeekableGzipReader reader;
+    CHECK(reader.open(path, path + ".idx"));
+    CHECK(reader.rawSize() == data.size());
+    CHECK(reader.compressedSize() == stored.size());
+
+    struct Range { uint64_t offset; uint64_t len; };
+    const Range ranges[] = {
+        {0, data.size()},
+        {0, 1},
+        {frame - 10, 20},            // 跨越第一个帧边界
+        {frame, frame},              // 正好一帧
+        {frame + 1, 2 * frame},      // 跨越两个边界
+        {data.size() - 5, 5},        // 最后几个字节
+        {123456, 0},
+    };
+    for (const Range& range : ranges) {
+        CHECK(readRange(&reader, range.offset, range.len) == data.substr(range.offset, range.len));
+    }
+}
+
+// 压缩效果差的数据按原样保存
+void testIncompressibleStoredRaw(const std::string& dir) {
+    std::string data = randomData(2 * SeekableGzipWriter::kFrameSize + 100, 9);
+    std::string path = dir + "/random.bin";
+    bool compressed = true;
+    CHECK(writeFile(path, data, &compressed));
+    CHECK(!compressed);
+    CHECK(readFile(path) == data);
+}
+
+} // namespace
+
+int main() {
+    Logger::setLogLevel(Logger::WARN);
+    char dir[] = "/tmp/SeekableGzip_test.XXXXXX";
+    if (!::mkdtemp(dir)) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    testCompressedRoundTrip(dir);
+    testIncompressibleStoredRaw(dir);
+    ::unlink((std::string(dir) + "/text.gz").c_str());
+    ::unlink((std::string(dir) + "/text.gz.idx").c_str());
+    ::unlink((std::string(dir) + "/random.bin").c_str());
+    ::rmdir(dir);
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("All tests passed\n");
+    return 0;
+}